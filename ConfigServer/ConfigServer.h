@@ -18,6 +18,10 @@
 #endif
 #include "HttpServer.h"
 
+// Define HEAP_ACCOUNTING to attribute the allocations of the server and the
+// form to HEAP_CONFIGSERVER.
+# include "HeapScope.h"
+
 
 class ConfigServer {
 public:
@@ -36,7 +40,10 @@ private:
 	static bool 					 isActiveServer;
 	static HttpServer				*server;
 	static ConfigurationCallback	 callback; 	
+	static String 					 page;			// cached rendered configuration page
+	static bool 					 pageValid;		// indicates whether *page* is up to date
 
+	static void 					 _renderPage();
 	static HttpServer::RequestResult _pageRequestHandler(String path, HttpServer::Method method, long length, String type, char *content);
 	static HttpServer::RequestResult _postRequestHandler(String path, HttpServer::Method method, long length, String type, char *content);
 
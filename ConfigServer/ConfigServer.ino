@@ -24,6 +24,32 @@ unsigned int						 ConfigServer::numberOfFormFields = 0;
 bool 								 ConfigServer::isActiveServer = false;
 HttpServer							*ConfigServer::server = NULL;
 ConfigServer::ConfigurationCallback	 ConfigServer::callback; 	
+String 								 ConfigServer::page = "";
+bool 								 ConfigServer::pageValid = false;
+
+
+// Static parts of the configuration page, kept in flash memory.
+static const char _pageHead[] PROGMEM = "<html><head><title>";
+static const char _pageStyle[] PROGMEM = 
+	"</title>"
+	"<style>"
+	"body {padding: 30px;} "
+	"#config {font-family: \"Trebuchet MS\", Arial, Helvetica, sans-serif; border-collapse: collapse;} "
+	"#config tr:nth-child(even) {background-color: #f2f2f2;} "
+	"#config td {border: 0px; padding: 8px;} "
+	"#config td.header {margin-top: 20px; padding-top: 12px; padding-bottom: 12px; text-align: left; background-color: #555; color: white;} "
+	"#config td.name {text-weight: bold;} "
+	"#config td.field {width: 250px;} "
+	"#config td.submit {padding-top: 25px; padding-bottom: 25px; height:150%; background-color: white;} "
+	"#config input {width: 100%; height:100%; font-size: 90%;} "
+	"#config input[type=submit] {font-size:100%; color: #DA2C43; display: block; height:100%; width: 80%; margin: 0 auto;} "
+	"</style>"
+	"</head><body><H1>";
+static const char _pageFormStart[] PROGMEM = "<form action=\"/post\" method=\"get\"><table  border=\"0\" id=\"config\" style=\"margin-top:25px;\">";
+static const char _pageFormEnd[] PROGMEM = 
+	"<tr><td class=\"submit\" colspan=\"2\" style=\"padding-top: 25px;\"><input type=\"submit\" value=\"Submit\"></td></tr>"
+	"</table></form>";
+static const char _pageEnd[] PROGMEM = "</body></html>";
 
 
 void ConfigServer::check() {
@@ -49,6 +75,7 @@ bool ConfigServer::start(const String ssid,
 						 const String values[], 
 						 const unsigned int numberOfFields, 
 						 const ConfigurationCallback callb) {
+	HEAP_SCOPE(HEAP_CONFIGSERVER);
 	if (isActiveServer) {
 		return true;
 	}
@@ -77,13 +104,14 @@ bool ConfigServer::start(const String ssid,
 	server->addHandler("/", HttpServer::GET, _pageRequestHandler);
 	server->addHandler("/post", HttpServer::ALL, _postRequestHandler);
 	numberOfFormFields = numberOfFields;
+	pageValid = false;
 
 	if (fields != NULL && numberOfFormFields > 0) {
 		if (formFields != NULL) {
-			delete formFields;
+			delete [] formFields;
 		}
 		if (defaultValues != NULL) {
-			delete defaultValues;
+			delete [] defaultValues;
 		}
 
 		// copy form fields
@@ -104,12 +132,18 @@ bool ConfigServer::start(const String ssid,
 
 
 void ConfigServer::end(const bool wifioff) {
+	HEAP_SCOPE(HEAP_CONFIGSERVER);
 	if ( ! isActiveServer) {
 		return;
 	}
 	delete server;
 	delete [] formFields;
 	delete [] defaultValues;
+	server = NULL;
+	formFields = NULL;
+	defaultValues = NULL;
+	pageValid = false;
+	page = "";	// release the cached page
 	WiFi.softAPdisconnect(true);
 	WiFi.mode(wifioff ? WIFI_OFF : WIFI_STA);
 	isActiveServer = false;
@@ -119,10 +153,12 @@ void ConfigServer::end(const bool wifioff) {
 
 void ConfigServer::setTitle(const String str) {
 	title = str;
+	pageValid = false;
 }
 
 void ConfigServer::setIntroText(const String str) {
 	introText = str;
+	pageValid = false;
 }
 
 void ConfigServer::setResultText(const String str) {
@@ -131,6 +167,7 @@ void ConfigServer::setResultText(const String str) {
 
 
 void ConfigServer::setValues(const String values[]) {
+	HEAP_SCOPE(HEAP_CONFIGSERVER);
 	unsigned int nif = 0; // number of input fields
 	if (values != NULL) {
 		for (unsigned int i = 0; i < numberOfFormFields; i++) {
@@ -144,57 +181,79 @@ void ConfigServer::setValues(const String values[]) {
 	for (unsigned int i = nif; i < numberOfFormFields; i++) {
 		defaultValues[i] = "";
 	}
+	pageValid = false;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-//
-//	HttpServer Callbacks
 
-HttpServer::RequestResult ConfigServer::_pageRequestHandler(String path, HttpServer::Method method, long length, String type, char *content) {
-	HttpServer::RequestResult result;
-	Serial.println("ConfigServer: Received page request");
+// Render the configuration page into the page cache. The size of the page
+// is calculated first so that the page buffer is allocated only once.
+void ConfigServer::_renderPage() {
+	unsigned int size = strlen_P(_pageHead) + strlen_P(_pageStyle) + strlen_P(_pageEnd) + 
+						title.length() * 2 + introText.length() + 5;
+	if (formFields != NULL) {
+		size += strlen_P(_pageFormStart) + strlen_P(_pageFormEnd);
+		for (unsigned int i = 0; i < numberOfFormFields; i++) {
+			size += formFields[i].length() + defaultValues[i].length() + 150;
+		}
+	}
+	page = "";
+	page.reserve(size);
 
-	result.returnCode = 200;
-	result.type = "text/html";
-	result.content = "<html><head>";
-	result.content += "<title>" + title + "</title>";
-	result.content += "<style>";
-	result.content += "body {padding: 30px;} ";
-	result.content += "#config {font-family: \"Trebuchet MS\", Arial, Helvetica, sans-serif; border-collapse: collapse;} ";
-	result.content += "#config tr:nth-child(even) {background-color: #f2f2f2;} ";
-	result.content += "#config td {border: 0px; padding: 8px;} ";
-	result.content += "#config td.header {margin-top: 20px; padding-top: 12px; padding-bottom: 12px; text-align: left; background-color: #555; color: white;} ";
-	result.content += "#config td.name {text-weight: bold;} ";
-	result.content += "#config td.field {width: 250px;} ";
-	result.content += "#config td.submit {padding-top: 25px; padding-bottom: 25px; height:150%; background-color: white;} ";
-	result.content += "#config input {width: 100%; height:100%; font-size: 90%;} ";
-	result.content += "#config input[type=submit] {font-size:100%; color: #DA2C43; display: block; height:100%; width: 80%; margin: 0 auto;} ";
-	result.content += "</style>";
-	result.content += "</head><body>";
-	result.content +="<H1>" + title + "</H1>";
-	result.content += introText;
+	page += FPSTR(_pageHead);
+	page += title;
+	page += FPSTR(_pageStyle);
+	page += title;
+	page += "</H1>";
+	page += introText;
 	if (formFields != NULL) {
-		result.content += "<form action=\"/post\" method=\"get\"><table  border=\"0\" id=\"config\" style=\"margin-top:25px;\">";
+		page += FPSTR(_pageFormStart);
 		unsigned int nif = 0; // number of input fields
 		for (unsigned int i = 0; i < numberOfFormFields; i++) {
-			result.content += "<tr>";
-			String field = formFields[i];
+			page += "<tr>";
+			const String &field = formFields[i];
 			if (field.startsWith("H;")) {
-				result.content += "<td colspan=\"2\" class=\"header\">" + field.substring(2) + "</td>";
+				page += "<td colspan=\"2\" class=\"header\">";
+				page += field.substring(2);
+				page += "</td>";
 			} else if (field.startsWith("S;")) {
-				result.content += "<td class=\"name\">" + field.substring(2) + "</td>";
-				result.content += "<td class=\"field\"><input type=\"text\" name=\"" + String(nif) + "\" value=\"" + defaultValues[nif] + "\"></td>";
+				page += "<td class=\"name\">";
+				page += field.substring(2);
+				page += "</td><td class=\"field\"><input type=\"text\" name=\"";
+				page += nif;
+				page += "\" value=\"";
+				page += defaultValues[nif];
+				page += "\"></td>";
 				nif++;
 			}
-			result.content += "</tr>";
+			page += "</tr>";
 		}
-		result.content += "<tr><td class=\"submit\" colspan=\"2\" style=\"padding-top: 25px;\"><input type=\"submit\" value=\"Submit\"></td></tr>";
-		result.content += "</table></form></body></html>";
+		page += FPSTR(_pageFormEnd);
 	}
+	page += FPSTR(_pageEnd);
+	pageValid = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//	HttpServer Callbacks
+
+HttpServer::RequestResult ConfigServer::_pageRequestHandler(String path, HttpServer::Method method, long length, String type, char *content) {
+	HEAP_SCOPE(HEAP_CONFIGSERVER);	// called as an application handler by the HttpServer
+	HttpServer::RequestResult result;
+	Serial.println("ConfigServer: Received page request");
+
+	// The page is only rendered again after the title, intro text, or values changed
+	if ( ! pageValid) {
+		_renderPage();
+	}
+	result.returnCode = 200;
+	result.type = "text/html";
+	result.sharedContent = &page;	// sent directly from the cache
 	return result;
 }
 
 HttpServer::RequestResult ConfigServer::_postRequestHandler(String path, HttpServer::Method method, long length, String type, char *content) {
+	HEAP_SCOPE(HEAP_CONFIGSERVER);
 	HttpServer::RequestResult result;
 	Serial.println("ConfigServer: Received post request");
 	Serial.printf("Path: %s\n", path.c_str());
@@ -210,6 +269,7 @@ HttpServer::RequestResult ConfigServer::_postRequestHandler(String path, HttpSer
 			configuration[i] = HttpServer::getRequestArgument(String(i));
 		}
 		setValues(configuration);	// set new default values
+		HEAP_SCOPE(HEAP_APPLICATION);
 		cbResult = (*callback)(configuration);
 	}
 
@@ -10,6 +10,10 @@
 # ifndef __EEPROMSTORE__
 # define __EEPROMSTORE__
 
+// Define HEAP_ACCOUNTING to attribute the allocations of the EEPROM buffer
+// and strings to HEAP_EEPROMSTORE.
+# include "HeapScope.h"
+
 
 class EEPROMStore {
 
@@ -72,6 +76,10 @@ public:
 	template<typename T> 
 	void put(const unsigned int index, const T &t);
 
+	// Return the maximum size for each entry, as specified in the constructor. Strings must be shorter
+	// than this size, because they are stored with a terminating 0 character.
+	unsigned int getEntrySize();
+
 	// Retrieve the store identifier. This identifier is stored as the first entry in the store and must
 	// not exceed the entry size as specified in the constructor. It can be used to identify the store's content.
 	String getStoreIdentifier();
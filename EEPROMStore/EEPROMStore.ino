@@ -21,6 +21,7 @@ EEPROMStore::EEPROMStore(const int maxNumberOfEntries, const int entrySize, cons
 }
 
 void EEPROMStore::_init(const int maxNumberOfEntries, const int entrySize, const int startAddress) {
+	HEAP_SCOPE(HEAP_EEPROMSTORE);
 	this->maxNumberOfEntries = maxNumberOfEntries; 
 	this->entrySize = entrySize;
 	this->startAddress = startAddress;
@@ -39,6 +40,7 @@ void EEPROMStore::_init(const int maxNumberOfEntries, const int entrySize, const
 
 
 EEPROMStore::~EEPROMStore() {
+	HEAP_SCOPE(HEAP_EEPROMSTORE);
 # if defined(ESP8266) || defined(ESP32)
 	EEPROM.end();
 # endif
@@ -47,25 +49,33 @@ EEPROMStore::~EEPROMStore() {
 
 
 String EEPROMStore::getString(const unsigned int index) {
-	if (index < 0 || index >= maxNumberOfEntries) {
+	if (index >= maxNumberOfEntries) {
 		return "";
 	}
 	return this->_getString(index + 1);
 }
 
 
+// Read the string directly into the result. The string ends at the first
+// '\0' or at the end of the entry.
 String EEPROMStore::_getString(const unsigned int index) {
+	HEAP_SCOPE(HEAP_EEPROMSTORE);
 	int offset = startAddress + (index * entrySize);
-	char *str = new char[entrySize];
-	for (int i = 0; i < entrySize; i++) {
-		str[i] = EEPROM.read(offset + i);
+	String result;
+	result.reserve(entrySize);
+	for (unsigned int i = 0; i < entrySize; i++) {
+		char c = EEPROM.read(offset + i);
+		if (c == '\0') {
+			break;
+		}
+		result += c;
 	}
-	return String(str);
+	return result;
 }
 
 
 void EEPROMStore::putString(const unsigned int index, const String value) {
-	if (index < 0 || index >= maxNumberOfEntries) {
+	if (index >= maxNumberOfEntries) {
 		return ;
 	}
 	this->_putString(index + 1, value);
@@ -89,7 +99,7 @@ void EEPROMStore::_putString(const unsigned int index, const String value) {
 
 template<typename T> 
 T &EEPROMStore::get(const unsigned int index, T &t) {
-	if (index < 0 || index >= maxNumberOfEntries) {
+	if (index >= maxNumberOfEntries) {
 		return t;
 	}
 	return this->_get(index + 1, t);
@@ -104,7 +114,7 @@ T &EEPROMStore::_get(const unsigned int index, T &t) {
 
 template<typename T> 
 void EEPROMStore::put(const unsigned int index, const T &t) {
-	if (index < 0 || index >= maxNumberOfEntries) {
+	if (index >= maxNumberOfEntries) {
 		return;
 	}
 	this->_put(index + 1, t);
@@ -121,8 +131,13 @@ void EEPROMStore::_put(const unsigned int index, const T &t) {
 }
 
 
+unsigned int EEPROMStore::getEntrySize() {
+	return this->entrySize;
+}
+
+
 void EEPROMStore::clear() {
-	for (int i = startAddress; i < (startAddress + totalSize); i++) {
+	for (unsigned int i = startAddress; i < (startAddress + totalSize); i++) {
 		EEPROM.write(i, 0);
 	}
 }
@@ -0,0 +1,120 @@
+/*
+ *	HeapAccounting.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Optional accounting of the heap allocations of the libraries, tagged by
+ *	subsystem.
+ */
+
+# ifndef __HEAPACCOUNTING_H__
+# define __HEAPACCOUNTING_H__
+
+# include <Arduino.h>
+
+// Define HEAP_ACCOUNTING before including the libraries to enable the
+// accounting. The libraries include this file through HeapScope.h only if
+// it is defined. Without it all instrumentation is compiled out.
+// # define HEAP_ACCOUNTING
+# ifdef HEAP_ACCOUNTING
+# define HEAP_SCOPE(subsystem)			HeapScope heapScope_(subsystem)
+# else
+# define HEAP_SCOPE(subsystem)
+# endif
+
+// Define HEAP_ACCOUNTING_FRAGMENTATION to determine the largest free heap
+// block at the beginning and the end of each scope, see *maxFreeBlockImpact*.
+// On the ESP8266 this walks the list of free heap blocks, so it is not done
+// by default.
+// # define HEAP_ACCOUNTING_FRAGMENTATION
+
+
+// The subsystems that allocations are attributed to.
+enum HeapSubsystem {
+	HEAP_APPLICATION = 0,	// everything outside of the libraries, including callbacks
+	HEAP_LINKEDLIST,
+	HEAP_RINGBUFFER,
+	HEAP_TASKMANAGER,
+	HEAP_EEPROMSTORE,
+	HEAP_HTTPSERVER,
+	HEAP_CONFIGSERVER,
+	HEAP_ONEM2M,
+	HEAP_SUBSYSTEMS			// number of subsystems
+};
+
+
+// Heap statistics of a single subsystem
+struct HeapStatistics {
+	unsigned long 	allocations;			// number of allocations
+	unsigned long 	frees;					// number of freed blocks
+	long 			currentBytes;			// bytes currently allocated
+	long 			peakBytes;				// high-water mark of currentBytes
+	long 			maxFreeBlockImpact;		// largest decrease of the largest free block during a call, see HEAP_ACCOUNTING_FRAGMENTATION
+};
+
+
+// Static class that collects the heap statistics.
+class HeapAccounting {
+	friend class HeapScope;
+
+private:
+	static HeapSubsystem 	_current;
+	static HeapStatistics 	_statistics[HEAP_SUBSYSTEMS];
+	static long 			_scopedBytes;
+
+	static void 			_allocated(HeapSubsystem subsystem, long size);
+	static void 			_freed(HeapSubsystem subsystem, long size);
+
+public:
+
+	//	Return the statistics of a *subsystem*.
+	static const HeapStatistics &statistics(HeapSubsystem subsystem);
+
+	//	Return the number of allocations of a *subsystem*. This is a shortcut
+	//	for checking that a call doesn't allocate memory.
+	static unsigned long 	allocations(HeapSubsystem subsystem);
+
+	//	Return the subsystem that allocations are currently attributed to.
+	static HeapSubsystem 	currentSubsystem(void);
+
+	//	Return the name of a *subsystem*, e.g. "TaskManager".
+	static const char 		*name(HeapSubsystem subsystem);
+
+	//	Reset the counters, the peaks and the free block impact of all
+	//	subsystems. The currently allocated bytes are kept.
+	static void 			reset(void);
+
+	//	Return the statistics of all subsystems as text, one line per
+	//	subsystem. This allocates memory for the application.
+	static String 			report(void);
+
+	//	Functions for allocator hooks of a platform. *allocated()* records an
+	//	allocation of *size* bytes for the current subsystem and returns the
+	//	subsystem as a tag that must be passed to *freed()* when the block is
+	//	freed.
+	static uint8_t 			allocated(size_t size);
+	static void 			freed(uint8_t tag, size_t size);
+};
+
+
+//	Objects of this class attribute all allocations to a *subsystem* while
+//	they exist. Use it through the HEAP_SCOPE() macro at the beginning of
+//	a function. Calls from one library into another are attributed to the
+//	outer library, e.g. the list of a TaskManager to HEAP_TASKMANAGER,
+//	while a HEAP_APPLICATION scope always switches back to the application,
+//	e.g. for the duration of a callback.
+class HeapScope {
+private:
+	HeapSubsystem 	_previous;
+	bool 			_switched;
+	uint32_t 		_freeHeap;
+	uint32_t 		_maxFreeBlock;
+	long 			_scopedBytes;
+
+public:
+	HeapScope(HeapSubsystem subsystem);
+	~HeapScope();
+};
+
+# endif
@@ -0,0 +1,178 @@
+/*
+ *	HeapAccounting.ino
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Optional accounting of the heap allocations of the libraries, tagged by
+ *	subsystem.
+ */
+
+# include "HeapAccounting.h"
+
+// The host build provides an allocator hook, so every block is counted
+// exactly and freed blocks are attributed to the subsystem that allocated
+// them. Otherwise the bytes are derived from the free heap before and after
+// each scope.
+# ifdef ARDUINO_ARCH_HOST
+# define HEAP_ACCOUNTING_HOOK
+# endif
+
+HeapSubsystem 	HeapAccounting::_current = HEAP_APPLICATION;
+HeapStatistics 	HeapAccounting::_statistics[HEAP_SUBSYSTEMS];
+long 			HeapAccounting::_scopedBytes = 0;
+
+static const char *_heapSubsystemNames[HEAP_SUBSYSTEMS] = {
+	"Application", "LinkedList", "RingBuffer", "TaskManager", "EEPROMStore", "HttpServer", "ConfigServer", "OneM2M"
+};
+
+# ifdef HEAP_ACCOUNTING_HOOK
+static bool _heapHookInstalled = (hostSetHeapHook(HeapAccounting::allocated, HeapAccounting::freed), true);
+# endif
+
+
+static uint32_t _heapFree(void) {
+# if defined(ESP8266) || defined(ESP32)
+	return ESP.getFreeHeap();
+# else
+	return 0;
+# endif
+}
+
+
+# ifdef HEAP_ACCOUNTING_FRAGMENTATION
+// Note: on the ESP8266 this walks the list of free blocks.
+static uint32_t _heapMaxFreeBlock(void) {
+# if defined(ESP8266)
+	return ESP.getMaxFreeBlockSize();
+# elif defined(ESP32)
+	return ESP.getMaxAllocHeap();
+# else
+	return 0;
+# endif
+}
+# endif
+
+
+//
+//	HeapAccounting
+//
+
+const HeapStatistics &HeapAccounting::statistics(HeapSubsystem subsystem) {
+	return _statistics[subsystem < HEAP_SUBSYSTEMS ? subsystem : HEAP_APPLICATION];
+}
+
+
+unsigned long HeapAccounting::allocations(HeapSubsystem subsystem) {
+	return statistics(subsystem).allocations;
+}
+
+
+HeapSubsystem HeapAccounting::currentSubsystem(void) {
+	return _current;
+}
+
+
+const char *HeapAccounting::name(HeapSubsystem subsystem) {
+	return subsystem < HEAP_SUBSYSTEMS ? _heapSubsystemNames[subsystem] : "";
+}
+
+
+void HeapAccounting::reset(void) {
+	for (int i = 0; i < HEAP_SUBSYSTEMS; i++) {
+		_statistics[i].allocations = 0;
+		_statistics[i].frees = 0;
+		_statistics[i].peakBytes = _statistics[i].currentBytes;
+		_statistics[i].maxFreeBlockImpact = 0;
+	}
+}
+
+
+String HeapAccounting::report(void) {
+	String result;
+	for (int i = 0; i < HEAP_SUBSYSTEMS; i++) {
+		const HeapStatistics &s = _statistics[i];
+		result += String(_heapSubsystemNames[i]) + ": allocations " + String(s.allocations) +
+				  ", frees " + String(s.frees) + ", current " + String(s.currentBytes) +
+				  ", peak " + String(s.peakBytes) + ", free block impact " + String(s.maxFreeBlockImpact) + "\n";
+	}
+	return result;
+}
+
+
+uint8_t HeapAccounting::allocated(size_t size) {
+	HeapSubsystem subsystem = _current;
+	_allocated(subsystem, size);
+	return subsystem;
+}
+
+
+void HeapAccounting::freed(uint8_t tag, size_t size) {
+	if (tag < HEAP_SUBSYSTEMS) {
+		_freed((HeapSubsystem)tag, size);
+	}
+}
+
+
+void HeapAccounting::_allocated(HeapSubsystem subsystem, long size) {
+	HeapStatistics &s = _statistics[subsystem];
+	s.allocations++;
+	s.currentBytes += size;
+	if (s.currentBytes > s.peakBytes) {
+		s.peakBytes = s.currentBytes;
+	}
+}
+
+
+void HeapAccounting::_freed(HeapSubsystem subsystem, long size) {
+	HeapStatistics &s = _statistics[subsystem];
+	s.frees++;
+	s.currentBytes -= size;
+}
+
+
+//
+//	HeapScope
+//
+
+HeapScope::HeapScope(HeapSubsystem subsystem) {
+	_previous = HeapAccounting::_current;
+	_switched = subsystem != _previous && (_previous == HEAP_APPLICATION || subsystem == HEAP_APPLICATION);
+	if (_switched) {
+		HeapAccounting::_current = subsystem;
+		_freeHeap = _heapFree();
+# ifdef HEAP_ACCOUNTING_FRAGMENTATION
+		_maxFreeBlock = _heapMaxFreeBlock();
+# endif
+		_scopedBytes = HeapAccounting::_scopedBytes;
+	}
+}
+
+
+HeapScope::~HeapScope() {
+	if ( ! _switched) {
+		return;
+	}
+# ifdef HEAP_ACCOUNTING_FRAGMENTATION
+	HeapStatistics 	&s = HeapAccounting::_statistics[HeapAccounting::_current];
+	long impact = (long)_maxFreeBlock - (long)_heapMaxFreeBlock();
+	if (impact > s.maxFreeBlockImpact) {
+		s.maxFreeBlockImpact = impact;
+	}
+# endif
+
+# ifndef HEAP_ACCOUNTING_HOOK
+	// Bytes that were allocated during this scope, without those that were
+	// already attributed by nested scopes. Without a hook, allocations and
+	// frees count the calls that increased or decreased the used heap.
+	HeapSubsystem subsystem = HeapAccounting::_current;
+	long bytes = (long)_freeHeap - (long)_heapFree() - (HeapAccounting::_scopedBytes - _scopedBytes);
+	HeapAccounting::_scopedBytes += bytes;
+	if (bytes > 0) {
+		HeapAccounting::_allocated(subsystem, bytes);
+	} else if (bytes < 0) {
+		HeapAccounting::_freed(subsystem, -bytes);
+	}
+# endif
+	HeapAccounting::_current = _previous;
+}
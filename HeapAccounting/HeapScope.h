@@ -0,0 +1,23 @@
+/*
+ *	HeapScope.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	The HEAP_SCOPE() macro for the libraries. Each library includes this
+ *	file instead of HeapAccounting.h.
+ */
+
+# ifndef __HEAPSCOPE_H__
+# define __HEAPSCOPE_H__
+
+// Define HEAP_ACCOUNTING before including the libraries to enable the
+// accounting. Without it HEAP_SCOPE() is empty, and the libraries need
+// neither HeapAccounting.h nor HeapAccounting.ino.
+# ifdef HEAP_ACCOUNTING
+# include "HeapAccounting.h"
+# elif ! defined(HEAP_SCOPE)
+# define HEAP_SCOPE(subsystem)
+# endif
+
+# endif
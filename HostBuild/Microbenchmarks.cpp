@@ -0,0 +1,237 @@
+/*
+ *	Microbenchmarks.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Microbenchmarks of the data structures, the task manager, the EEPROM
+ *	store and the HTTP server's helpers on a Linux host. The results are
+ *	printed as CSV, one line per benchmark and size.
+ *
+ *	Usage: Microbenchmarks [filter]
+ *	Only benchmarks whose name contains *filter* are run.
+ */
+
+# include "Arduino.h"
+# include "EEPROM.h"
+# include "../LinkedList/LinkedList.ino"
+# include "../RingBuffer/Ringbuffer.ino"
+# include "../TaskManager/TaskManager.ino"
+# include "../EEPROMStore/EEPROMStore.ino"
+# include "../HttpServer/HttpServer.ino"
+
+// Minimum time of a single benchmark in microseconds
+# ifndef BENCHMARK_TIME
+# define BENCHMARK_TIME		200000UL
+# endif
+
+// Port of the HttpServer for the check() benchmark
+# ifndef BENCHMARK_PORT
+# define BENCHMARK_PORT		18090
+# endif
+
+static const char 		*filter = NULL;
+static volatile long 	 sink = 0;		// keeps the compiler from removing results
+
+
+// Call *operation* repeatedly with an increasing counter until BENCHMARK_TIME
+// has passed and print a line of results. *opsPerCall* is the number of
+// operations that are performed by a single call, e.g. the elements of a
+// list that is traversed.
+template<typename F>
+static void measure(const char *benchmark, long size, long opsPerCall, F operation) {
+	if (filter != NULL && strstr(benchmark, filter) == NULL) {
+		return;
+	}
+	unsigned long 	calls = 0;
+	unsigned long 	allocations = hostHeapAllocations();
+	unsigned long 	erases = EEPROM.sectorErases;
+	unsigned long 	bytesWritten = EEPROM.bytesWritten;
+	unsigned long 	start = micros();
+	unsigned long 	elapsed;
+	do {
+		for (int i = 0; i < 16; i++) {
+			operation(calls++);
+		}
+		elapsed = micros() - start;
+	} while (elapsed < BENCHMARK_TIME);
+
+	double ops = (double)calls * opsPerCall;
+	printf("%s,%ld,%.0f,%.2f,%.0f,%.3f,%.4f,%.1f\n", benchmark, size, ops,
+		   elapsed * 1000.0 / ops, ops * 1000000.0 / elapsed,
+		   (hostHeapAllocations() - allocations) / ops,
+		   (EEPROM.sectorErases - erases) / ops,
+		   (EEPROM.bytesWritten - bytesWritten) / ops);
+	fflush(stdout);
+}
+
+
+//
+//	LinkedList
+//
+
+static void benchmarkLinkedList(int size) {
+	measure("LinkedList.append", size, size, [size](unsigned long) {
+		LinkedList<int> list;
+		for (int i = 0; i < size; i++) {
+			list.add(i);
+		}
+	});
+
+	LinkedList<int> list;
+	for (int i = 0; i < size; i++) {
+		list.add(i);
+	}
+	measure("LinkedList.getLast", size, 1, [&list](unsigned long) {
+		sink += list.get(list.size() - 1);
+	});
+	measure("LinkedList.iterate", size, size, [&list](unsigned long) {
+		for (int i = 0; i < list.size(); i++) {
+			sink += list.get(i);
+		}
+	});
+}
+
+
+//
+//	RingBuffer
+//
+
+static void benchmarkRingBuffer(int size) {
+	RingBuffer<int> ringBuffer(size);
+	measure("RingBuffer.add", size, 1, [&ringBuffer](unsigned long n) {
+		ringBuffer.add(n);
+	});
+	measure("RingBuffer.get", size, 1, [&ringBuffer, size](unsigned long n) {
+		sink += ringBuffer.get(n % size);
+	});
+}
+
+
+//
+//	TaskManager
+//
+
+static bool emptyTask() {
+	sink++;
+	return true;
+}
+
+
+// Measure a runTasks() call with *count* tasks that are not due (idle) and
+// with *count* tasks that are due at every call.
+static void benchmarkTaskManager(int count) {
+	TaskManager idleTaskManager;
+	for (int i = 0; i < count; i++) {
+		idleTaskManager.addTask(emptyTask, 1000000UL);
+	}
+	idleTaskManager.runTasks();	// all tasks are run once after being started
+	measure("TaskManager.runTasks.idle", count, 1, [&idleTaskManager](unsigned long) {
+		idleTaskManager.runTasks();
+	});
+
+	TaskManager dueTaskManager;
+	for (int i = 0; i < count; i++) {
+		dueTaskManager.addTask(emptyTask, 0);		// due at every call
+	}
+	measure("TaskManager.runTasks.due", count, 1, [&dueTaskManager](unsigned long) {
+		dueTaskManager.runTasks();
+	});
+}
+
+
+//
+//	EEPROMStore
+//
+
+// Measure storing values of *size* bytes. Every put is committed to the
+// simulated flash, unless the value did not change.
+static void benchmarkEEPROMStore(int size) {
+	EEPROMStore store(8, size + 1);
+	String 		values[2];
+	for (int i = 0; i < size; i++) {
+		values[0] += (char)('a' + i % 26);
+		values[1] += (char)('A' + i % 26);
+	}
+	measure("EEPROMStore.putString", size, 1, [&store, &values](unsigned long n) {
+		store.putString(n % 8, values[n / 8 % 2]);
+	});
+	measure("EEPROMStore.putString.unchanged", size, 1, [&store, &values](unsigned long) {
+		store.putString(0, values[0]);
+	});
+	store.putString(0, values[0]);
+	measure("EEPROMStore.getString", size, 1, [&store](unsigned long) {
+		sink += store.getString(0).length();
+	});
+	measure("EEPROMStore.put", size, 1, [&store](unsigned long n) {
+		long value = n;
+		store.put(n % 8, value);
+	});
+}
+
+
+//
+//	HttpServer
+//
+
+static void benchmarkHttpServer(int size) {
+	String plain;
+	String encoded;
+	String arguments = "/form?";
+	for (int i = 0; plain.length() < (unsigned int)size; i++) {
+		plain += "value" + String(i) + " ";
+		encoded += "value" + String(i) + "%20";
+		if (i > 0) {
+			arguments += "&";
+		}
+		arguments += "key" + String(i) + "=value%20" + String(i);
+	}
+	measure("HttpServer.urlDecode.plain", size, 1, [&plain](unsigned long) {
+		sink += HttpServer::urlDecode(plain).length();
+	});
+	measure("HttpServer.urlDecode.encoded", size, 1, [&encoded](unsigned long) {
+		sink += HttpServer::urlDecode(encoded).length();
+	});
+	measure("HttpServer.parseRequestArguments", size, 1, [&arguments](unsigned long) {
+		sink += HttpServer::parseRequestArguments(arguments);
+	});
+}
+
+
+// Measure a check() call of a server without pending connections, which is
+// called from the main loop.
+static void benchmarkHttpServerCheck(void) {
+	HttpServer server(BENCHMARK_PORT);
+	measure("HttpServer.check.idle", 0, 1, [&server](unsigned long) {
+		server.check();
+	});
+}
+
+
+int main(int argc, char **argv) {
+	filter = argc > 1 ? argv[1] : NULL;
+	printf("benchmark,size,operations,ns_per_op,ops_per_sec,allocations_per_op,flash_erases_per_op,flash_bytes_per_op\n");
+
+	const int listSizes[] = { 10, 100, 1000 };
+	for (unsigned int i = 0; i < sizeof(listSizes) / sizeof(listSizes[0]); i++) {
+		benchmarkLinkedList(listSizes[i]);
+	}
+	const int ringBufferSizes[] = { 16, 256 };
+	for (unsigned int i = 0; i < sizeof(ringBufferSizes) / sizeof(ringBufferSizes[0]); i++) {
+		benchmarkRingBuffer(ringBufferSizes[i]);
+	}
+	const int taskCounts[] = { 1, 10, 50 };
+	for (unsigned int i = 0; i < sizeof(taskCounts) / sizeof(taskCounts[0]); i++) {
+		benchmarkTaskManager(taskCounts[i]);
+	}
+	const int valueSizes[] = { 16, 128 };
+	for (unsigned int i = 0; i < sizeof(valueSizes) / sizeof(valueSizes[0]); i++) {
+		benchmarkEEPROMStore(valueSizes[i]);
+	}
+	const int urlSizes[] = { 32, 256 };
+	for (unsigned int i = 0; i < sizeof(urlSizes) / sizeof(urlSizes[0]); i++) {
+		benchmarkHttpServer(urlSizes[i]);
+	}
+	benchmarkHttpServerCheck();
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ *	MockCSE.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	A minimal oneM2M CSE for host builds, served in the same process as the
+ *	OneM2M client. It supports the creation, retrieval and deletion of AE,
+ *	Container, ContentInstance and Subscription resources with JSON and CBOR
+ *	serialization, and sends notifications to subscribers. Connections are
+ *	kept open, and pipelined requests are answered in order.
+ */
+
+# ifndef __MOCKCSE__
+# define __MOCKCSE__
+
+# include <ESP8266WiFi.h>
+# include "LinkedList.h"
+
+// Time in milliseconds to wait for the answer to a notification.
+# ifndef MOCKCSE_NOTIFICATION_TIMEOUT
+# define MOCKCSE_NOTIFICATION_TIMEOUT	2000
+# endif
+
+// Size of the receive buffer of a connection, and of encoded CBOR responses.
+// A request must fit completely into the buffer.
+# ifndef MOCKCSE_BUFFER_SIZE
+# define MOCKCSE_BUFFER_SIZE			4096
+# endif
+
+
+class MockCSE {
+public:
+
+	// Struct that holds statistics about the mock CSE.
+	struct Statistics {
+		unsigned long requests;
+		unsigned long connections;				// accepted connections
+		unsigned long creates;
+		unsigned long retrieves;
+		unsigned long deletes;
+		unsigned long cborRequests;				// requests with a CBOR body or a CBOR response
+		unsigned long errors;					// answers with a status code >= 400
+		unsigned long notifications;			// notifications that were answered
+		unsigned long notificationFailures;		// notifications that could not be sent or were not answered
+	};
+
+private:
+
+	// internal struct for keeping resources
+	struct Resource {
+		String 			path;				// structured path, e.g. /cse/myAE/myContainer
+		String 			resourceIdentifier;
+		int 			type;
+		String 			representation;		// complete JSON representation
+		String 			notificationURI;	// only for Subscriptions
+		String 			latest;				// representation of the latest ContentInstance of a Container
+	};
+
+	// internal struct for an open connection of a client
+	struct Session {
+		WiFiClient 		client;
+		uint8_t 		buffer[MOCKCSE_BUFFER_SIZE];	// received data that is not handled yet
+		size_t 			length;
+	};
+
+	// internal struct for a received request
+	struct Request {
+		String 			method;
+		String 			path;
+		String 			contentType;
+		String 			accept;
+		String 			content;			// JSON-encoded body, CBOR bodies are converted
+		bool 			close;				// the client asked to close the connection
+	};
+
+	// internal struct for the result of a request
+	struct Result {
+		int 			returnCode;
+		int 			responseStatusCode;
+		String 			content;			// JSON-encoded resource
+	};
+
+	// internal struct for a CBOR encoder that writes into a fixed buffer
+	struct CborBuffer {
+		uint8_t 		*data;
+		size_t 			 size;
+		size_t 			 length;
+		bool 			 overflow;
+	};
+
+	// internal struct for pending notifications
+	struct Notification {
+		String 			host;
+		int 			port;
+		String 			path;
+		String 			body;
+		WiFiClient 		client;
+		bool 			sent;
+		unsigned long 	timestamp;
+	};
+
+	static MockCSE 				*_instance;
+	WiFiServer 					*_server;
+	String 						 _cseName;
+	LinkedList<Resource *> 		 _resources;
+	LinkedList<Session *> 		 _sessions;
+	LinkedList<Notification *> 	 _notifications;
+	unsigned long 				 _nextIdentifier;
+	Statistics 					 _statistics;
+	int 						 _dropRequests;
+	bool 						 _dropHandle;
+	int 						 _failRequests;
+	int 						 _failCode;
+	int 						 _stopAfter;		// requests to answer before stopping, or -1
+	String 						 _forbidden;		// path of the resources that are not accessible
+
+	static void 		_backgroundTask(void);
+
+	void 				_acceptSessions(void);
+	bool 				_serveSession(Session *session);
+	long 				_parseRequest(Session *session, Request &request);
+	void 				_answer(Session *session, const Request &request, Result result);
+	Result 				_handleRequest(const Request &request);
+	Result 				_create(String path, int type, String content);
+	Result 				_retrieve(String path);
+	Result 				_delete(String path);
+	Result 				_result(int returnCode, int responseStatusCode, String content);
+	Resource 			*_findResource(String path);
+	void 				_notify(Resource *container);
+	void 				_queueNotification(String uri, String body);
+	void 				_sendNotifications(void);
+	static void 		_write(WiFiClient &client, const uint8_t *data, size_t length);
+	static String 		_attribute(String content, String name);
+	static String 		_typeName(int type);
+	static String 		_reasonPhrase(int returnCode);
+	static bool 		_cborToJson(const uint8_t *data, size_t length, size_t &position, String &json, int depth = 0);
+	static bool 		_jsonToCbor(const String &json, unsigned int &position, CborBuffer &cbor);
+	static void 		_cborHead(CborBuffer &cbor, uint8_t major, uint64_t value);
+	static void 		_cborBytes(CborBuffer &cbor, const uint8_t *data, size_t length);
+
+
+public:
+
+	//	Constructor to initialize the mock CSE.
+	//	*port* is the port for the CSE to bind and listen.
+	//	*cseName* is the resource name of the CSEBase. Resource paths start
+	//	with "/" followed by this name.
+	//	The CSE is served by yield() and delay(), so it answers requests while
+	//	a OneM2M client waits for a response. Only one instance can exist
+	//	at a time.
+	MockCSE(int port, String cseName = "cse");
+
+	//	Destructor. All connections are closed and all resources are removed.
+	~MockCSE();
+
+	//	Accept new connections, receive and answer pending requests, and send
+	//	pending notifications. This method is called by yield() and delay(),
+	//	but it can also be called directly.
+	void 				check(void);
+
+	//	Close the connections of the next requests without answering them, 
+	//	like a CSE that closes an idle connection while a request arrives.
+	//	*count* is the number of requests.
+	//	*handle* determines whether the requests are handled before the 
+	//	connection is closed, e.g. whether a resource is created.
+	void 				dropRequests(int count, bool handle = true);
+
+	//	Answer the next requests with an error without handling them, e.g.
+	//	like an overloaded CSE.
+	//	*count* is the number of requests.
+	//	*returnCode* is the HTTP status code of the answers.
+	void 				failRequests(int count, int returnCode = 503);
+
+	//	Stop the CSE like a CSE that is not reachable. All connections are
+	//	closed and new connections are refused. The resources are kept.
+	void 				stop(void);
+
+	//	Start a stopped CSE again.
+	void 				start(void);
+
+	//	Stop the CSE after the next requests were answered, e.g. in the 
+	//	middle of pipelined requests.
+	//	*count* is the number of requests to answer.
+	void 				stopAfter(int count);
+
+	//	Answer requests for a resource and its child resources with 
+	//	*403 Forbidden*, like a CSE that revoked the access rights. 
+	//	*path* is the resource path of the resource. An empty path makes all
+	//	resources accessible again.
+	void 				forbid(String path);
+
+	//	Remove a resource and its child resources without a request, like
+	//	another application that deleted them.
+	//	*path* is the resource path of the resource.
+	//	This method returns false if the resource doesn't exist.
+	bool 				removeResource(String path);
+
+	//	Return the number of resources, including the CSEBase.
+	int 				resourceCount(void);
+
+	//	Return the number of open connections of clients.
+	int 				openConnections(void);
+
+	//	Return the number of notifications that are not answered yet.
+	int 				pendingNotifications(void);
+
+	//	Return statistics about the requests and notifications.
+	const Statistics 	&statistics(void);
+};
+
+# endif
@@ -0,0 +1,994 @@
+/*
+ *	MockCSE.ino
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	A minimal oneM2M CSE for host builds.
+ */
+
+# include "MockCSE.h"
+
+// Maximum nesting depth of decoded CBOR documents
+# define MOCKCSE_CBOR_MAX_DEPTH		32
+
+MockCSE *MockCSE::_instance = NULL;
+
+
+MockCSE::MockCSE(int port, String cseName) {
+	hostHeapSuspend();
+	_instance = this;
+	_cseName = cseName;
+	_nextIdentifier = 0;
+	_dropRequests = 0;
+	_dropHandle = false;
+	_failRequests = 0;
+	_failCode = 503;
+	_stopAfter = -1;
+	memset(&_statistics, 0, sizeof(_statistics));
+
+	// The CSEBase is the root of all resources
+	Resource *cseBase = new Resource();
+	cseBase->path = "/" + cseName;
+	cseBase->resourceIdentifier = "id-" + cseName;
+	cseBase->type = 5;
+	cseBase->representation = "{\"m2m:cb\":{\"rn\":\"" + cseName + "\",\"ri\":\"" + cseBase->resourceIdentifier +
+							  "\",\"ty\":5,\"csi\":\"/" + cseBase->resourceIdentifier + "\"}}";
+	_resources.add(cseBase);
+
+	_server = new WiFiServer(port);
+	_server->begin();
+	hostSetBackgroundTask(_backgroundTask);
+	hostHeapResume();
+}
+
+
+MockCSE::~MockCSE() {
+	hostHeapSuspend();
+	hostSetBackgroundTask(NULL);
+	for (int i = 0; i < _resources.size(); i++) {
+		delete _resources.get(i);
+	}
+	_resources.clear();
+	for (int i = 0; i < _sessions.size(); i++) {
+		Session *session = _sessions.get(i);
+		session->client.stop();
+		delete session;
+	}
+	_sessions.clear();
+	for (int i = 0; i < _notifications.size(); i++) {
+		Notification *notification = _notifications.get(i);
+		notification->client.stop();
+		delete notification;
+	}
+	_notifications.clear();
+	delete _server;
+	_instance = NULL;
+	hostHeapResume();
+}
+
+
+// Allocations of the CSE are not counted by the host's heap accounting, so
+// only the client's allocations are measured.
+void MockCSE::check(void) {
+	hostHeapSuspend();
+	_acceptSessions();
+	for (int i = 0; i < _sessions.size(); ) {
+		Session *session = _sessions.get(i);
+		if (_serveSession(session)) {
+			i++;
+			continue;
+		}
+		session->client.stop();
+		_sessions.remove(i);
+		delete session;
+	}
+	if (_stopAfter == 0) {
+		_stopAfter = -1;
+		stop();
+	}
+	_sendNotifications();
+	hostHeapResume();
+}
+
+
+void MockCSE::dropRequests(int count, bool handle) {
+	_dropRequests = count;
+	_dropHandle = handle;
+}
+
+
+void MockCSE::failRequests(int count, int returnCode) {
+	_failRequests = count;
+	_failCode = returnCode;
+}
+
+
+void MockCSE::stop(void) {
+	hostHeapSuspend();
+	for (int i = 0; i < _sessions.size(); i++) {
+		Session *session = _sessions.get(i);
+		session->client.stop();
+		delete session;
+	}
+	_sessions.clear();
+	_server->stop();
+	hostHeapResume();
+}
+
+
+void MockCSE::start(void) {
+	_server->begin();
+}
+
+
+void MockCSE::stopAfter(int count) {
+	_stopAfter = count;
+}
+
+
+void MockCSE::forbid(String path) {
+	_forbidden = path;
+}
+
+
+bool MockCSE::removeResource(String path) {
+	hostHeapSuspend();
+	bool removed = _delete(path).returnCode == 200;
+	hostHeapResume();
+	return removed;
+}
+
+
+int MockCSE::resourceCount(void) {
+	return _resources.size();
+}
+
+
+int MockCSE::openConnections(void) {
+	return _sessions.size();
+}
+
+
+int MockCSE::pendingNotifications(void) {
+	return _notifications.size();
+}
+
+
+const MockCSE::Statistics &MockCSE::statistics(void) {
+	return _statistics;
+}
+
+
+//
+//	Connections
+//
+
+void MockCSE::_backgroundTask(void) {
+	if (_instance != NULL) {
+		_instance->check();
+	}
+}
+
+
+// Accept all pending connections
+void MockCSE::_acceptSessions(void) {
+	while (true) {
+		WiFiClient client = _server->available();
+		if ( ! client) {
+			return;
+		}
+		Session *session = new Session();
+		session->client = client;
+		session->length = 0;
+		_sessions.add(session);
+		_statistics.connections++;
+	}
+}
+
+
+// Receive the available data of a connection and answer all complete
+// requests in the order they were received. This method returns false if
+// the connection is closed.
+bool MockCSE::_serveSession(Session *session) {
+	if (_stopAfter == 0) {	// stopping
+		return false;
+	}
+	if (session->client.available() > 0 && session->length < sizeof(session->buffer)) {
+		session->length += session->client.read(session->buffer + session->length, sizeof(session->buffer) - session->length);
+	}
+	while (session->length > 0) {
+		Request request;
+		long consumed = _parseRequest(session, request);
+		if (consumed == 0) {	// incomplete
+			break;
+		}
+		if (consumed < 0) {
+			request.close = true;
+			_answer(session, request, _result(400, 4000, "{\"m2m:dbg\":\"invalid request\"}"));
+			return false;
+		}
+		session->length -= consumed;
+		memmove(session->buffer, session->buffer + consumed, session->length);
+		if (_dropRequests > 0) {
+			_dropRequests--;
+			if (_dropHandle) {
+				_handleRequest(request);
+			}
+			return false;
+		}
+		_answer(session, request, _handleRequest(request));
+		if (request.close || (_stopAfter > 0 && --_stopAfter == 0)) {
+			return false;
+		}
+	}
+	if (session->length == sizeof(session->buffer)) {
+		Request request;
+		request.close = true;
+		_answer(session, request, _result(413, 5000, "{\"m2m:dbg\":\"request too large\"}"));
+		return false;
+	}
+	return session->client.connected();
+}
+
+
+// Parse the request at the beginning of the receive buffer of a connection.
+// This method returns the length of the request, 0 if the request is not
+// complete yet, or -1 if the request is invalid. A CBOR-encoded body is
+// converted to JSON.
+long MockCSE::_parseRequest(Session *session, Request &request) {
+	const char *data = (const char *)session->buffer;
+	const char *end = (const char *)memmem(data, session->length, "\r\n\r\n", 4);
+	if (end == NULL) {
+		return 0;
+	}
+	String header;
+	header.concat(data, end - data + 2);
+
+	// request line, e.g. "POST /cse/myAE HTTP/1.1"
+	int idx = header.indexOf("\r\n");
+	String line = header.substring(0, idx);
+	int idxPath = line.indexOf(' ');
+	int idxVersion = line.indexOf(' ', idxPath + 1);
+	if (idxPath <= 0 || idxVersion < 0) {
+		return -1;
+	}
+	request.method = line.substring(0, idxPath);
+	request.path = line.substring(idxPath + 1, idxVersion);
+	String version = line.substring(idxVersion + 1);
+	if ((idx = request.path.indexOf('?')) > -1) {
+		request.path = request.path.substring(0, idx);
+	}
+
+	// header fields
+	long 	contentLength = 0;
+	String 	connection;
+	int 	start = header.indexOf("\r\n") + 2;
+	while (start < (int)header.length()) {
+		int lineEnd = header.indexOf("\r\n", start);
+		line = header.substring(start, lineEnd);
+		start = lineEnd + 2;
+		idx = line.indexOf(':');
+		if (idx < 0) {
+			return -1;
+		}
+		String name = line.substring(0, idx);
+		String value = line.substring(idx + 1);
+		name.toLowerCase();
+		value.trim();
+		if (name == "content-type") {
+			request.contentType = value;
+		} else if (name == "content-length") {
+			contentLength = value.toInt();
+		} else if (name == "accept") {
+			request.accept = value;
+		} else if (name == "connection") {
+			value.toLowerCase();
+			connection = value;
+		}
+	}
+	request.close = version == "HTTP/1.0" ? connection != "keep-alive" : connection == "close";
+
+	// body
+	long headerLength = end - data + 4;
+	if (contentLength < 0 || headerLength + contentLength > (long)sizeof(session->buffer)) {
+		return -1;
+	}
+	if (headerLength + contentLength > (long)session->length) {
+		return 0;
+	}
+	const uint8_t *body = session->buffer + headerLength;
+	if (request.contentType.indexOf("cbor") > -1) {
+		size_t position = 0;
+		if ( ! _cborToJson(body, contentLength, position, request.content) || position != (size_t)contentLength) {
+			request.content = "";	// rejected as invalid content
+		}
+	} else {
+		request.content.concat((const char *)body, contentLength);
+	}
+	return headerLength + contentLength;
+}
+
+
+// Send the answer to a request. The resource is CBOR-encoded if the
+// request accepts CBOR.
+void MockCSE::_answer(Session *session, const Request &request, Result result) {
+	uint8_t 		encoded[MOCKCSE_BUFFER_SIZE];
+	const uint8_t 	*body = (const uint8_t *)result.content.c_str();
+	size_t 			bodyLength = result.content.length();
+	bool 			cbor = false;
+
+	if (request.accept.indexOf("cbor") > -1 && bodyLength > 0) {
+		CborBuffer 		buffer = { encoded, sizeof(encoded), 0, false };
+		unsigned int 	position = 0;
+		if (_jsonToCbor(result.content, position, buffer) && ! buffer.overflow) {
+			body = encoded;
+			bodyLength = buffer.length;
+			cbor = true;
+		}
+	}
+	if (cbor || request.contentType.indexOf("cbor") > -1) {
+		_statistics.cborRequests++;
+	}
+	String header = "HTTP/1.1 " + String(result.returnCode) + " " + _reasonPhrase(result.returnCode) + "\r\n" +
+					"Content-Type: application/" + (cbor ? "cbor" : "json") + "\r\n" +
+					"Content-Length: " + String((unsigned long)bodyLength) + "\r\n" +
+					"X-M2M-RSC: " + String(result.responseStatusCode) + "\r\n" +
+					"Connection: " + (request.close ? "close" : "keep-alive") + "\r\n\r\n";
+	_write(session->client, (const uint8_t *)header.c_str(), header.length());
+	_write(session->client, body, bodyLength);
+}
+
+
+// Write all data, also if the client accepts only a part of each write
+void MockCSE::_write(WiFiClient &client, const uint8_t *data, size_t length) {
+	size_t written = 0;
+	while (written < length && client.connected()) {
+		written += client.write(data + written, length - written);
+	}
+}
+
+
+//
+//	Request handling
+//
+
+MockCSE::Result MockCSE::_handleRequest(const Request &request) {
+	_statistics.requests++;
+	if (_forbidden.length() > 0 && (request.path == _forbidden || request.path.startsWith(_forbidden + "/"))) {
+		return _result(403, 4103, "{\"m2m:dbg\":\"access denied\"}");
+	}
+	if (_failRequests > 0) {
+		_failRequests--;
+		return _result(_failCode, _failCode >= 500 ? 5000 : 4000, "{\"m2m:dbg\":\"request failed\"}");
+	}
+	if (request.method == "GET") {
+		_statistics.retrieves++;
+		return _retrieve(request.path);
+	}
+	if (request.method == "POST") {
+		int idx = request.contentType.indexOf("ty=");
+		if (idx < 0 || request.content.length() == 0) {
+			return _result(400, 4000, "{\"m2m:dbg\":\"missing resource type or content\"}");
+		}
+		_statistics.creates++;
+		return _create(request.path, request.contentType.substring(idx + 3).toInt(), request.content);
+	}
+	if (request.method == "DELETE") {
+		_statistics.deletes++;
+		return _delete(request.path);
+	}
+	return _result(405, 4005, "{\"m2m:dbg\":\"operation not allowed\"}");
+}
+
+
+// Create a resource under the resource *path*. The representation of the new
+// resource is the request's content with the attributes that are assigned by
+// the CSE added. ContentInstances are not stored as separate resources, only
+// the latest ContentInstance of a Container is kept.
+MockCSE::Result MockCSE::_create(String path, int type, String content) {
+	Resource *parent = _findResource(path);
+	if (parent == NULL) {
+		return _result(404, 4004, "{\"m2m:dbg\":\"parent resource not found\"}");
+	}
+	int start = content.indexOf('{', 1);	// start of the resource's attributes
+	if ( ! content.startsWith("{\"") || start < 0) {
+		return _result(400, 4000, "{\"m2m:dbg\":\"invalid content\"}");
+	}
+	bool valid = false;
+	switch (type) {
+		case 2:		valid = parent->type == 5; break;						// AE
+		case 3:		valid = parent->type == 2 || parent->type == 3; break;	// Container
+		case 4:		valid = parent->type == 3; break;						// ContentInstance
+		case 23:	valid = parent->type == 2 || parent->type == 3; break;	// Subscription
+	}
+	if ( ! valid) {
+		return _result(400, 4000, "{\"m2m:dbg\":\"invalid child resource type\"}");
+	}
+
+	String resourceIdentifier = _typeName(type) + String(++_nextIdentifier);
+	String resourceName = _attribute(content, "rn");
+	String attributes = "\"ri\":\"" + resourceIdentifier + "\",\"pi\":\"" + parent->resourceIdentifier + "\",\"ty\":" + String(type);
+	if (resourceName.length() == 0) {
+		resourceName = _typeName(type) + "_" + String(_nextIdentifier);
+		attributes = "\"rn\":\"" + resourceName + "\"," + attributes;
+	}
+	if (content[start + 1] != '}') {
+		attributes += ",";
+	}
+	String representation = content.substring(0, start + 1) + attributes + content.substring(start + 1);
+
+	if (type == 4) {
+		parent->latest = representation;
+		_notify(parent);
+		return _result(201, 2001, representation);
+	}
+
+	String resourcePath = parent->path + "/" + resourceName;
+	if (_findResource(resourcePath) != NULL) {
+		return _result(409, 4105, "{\"m2m:dbg\":\"resource already exists\"}");
+	}
+	Resource *resource = new Resource();
+	resource->path = resourcePath;
+	resource->resourceIdentifier = resourceIdentifier;
+	resource->type = type;
+	resource->representation = representation;
+	if (type == 23) {
+		resource->notificationURI = _attribute(content, "nu");
+		_queueNotification(resource->notificationURI,
+						   "{\"m2m:sgn\":{\"m2m:vrq\":true,\"m2m:sur\":\"" + resourceIdentifier + "\"}}");
+	}
+	_resources.add(resource);
+	return _result(201, 2001, representation);
+}
+
+
+// Retrieve a resource, or the latest ContentInstance of a Container
+MockCSE::Result MockCSE::_retrieve(String path) {
+	if (path.endsWith("/la")) {
+		Resource *container = _findResource(path.substring(0, path.length() - 3));
+		if (container != NULL && container->type == 3 && container->latest.length() > 0) {
+			return _result(200, 2000, container->latest);
+		}
+	}
+	Resource *resource = _findResource(path);
+	if (resource == NULL) {
+		return _result(404, 4004, "{\"m2m:dbg\":\"resource not found\"}");
+	}
+	return _result(200, 2000, resource->representation);
+}
+
+
+// Delete a resource and all its child resources
+MockCSE::Result MockCSE::_delete(String path) {
+	Resource *resource = _findResource(path);
+	if (resource == NULL || resource->type == 5) {
+		return _result(resource == NULL ? 404 : 405, resource == NULL ? 4004 : 4005, "{\"m2m:dbg\":\"cannot delete resource\"}");
+	}
+	Result result = _result(200, 2002, resource->representation);
+	String prefix = path + "/";
+	for (int i = _resources.size() - 1; i >= 0; i--) {
+		Resource *r = _resources.get(i);
+		if (r->path == path || r->path.startsWith(prefix)) {
+			_resources.remove(i);
+			delete r;
+		}
+	}
+	return result;
+}
+
+
+// Return a request's result. Errors contain a short debug message.
+MockCSE::Result MockCSE::_result(int returnCode, int responseStatusCode, String content) {
+	Result result;
+	result.returnCode = returnCode;
+	result.responseStatusCode = responseStatusCode;
+	result.content = content;
+	if (returnCode >= 400) {
+		_statistics.errors++;
+	}
+	return result;
+}
+
+
+MockCSE::Resource *MockCSE::_findResource(String path) {
+	for (int i = 0; i < _resources.size(); i++) {
+		Resource *resource = _resources.get(i);
+		if (resource->path == path) {
+			return resource;
+		}
+	}
+	return NULL;
+}
+
+
+//
+//	Notifications
+//
+
+// Send a notification about the latest ContentInstance to all Subscriptions of
+// a Container
+void MockCSE::_notify(Resource *container) {
+	String prefix = container->path + "/";
+	for (int i = 0; i < _resources.size(); i++) {
+		Resource *subscription = _resources.get(i);
+		if (subscription->type == 23 && subscription->path.startsWith(prefix) &&
+			subscription->path.indexOf('/', prefix.length()) < 0) {		// direct child
+			_queueNotification(subscription->notificationURI,
+							   "{\"m2m:sgn\":{\"m2m:nev\":{\"m2m:rep\":" + container->latest +
+							   ",\"m2m:net\":3},\"m2m:sur\":\"" + subscription->resourceIdentifier + "\"}}");
+		}
+	}
+}
+
+
+// Queue a notification for a notification URI like http://host:port/path.
+// Notifications are sent after the current request was answered, because
+// the receiver is served in the same process.
+void MockCSE::_queueNotification(String uri, String body) {
+	if ( ! uri.startsWith("http://")) {
+		_statistics.notificationFailures++;
+		return;
+	}
+	Notification *notification = new Notification();
+	int idxPath = uri.indexOf('/', 7);
+	String address = idxPath > -1 ? uri.substring(7, idxPath) : uri.substring(7);
+	int idxPort = address.indexOf(':');
+	notification->host = idxPort > -1 ? address.substring(0, idxPort) : address;
+	notification->port = idxPort > -1 ? address.substring(idxPort + 1).toInt() : 80;
+	notification->path = idxPath > -1 ? uri.substring(idxPath) : "/";
+	notification->body = body;
+	notification->sent = false;
+	notification->timestamp = millis();
+	_notifications.add(notification);
+}
+
+
+// Send queued notifications and receive their answers without waiting
+void MockCSE::_sendNotifications(void) {
+	for (int i = 0; i < _notifications.size(); ) {
+		Notification *notification = _notifications.get(i);
+		bool done = false;
+		if ( ! notification->sent) {
+			if (notification->client.connect(notification->host.c_str(), notification->port)) {
+				String request = "POST " + notification->path + " HTTP/1.1\r\n" +
+								 "Host: " + notification->host + "\r\n" +
+								 "X-M2M-Origin: /id-" + _cseName + "\r\n" +
+								 "Content-Type: application/json\r\n" +
+								 "Content-Length: " + String(notification->body.length()) + "\r\n\r\n" +
+								 notification->body;
+				_write(notification->client, (const uint8_t *)request.c_str(), request.length());
+				notification->sent = true;
+			} else {
+				_statistics.notificationFailures++;
+				done = true;
+			}
+		} else if (notification->client.available() > 0 || ! notification->client.connected()) {
+			String status = notification->client.readStringUntil('\n');
+			if (status.startsWith("HTTP/1.1 200")) {
+				_statistics.notifications++;
+			} else {
+				_statistics.notificationFailures++;
+			}
+			done = true;
+		} else if (millis() - notification->timestamp > MOCKCSE_NOTIFICATION_TIMEOUT) {
+			_statistics.notificationFailures++;
+			done = true;
+		}
+		if (done) {
+			notification->client.stop();
+			_notifications.remove(i);
+			delete notification;
+		} else {
+			i++;
+		}
+	}
+}
+
+
+//
+//	CBOR
+//
+
+// Convert the CBOR item at *position* to JSON text and append it to *json*.
+// *position* is moved behind the item. This method returns false if the
+// item is malformed. Byte strings are converted like text strings, and tags
+// are ignored.
+bool MockCSE::_cborToJson(const uint8_t *data, size_t length, size_t &position, String &json, int depth) {
+	if (position >= length || depth > MOCKCSE_CBOR_MAX_DEPTH) {
+		return false;
+	}
+	uint8_t 	major = data[position] >> 5;
+	uint8_t 	info = data[position] & 0x1f;
+	uint64_t 	argument = info;
+	bool 		indefinite = false;
+	char 		number[32];
+
+	position++;
+	if (info >= 24 && info <= 27) {
+		int bytes = 1 << (info - 24);
+		if (position + bytes > length) {
+			return false;
+		}
+		argument = 0;
+		for (int i = 0; i < bytes; i++) {
+			argument = (argument << 8) | data[position++];
+		}
+	} else if (info == 31 && major >= 2 && major <= 5) {
+		indefinite = true;
+	} else if (info > 27) {
+		return false;
+	}
+
+	switch (major) {
+		case 0:
+			snprintf(number, sizeof(number), "%llu", (unsigned long long)argument);
+			json += number;
+			return true;
+
+		case 1:
+			snprintf(number, sizeof(number), "%lld", -1 - (long long)argument);
+			json += number;
+			return true;
+
+		case 2:
+		case 3: {
+			String text;
+			if (indefinite) {	// concatenate the definite-length chunks
+				while (position < length && data[position] != 0xff) {
+					String chunk;
+					if (data[position] >> 5 != major || (data[position] & 0x1f) == 31 ||
+						! _cborToJson(data, length, position, chunk, depth + 1)) {
+						return false;
+					}
+					text += chunk.substring(1, chunk.length() - 1);		// remove the quotes
+				}
+				if (position++ >= length) {
+					return false;
+				}
+				json += "\"" + text + "\"";
+				return true;
+			}
+			if (position + argument > length) {
+				return false;
+			}
+			json += '"';
+			for (size_t i = 0; i < argument; i++) {
+				char c = data[position++];
+				if (c == '"' || c == '\\') {
+					json += '\\';
+					json += c;
+				} else if ((uint8_t)c < 0x20) {
+					snprintf(number, sizeof(number), "\\u%04x", c);
+					json += number;
+				} else {
+					json += c;
+				}
+			}
+			json += '"';
+			return true;
+		}
+
+		case 4:
+		case 5: {
+			json += major == 4 ? '[' : '{';
+			for (uint64_t i = 0; indefinite || i < argument; i++) {
+				if (indefinite && position < length && data[position] == 0xff) {
+					position++;
+					break;
+				}
+				if (i > 0) {
+					json += ',';
+				}
+				if (major == 5) {
+					if (position >= length || (data[position] >> 5) != 3 || ! _cborToJson(data, length, position, json, depth + 1)) {
+						return false;	// keys must be text strings
+					}
+					json += ':';
+				}
+				if ( ! _cborToJson(data, length, position, json, depth + 1)) {
+					return false;
+				}
+			}
+			json += major == 4 ? ']' : '}';
+			return true;
+		}
+
+		case 6:		// tag
+			return _cborToJson(data, length, position, json, depth + 1);
+
+		default: {	// simple values and floating-point numbers
+			double value;
+			switch (info) {
+				case 20:	json += "false"; return true;
+				case 21:	json += "true"; return true;
+				case 22:
+				case 23:	json += "null"; return true;
+				case 25: {	// half precision
+					int exponent = (argument >> 10) & 0x1f;
+					int mantissa = argument & 0x3ff;
+					value = exponent == 0 ? ldexp(mantissa, -24) : ldexp(mantissa + 1024, exponent - 25);
+					if (exponent == 31) {
+						return false;
+					}
+					if (argument & 0x8000) {
+						value = -value;
+					}
+					break;
+				}
+				case 26: {
+					uint32_t bits = argument;
+					float f;
+					memcpy(&f, &bits, sizeof(f));
+					value = f;
+					break;
+				}
+				case 27:
+					memcpy(&value, &argument, sizeof(value));
+					break;
+				default:
+					return false;
+			}
+			snprintf(number, sizeof(number), "%.17g", value);
+			json += number;
+			return true;
+		}
+	}
+}
+
+
+// Convert the JSON value at *position* to CBOR. *position* is moved behind
+// the value. Maps and arrays are encoded with definite lengths. This method
+// returns false if the JSON text is malformed.
+bool MockCSE::_jsonToCbor(const String &json, unsigned int &position, CborBuffer &cbor) {
+	while (position < json.length() && isspace(json[position])) {
+		position++;
+	}
+	if (position >= json.length()) {
+		return false;
+	}
+	char c = json[position];
+
+	// objects and arrays. The head is inserted in front of the items when
+	// their number is known.
+	if (c == '{' || c == '[') {
+		char 	close = c == '{' ? '}' : ']';
+		size_t 	start = cbor.length;
+		int 	items = 0;
+		position++;
+		while (true) {
+			while (position < json.length() && isspace(json[position])) {
+				position++;
+			}
+			if (position < json.length() && json[position] == close && items == 0) {
+				position++;
+				break;
+			}
+			if (c == '{') {
+				while (position < json.length() && isspace(json[position])) {
+					position++;
+				}
+				if (position >= json.length() || json[position] != '"' || ! _jsonToCbor(json, position, cbor)) {
+					return false;
+				}
+				while (position < json.length() && isspace(json[position])) {
+					position++;
+				}
+				if (position >= json.length() || json[position++] != ':') {
+					return false;
+				}
+			}
+			if ( ! _jsonToCbor(json, position, cbor)) {
+				return false;
+			}
+			items++;
+			while (position < json.length() && isspace(json[position])) {
+				position++;
+			}
+			if (position >= json.length()) {
+				return false;
+			}
+			if (json[position] == close) {
+				position++;
+				break;
+			}
+			if (json[position++] != ',') {
+				return false;
+			}
+		}
+		uint8_t 	head[9];
+		CborBuffer 	headBuffer = { head, sizeof(head), 0, false };
+		_cborHead(headBuffer, c == '{' ? 5 : 4, items);
+		if (cbor.overflow || cbor.length + headBuffer.length > cbor.size) {
+			cbor.overflow = true;
+			return true;
+		}
+		memmove(cbor.data + start + headBuffer.length, cbor.data + start, cbor.length - start);
+		memcpy(cbor.data + start, head, headBuffer.length);
+		cbor.length += headBuffer.length;
+		return true;
+	}
+
+	// strings
+	if (c == '"') {
+		String text;
+		position++;
+		while (position < json.length() && json[position] != '"') {
+			c = json[position++];
+			if (c != '\\') {
+				text += c;
+				continue;
+			}
+			if (position >= json.length()) {
+				return false;
+			}
+			c = json[position++];
+			switch (c) {
+				case 'b':	text += '\b'; break;
+				case 'f':	text += '\f'; break;
+				case 'n':	text += '\n'; break;
+				case 'r':	text += '\r'; break;
+				case 't':	text += '\t'; break;
+				case 'u': {
+					if (position + 4 > json.length()) {
+						return false;
+					}
+					unsigned long code = strtoul(json.substring(position, position + 4).c_str(), NULL, 16);
+					position += 4;
+					if (code >= 0xd800 && code < 0xdc00 && json.startsWith("\\u", position)) {	// surrogate pair
+						unsigned long low = strtoul(json.substring(position + 2, position + 6).c_str(), NULL, 16);
+						code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+						position += 6;
+					}
+					if (code < 0x80) {
+						text += (char)code;
+					} else if (code < 0x800) {
+						text += (char)(0xc0 | (code >> 6));
+						text += (char)(0x80 | (code & 0x3f));
+					} else if (code < 0x10000) {
+						text += (char)(0xe0 | (code >> 12));
+						text += (char)(0x80 | ((code >> 6) & 0x3f));
+						text += (char)(0x80 | (code & 0x3f));
+					} else {
+						text += (char)(0xf0 | (code >> 18));
+						text += (char)(0x80 | ((code >> 12) & 0x3f));
+						text += (char)(0x80 | ((code >> 6) & 0x3f));
+						text += (char)(0x80 | (code & 0x3f));
+					}
+					break;
+				}
+				default:	text += c; break;
+			}
+		}
+		if (position++ >= json.length()) {
+			return false;
+		}
+		_cborHead(cbor, 3, text.length());
+		_cborBytes(cbor, (const uint8_t *)text.c_str(), text.length());
+		return true;
+	}
+
+	// literals
+	if (json.startsWith("true", position) || json.startsWith("false", position) || json.startsWith("null", position)) {
+		uint8_t value = c == 't' ? 0xf5 : (c == 'f' ? 0xf4 : 0xf6);
+		position += c == 'f' ? 5 : 4;
+		_cborBytes(cbor, &value, 1);
+		return true;
+	}
+
+	// numbers
+	const char 	*text = json.c_str() + position;
+	char 		*end;
+	size_t 		 numberLength = strspn(text, "+-0123456789.eE");
+	if (numberLength == 0) {
+		return false;
+	}
+	if (memchr(text, '.', numberLength) == NULL && memchr(text, 'e', numberLength) == NULL &&
+		memchr(text, 'E', numberLength) == NULL) {
+		long long value = strtoll(text, &end, 10);
+		if (value >= 0) {
+			_cborHead(cbor, 0, value);
+		} else {
+			_cborHead(cbor, 1, -1 - value);
+		}
+	} else {
+		double 		value = strtod(text, &end);
+		uint64_t 	bits;
+		uint8_t 	bytes[9] = { 0xfb };
+		memcpy(&bits, &value, sizeof(bits));
+		for (int i = 0; i < 8; i++) {
+			bytes[1 + i] = bits >> (8 * (7 - i));
+		}
+		_cborBytes(cbor, bytes, sizeof(bytes));
+	}
+	if (end != text + numberLength) {
+		return false;
+	}
+	position += numberLength;
+	return true;
+}
+
+
+// Write the initial byte and the argument of an item in the shortest form
+void MockCSE::_cborHead(CborBuffer &cbor, uint8_t major, uint64_t value) {
+	uint8_t bytes[9];
+	size_t 	length = 1;
+	if (value < 24) {
+		bytes[0] = (major << 5) | value;
+	} else {
+		int size = value <= 0xff ? 1 : (value <= 0xffff ? 2 : (value <= 0xffffffffULL ? 4 : 8));
+		bytes[0] = (major << 5) | (size == 1 ? 24 : (size == 2 ? 25 : (size == 4 ? 26 : 27)));
+		for (int i = size - 1; i >= 0; i--) {
+			bytes[length++] = value >> (8 * i);
+		}
+	}
+	_cborBytes(cbor, bytes, length);
+}
+
+
+void MockCSE::_cborBytes(CborBuffer &cbor, const uint8_t *data, size_t length) {
+	if (cbor.length + length > cbor.size) {
+		cbor.overflow = true;
+		return;
+	}
+	memcpy(cbor.data + cbor.length, data, length);
+	cbor.length += length;
+}
+
+
+//
+//	Helpers
+//
+
+// Return the value of a string attribute of a JSON resource, or the first
+// value of a list of strings. The value is not unescaped.
+String MockCSE::_attribute(String content, String name) {
+	int idx = content.indexOf("\"" + name + "\"");
+	if (idx < 0) {
+		return "";
+	}
+	idx = content.indexOf(':', idx + name.length() + 2);
+	while (idx > -1 && idx < (int)content.length() && content[idx] != '"') {
+		if (content[idx] != ':' && content[idx] != '[' && content[idx] != ' ') {
+			return "";		// not a string
+		}
+		idx++;
+	}
+	if (idx < 0 || idx >= (int)content.length()) {
+		return "";
+	}
+	int end = idx + 1;
+	while (end < (int)content.length() && content[end] != '"') {
+		end += content[end] == '\\' ? 2 : 1;
+	}
+	return content.substring(idx + 1, end);
+}
+
+
+String MockCSE::_typeName(int type) {
+	switch (type) {
+		case 2:		return "ae";
+		case 3:		return "cnt";
+		case 4:		return "cin";
+		case 23:	return "sub";
+		default:	return "res";
+	}
+}
+
+
+String MockCSE::_reasonPhrase(int returnCode) {
+	switch (returnCode) {
+		case 200:	return "OK";
+		case 201:	return "Created";
+		case 400:	return "Bad Request";
+		case 403:	return "Forbidden";
+		case 404:	return "Not Found";
+		case 405:	return "Method Not Allowed";
+		case 409:	return "Conflict";
+		case 413:	return "Payload Too Large";
+		case 429:	return "Too Many Requests";
+		case 500:	return "Internal Server Error";
+		case 503:	return "Service Unavailable";
+		default:	return "Error";
+	}
+}
@@ -0,0 +1,265 @@
+/*
+ *	OneM2MBenchmark.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	End-to-end benchmark of the OneM2M client against the mock CSE on a
+ *	Linux host. Uploads are measured with the synchronous API, with upload
+ *	queues and with the asynchronous API, each with JSON and with CBOR
+ *	serialization. For each mode it reports uploads per second, latency
+ *	percentiles, the connection statistics, the client's heap high-water
+ *	mark and its allocations by subsystem. Finally it measures the
+ *	notification round-trip time.
+ *
+ *	Usage: OneM2MBenchmark [uploads [notifications [mode]]]
+ */
+
+# define HEAP_ACCOUNTING
+
+# include "Arduino.h"
+# include "../HeapAccounting/HeapAccounting.ino"
+# include "../LinkedList/LinkedList.ino"
+# include "../RingBuffer/Ringbuffer.ino"
+# include "../EEPROMStore/EEPROMStore.ino"
+# include "../HttpServer/HttpServer.ino"
+# include "../oneM2M/oneM2M.ino"
+# include "MockCSE.ino"
+
+# define CSE_PORT			18080
+# define NOTIFICATION_PORT	18081
+# define UPLOAD_PATH		"/cse/benchmarkAE/uploads"
+
+// Upload modes
+enum UploadMethod {
+	SYNC,		// addContentInstance()
+	QUEUED,		// queueContentInstance() and flushUploadQueues()
+	ASYNC		// createResourceAsync() with ONEM2M_ASYNC_CONNECTIONS requests in flight
+};
+
+struct UploadMode {
+	const char 				*name;
+	UploadMethod 			 method;
+	OneM2M::Serialization 	 serialization;
+};
+
+static const UploadMode uploadModes[] = {
+	{ "sync",			SYNC,	OneM2M::JSON },
+	{ "sync-cbor",		SYNC,	OneM2M::CBOR },
+	{ "queued",			QUEUED,	OneM2M::JSON },
+	{ "queued-cbor",	QUEUED,	OneM2M::CBOR },
+	{ "async",			ASYNC,	OneM2M::JSON },
+	{ "async-cbor",		ASYNC,	OneM2M::CBOR },
+};
+
+static volatile unsigned long	notificationsReceived = 0;
+static unsigned long 			*asyncStarts = NULL;		// micros() when an asynchronous request was started, by handle
+static unsigned long 			*asyncLatencies = NULL;
+static long 					 asyncFirstHandle = 0;
+static int 						 asyncCompleted = 0;
+static int 						 asyncFailures = 0;
+
+
+void notificationCallback(const OneM2M::ResourceFields &) {
+	notificationsReceived++;
+}
+
+
+void uploadCallback(long handle, int statusCode, String) {
+	if (statusCode != 201) {
+		asyncFailures++;
+	}
+	asyncLatencies[asyncCompleted++] = micros() - asyncStarts[handle - asyncFirstHandle];
+}
+
+
+static int compareLatencies(const void *a, const void *b) {
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+// Sort latencies in microseconds and print their percentiles in milliseconds
+static void printLatencies(const char *name, unsigned long *latencies, int count) {
+	if (count == 0) {
+		printf("%-28s n/a\n", name);
+		return;
+	}
+	qsort(latencies, count, sizeof(unsigned long), compareLatencies);
+	printf("%-28s p50 %.3f ms  p90 %.3f ms  p99 %.3f ms  max %.3f ms\n", name,
+		   latencies[count * 50 / 100] / 1000.0, latencies[count * 90 / 100] / 1000.0,
+		   latencies[count * 99 / 100] / 1000.0, latencies[count - 1] / 1000.0);
+}
+
+
+static String uploadValue(int i) {
+	return String(20.0 + (i % 100) / 10.0);
+}
+
+
+// Upload *uploads* ContentInstances with a mode and print the results. The
+// latency of queued uploads is the time of a flush that uploaded contents.
+// This function returns the number of failed uploads.
+static int benchmarkUploads(OneM2M &cse, const UploadMode &mode, int uploads, unsigned long *latencies) {
+	OneM2M::ConnectionStatistics 	connections = cse.connectionStatistics();
+	OneM2M::UploadStatistics 		queued = cse.uploadStatistics();
+	int 							failures = 0;
+	int 							measured = 0;
+
+	cse.setSerialization(mode.serialization);
+	if (mode.method == QUEUED) {
+		cse.addUploadQueue(UPLOAD_PATH, 2 * ONEM2M_PIPELINE_DEPTH, ONEM2M_PIPELINE_DEPTH, 0);
+	}
+	size_t 			heapBase = hostHeapUsed();
+	unsigned long 	allocationsBase = hostHeapAllocations();
+	hostHeapResetPeak();
+	HeapAccounting::reset();
+	unsigned long start = micros();
+
+	switch (mode.method) {
+		case SYNC:
+			for (int i = 0; i < uploads; i++) {
+				unsigned long t = micros();
+				if (cse.addContentInstance(UPLOAD_PATH, uploadValue(i)).length() == 0) {
+					failures++;
+				}
+				latencies[measured++] = micros() - t;
+			}
+			break;
+
+		case QUEUED:
+			for (int i = 0; i < uploads; i++) {
+				cse.queueContentInstance(UPLOAD_PATH, uploadValue(i));
+				unsigned long t = micros();
+				if (cse.flushUploadQueues(i == uploads - 1) > 0) {
+					latencies[measured++] = micros() - t;
+				}
+			}
+			failures = uploads - (cse.uploadStatistics().uploaded - queued.uploaded);
+			break;
+
+		case ASYNC: {
+			int started = 0;
+			asyncCompleted = 0;
+			asyncFailures = 0;
+			asyncLatencies = latencies;
+			while (asyncCompleted < uploads) {
+				while (started < uploads && cse.pendingRequests() < ONEM2M_ASYNC_CONNECTIONS) {
+					unsigned long t = micros();
+					long handle = cse.createResourceAsync(UPLOAD_PATH, OneM2M::ResourceType::CONTENTINSTANCE,
+														  "{\"m2m:cin\":{\"cnf\":\"text/plain:0\",\"con\":\"" + uploadValue(started) + "\"}}",
+														  uploadCallback);
+					if (started == 0) {
+						asyncFirstHandle = handle;
+					}
+					asyncStarts[handle - asyncFirstHandle] = t;
+					started++;
+				}
+				cse.poll();
+				yield();
+			}
+			failures = asyncFailures;
+			measured = asyncCompleted;
+			break;
+		}
+	}
+
+	unsigned long duration = micros() - start;
+	size_t heapPeak = hostHeapPeak() - heapBase;
+	unsigned long allocations = hostHeapAllocations() - allocationsBase;
+	String heapReport = HeapAccounting::report();
+	if (mode.method == QUEUED) {
+		cse.removeUploadQueue(UPLOAD_PATH);
+	}
+
+	// check the last upload with a retrieval in the mode's serialization
+	OneM2M::Content latest = cse.getLatestContentInstance(UPLOAD_PATH);
+	if ( ! latest.state || String(latest.content) != uploadValue(uploads - 1)) {
+		fprintf(stderr, "%s: the latest ContentInstance is not the last upload\n", mode.name);
+		failures++;
+	}
+	const OneM2M::ConnectionStatistics &c = cse.connectionStatistics();
+
+	printf("\n%s\n", mode.name);
+	printf("uploads                      %d (%d failed)\n", uploads, failures);
+	printf("uploads/sec                  %.1f\n", uploads * 1000000.0 / duration);
+	printLatencies(mode.method == QUEUED ? "flush latency" : "upload latency", latencies, measured);
+	printf("connections                  %lu requests, %lu connects, %lu reuses\n",
+		   c.requests - connections.requests, c.connects - connections.connects, c.reuses - connections.reuses);
+	printf("heap high-water mark         %lu bytes above %lu bytes\n", (unsigned long)heapPeak, (unsigned long)heapBase);
+	printf("allocations per upload       %.1f\n", (double)allocations / uploads);
+	printf("heap by subsystem\n%s", heapReport.c_str());
+	return failures;
+}
+
+
+int main(int argc, char **argv) {
+	int 		uploads = argc > 1 ? atoi(argv[1]) : 1000;
+	int 		notifications = argc > 2 ? atoi(argv[2]) : 200;
+	const char 	*modeName = argc > 3 ? argv[3] : NULL;
+	if (uploads <= 0 || notifications < 0) {
+		fprintf(stderr, "usage: %s [uploads [notifications [mode]]]\n", argv[0]);
+		return 1;
+	}
+	unsigned long *latencies = new unsigned long[uploads > notifications ? uploads : notifications];
+	asyncStarts = new unsigned long[uploads];
+
+	MockCSE 	mockCSE(CSE_PORT);
+	OneM2M 		cse("127.0.0.1", CSE_PORT, "/", "CBenchmark");
+	OneM2M::setupNotifications("127.0.0.1", NOTIFICATION_PORT, "/notify");
+
+	if (cse.getAE("/cse/benchmarkAE", "benchmark").length() == 0 ||
+		cse.getContainer(UPLOAD_PATH).length() == 0 ||
+		cse.getContainer("/cse/benchmarkAE/notifications").length() == 0) {
+		fprintf(stderr, "cannot create resources on the mock CSE\n");
+		return 1;
+	}
+	String subscription = cse.getSubscription("/cse/benchmarkAE/notifications/benchmarkSub");
+	OneM2M::addNotificationFieldsCallback(OneM2M::getResourceIdentifier(subscription), notificationCallback);
+
+	// uploads
+	int failures = 0;
+	int modes = 0;
+	for (size_t i = 0; i < sizeof(uploadModes) / sizeof(uploadModes[0]); i++) {
+		if (modeName == NULL || strcmp(modeName, uploadModes[i].name) == 0) {
+			failures += benchmarkUploads(cse, uploadModes[i], uploads, latencies);
+			modes++;
+		}
+	}
+	if (modes == 0) {
+		fprintf(stderr, "unknown mode %s\n", modeName);
+		return 1;
+	}
+	cse.setSerialization(OneM2M::JSON);
+
+	// notification round trips: from the upload until the callback was called
+	int received = 0;
+	for (int i = 0; i < notifications; i++) {
+		unsigned long 	expected = notificationsReceived + 1;
+		unsigned long 	t = micros();
+		cse.addContentInstance("/cse/benchmarkAE/notifications", String(i));
+		while (notificationsReceived < expected && micros() - t < MOCKCSE_NOTIFICATION_TIMEOUT * 1000UL) {
+			OneM2M::checkNotifications();
+			yield();
+		}
+		if (notificationsReceived >= expected) {
+			latencies[received++] = micros() - t;
+		}
+	}
+	printf("\nnotifications                %d (%d lost)\n", notifications, notifications - received);
+	printLatencies("notification round trip", latencies, received);
+
+	const OneM2M::ConnectionStatistics 	&connections = cse.connectionStatistics();
+	const MockCSE::Statistics 			&statistics = mockCSE.statistics();
+	printf("connections                  %lu requests, %lu connects, %lu reuses, %lu reconnects\n",
+		   connections.requests, connections.connects, connections.reuses, connections.reconnects);
+	printf("mock CSE                     %lu requests, %lu connections, %lu CBOR, %lu errors, %lu notifications, %lu failed\n",
+		   statistics.requests, statistics.connections, statistics.cborRequests, statistics.errors,
+		   statistics.notifications, statistics.notificationFailures);
+
+	OneM2M::shutdownNotifications();
+	delete[] asyncStarts;
+	delete[] latencies;
+	return failures > 0 || received < notifications ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+/*
+ *	SerializationBenchmark.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Runs the SerializationBenchmark sketch of the oneM2M library on a Linux
+ *	host. The sketch's setup() runs the benchmark once and writes the CSV
+ *	results to the serial port, which is stderr on the host.
+ */
+
+# include "Arduino.h"
+# include "../LinkedList/LinkedList.ino"
+# include "../RingBuffer/Ringbuffer.ino"
+# include "../EEPROMStore/EEPROMStore.ino"
+# include "../HttpServer/HttpServer.ino"
+# include "../oneM2M/oneM2M.ino"
+# include "../oneM2M/examples/SerializationBenchmark/SerializationBenchmark.ino"
+
+
+int main() {
+	setup();
+	return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ *	Arduino.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Minimal Arduino core shim for building the libraries on a Linux host.
+ */
+
+# include <time.h>
+# include <sched.h>
+# include <errno.h>
+# include <unistd.h>
+# include "Arduino.h"
+
+
+HardwareSerial	Serial;
+EspClass		ESP;
+
+static void 			(*_backgroundTask)(void) = NULL;
+static bool 			 _backgroundRunning = false;
+static size_t 			 _heapUsed = 0;
+static size_t 			 _heapPeak = 0;
+static unsigned long 	 _heapAllocations = 0;
+static int 				 _heapSuspended = 0;
+static uint8_t 			(*_heapAllocatedHook)(size_t size) = NULL;
+static void 			(*_heapFreedHook)(uint8_t tag, size_t size) = NULL;
+static size_t 			 _heapBase = _heapUsed;		// allocated before the program started
+
+
+static uint64_t _monotonicMicros(void) {
+	static uint64_t start = 0;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t now = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	if (start == 0) {
+		start = now;
+	}
+	return now - start;
+}
+
+
+unsigned long millis(void) {
+	return (unsigned long)(_monotonicMicros() / 1000);
+}
+
+
+unsigned long micros(void) {
+	return (unsigned long)_monotonicMicros();
+}
+
+
+// Run the background task, but not recursively
+static void _runBackgroundTask(void) {
+	if (_backgroundTask != NULL && ! _backgroundRunning) {
+		_backgroundRunning = true;
+		(*_backgroundTask)();
+		_backgroundRunning = false;
+	}
+}
+
+
+void delay(unsigned long ms) {
+	unsigned long start = millis();
+	do {
+		_runBackgroundTask();
+		struct timespec ts = { 0, 100000L };	// 0.1 ms
+		nanosleep(&ts, NULL);
+	} while (millis() - start < ms);
+}
+
+
+void yield(void) {
+	_runBackgroundTask();
+	sched_yield();
+}
+
+
+void hostSetBackgroundTask(void (*task)(void)) {
+	_backgroundTask = task;
+}
+
+
+size_t HardwareSerial::printf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int n = vfprintf(stderr, format, args);
+	va_end(args);
+	return n > 0 ? n : 0;
+}
+
+
+// The host has no meaningful heap limits. A heap of HOST_HEAP_SIZE bytes is
+// simulated, which isn't fragmented, so the largest free block is the free
+// heap.
+uint32_t EspClass::getFreeHeap(void) {
+	size_t used = _heapUsed > _heapBase ? _heapUsed - _heapBase : 0;
+	return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+
+uint32_t EspClass::getMaxFreeBlockSize(void) {
+	return getFreeHeap();
+}
+
+
+//
+//	Heap accounting. The allocation functions of the C library are 
+//	replaced by functions that put a header in front of each block, which
+//	holds the block's size and the tag of the heap hook.
+//
+
+extern "C" {
+	void 	*__libc_malloc(size_t size);
+	void 	*__libc_memalign(size_t alignment, size_t size);
+	void 	 __libc_free(void *ptr);
+}
+
+struct HostBlock {
+	void 		*base;			// start of the underlying allocation
+	uint32_t 	 size;			// requested size
+	uint8_t 	 counted;
+	uint8_t 	 tag;			// tag of the heap hook, or HOST_NO_TAG
+} __attribute__((aligned(16)));
+
+# define HOST_NO_TAG	0xff
+
+
+static void *_allocate(size_t alignment, size_t size) {
+	if (alignment < sizeof(HostBlock)) {
+		alignment = sizeof(HostBlock);
+	}
+	if (size > 0xffffffffUL - alignment) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	uint8_t *base = (uint8_t *)(alignment == sizeof(HostBlock) ? __libc_malloc(size + alignment) 
+															   : __libc_memalign(alignment, size + alignment));
+	if (base == NULL) {
+		return NULL;
+	}
+	HostBlock *block = (HostBlock *)(base + alignment) - 1;
+	block->base = base;
+	block->size = size;
+	block->counted = _heapSuspended == 0;
+	block->tag = HOST_NO_TAG;
+	if (block->counted) {
+		_heapUsed += size;
+		_heapAllocations++;
+		if (_heapUsed > _heapPeak) {
+			_heapPeak = _heapUsed;
+		}
+		if (_heapAllocatedHook != NULL) {
+			block->tag = (*_heapAllocatedHook)(size);
+		}
+	}
+	return block + 1;
+}
+
+
+static HostBlock *_block(void *ptr) {
+	return (HostBlock *)ptr - 1;
+}
+
+
+extern "C" void free(void *ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	HostBlock *block = _block(ptr);
+	if (block->counted) {
+		_heapUsed = block->size < _heapUsed ? _heapUsed - block->size : 0;
+		if (block->tag != HOST_NO_TAG && _heapFreedHook != NULL) {
+			(*_heapFreedHook)(block->tag, block->size);
+		}
+	}
+	__libc_free(block->base);
+}
+
+
+extern "C" void *malloc(size_t size) {
+	return _allocate(0, size);
+}
+
+
+extern "C" void *calloc(size_t count, size_t size) {
+	size_t total;
+	if (__builtin_mul_overflow(count, size, &total)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	void *ptr = _allocate(0, total);
+	if (ptr != NULL) {
+		memset(ptr, 0, total);
+	}
+	return ptr;
+}
+
+
+// A reallocation is counted as a new allocation and a free
+extern "C" void *realloc(void *ptr, size_t size) {
+	if (ptr == NULL) {
+		return malloc(size);
+	}
+	if (size == 0) {
+		free(ptr);
+		return NULL;
+	}
+	void *result = malloc(size);
+	if (result != NULL) {
+		size_t oldSize = _block(ptr)->size;
+		memcpy(result, ptr, oldSize < size ? oldSize : size);
+		free(ptr);
+	}
+	return result;
+}
+
+
+extern "C" void *memalign(size_t alignment, size_t size) {
+	return _allocate(alignment, size);
+}
+
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+	return _allocate(alignment, size);
+}
+
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	*ptr = _allocate(alignment, size);
+	return *ptr != NULL ? 0 : ENOMEM;
+}
+
+
+extern "C" void *valloc(size_t size) {
+	return _allocate(sysconf(_SC_PAGESIZE), size);
+}
+
+
+extern "C" void *pvalloc(size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	return _allocate(page, (size + page - 1) & ~(page - 1));
+}
+
+
+extern "C" size_t malloc_usable_size(void *ptr) {
+	return ptr != NULL ? _block(ptr)->size : 0;
+}
+
+
+void hostSetHeapHook(uint8_t (*allocated)(size_t size), void (*freed)(uint8_t tag, size_t size)) {
+	_heapAllocatedHook = allocated;
+	_heapFreedHook = freed;
+}
+
+
+size_t hostHeapUsed(void) {
+	return _heapUsed;
+}
+
+
+size_t hostHeapPeak(void) {
+	return _heapPeak;
+}
+
+
+unsigned long hostHeapAllocations(void) {
+	return _heapAllocations;
+}
+
+
+void hostHeapResetPeak(void) {
+	_heapPeak = _heapUsed;
+}
+
+
+void hostHeapSuspend(void) {
+	_heapSuspended++;
+}
+
+
+void hostHeapResume(void) {
+	if (_heapSuspended > 0) {
+		_heapSuspended--;
+	}
+}
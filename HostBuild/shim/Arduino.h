@@ -0,0 +1,127 @@
+/*
+ *	Arduino.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Minimal Arduino core shim for building the libraries on a Linux host.
+ */
+
+# ifndef __HOST_ARDUINO_H__
+# define __HOST_ARDUINO_H__
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <stdint.h>
+# include <stddef.h>
+# include <stdarg.h>
+# include <string.h>
+# include <ctype.h>
+# include <math.h>
+
+# include "WString.h"
+
+// Identifies the host build, like ARDUINO_ARCH_ESP8266 on an ESP8266
+# define ARDUINO_ARCH_HOST
+
+// Size of the simulated heap in bytes. ESP.getFreeHeap() reports this size
+// minus the bytes that were allocated since the program started.
+# ifndef HOST_HEAP_SIZE
+# define HOST_HEAP_SIZE			81920
+# endif
+
+typedef uint8_t		byte;
+typedef bool		boolean;
+
+//
+//	Time
+//
+
+unsigned long	millis(void);
+unsigned long	micros(void);
+void 			delay(unsigned long ms);
+void 			yield(void);
+
+
+//
+//	Flash memory. On the host everything lives in RAM.
+//
+
+# define PROGMEM
+# define PGM_P						const char *
+# define PSTR(s)					(s)
+# define F(s)						(reinterpret_cast<const __FlashStringHelper *>(s))
+# define FPSTR(p)					(reinterpret_cast<const __FlashStringHelper *>(p))
+# define pgm_read_byte(addr)		(*(const uint8_t *)(addr))
+# define memcpy_P					memcpy
+# define strlen_P					strlen
+
+
+//
+//	Serial
+//
+
+class HardwareSerial {
+public:
+	void	begin(unsigned long) {}
+	size_t	print(const String &s)			{ return fwrite(s.c_str(), 1, s.length(), stderr); }
+	size_t	print(const char *s)			{ return fputs(s, stderr) >= 0 ? strlen(s) : 0; }
+	size_t	print(char c)					{ return fputc(c, stderr) != EOF; }
+	size_t	print(long v)					{ return fprintf(stderr, "%ld", v); }
+	size_t	print(unsigned long v)			{ return fprintf(stderr, "%lu", v); }
+	size_t	print(int v)					{ return print((long)v); }
+	size_t	print(unsigned int v)			{ return print((unsigned long)v); }
+	size_t	print(double v)					{ return fprintf(stderr, "%.2f", v); }
+	size_t	print(float v)					{ return print((double)v); }
+	template<typename T>
+	size_t	print(const T &printable)		{ return print(printable.toString()); }
+	template<typename T>
+	size_t	println(const T &v)				{ size_t n = print(v); return n + print("\r\n"); }
+	size_t	println(void)					{ return print("\r\n"); }
+	size_t	printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+
+//
+//	ESP specific functions
+//
+
+class EspClass {
+public:
+	uint32_t	getFreeHeap(void);
+	uint32_t	getMaxFreeBlockSize(void);
+	void		restart(void)				{ exit(0); }
+};
+
+extern EspClass ESP;
+
+
+//
+//	Host specific functions
+//
+
+//	Set a function that is called by yield() and delay(), similar to the
+//	system tasks of the ESP8266 core. This is used to serve the mock CSE in
+//	the same process. *task* may be NULL.
+void 			hostSetBackgroundTask(void (*task)(void));
+
+//	Heap accounting of the host. All blocks allocated by malloc() and new
+//	are counted with their requested size. Blocks that are allocated while
+//	the accounting is suspended are not counted.
+size_t 			hostHeapUsed(void);
+size_t 			hostHeapPeak(void);
+unsigned long 	hostHeapAllocations(void);
+void 			hostHeapResetPeak(void);
+void 			hostHeapSuspend(void);
+void 			hostHeapResume(void);
+
+//	Set functions that are called for each counted block. *allocated* is
+//	called with the size of a new block and returns a tag that is stored
+//	with the block. *freed* is called with this tag and the size when the
+//	block is freed. Blocks that were allocated before the hook was set are
+//	not passed to *freed*. This is used by the HeapAccounting sub-project.
+void 			hostSetHeapHook(uint8_t (*allocated)(size_t size), void (*freed)(uint8_t tag, size_t size));
+
+# endif
@@ -0,0 +1,81 @@
+/*
+ *	EEPROM.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Shim of the ESP8266 EEPROM class for building the libraries on a Linux
+ *	host.
+ */
+
+# include "EEPROM.h"
+
+
+EEPROMClass EEPROM;
+
+
+EEPROMClass::EEPROMClass() : _data(NULL), _size(0), _dirty(false), commits(0), sectorErases(0), bytesWritten(0) {
+	memset(_flash, 0xff, sizeof(_flash));
+}
+
+
+void EEPROMClass::begin(size_t size) {
+	if (size == 0 || size > HOST_FLASH_SECTOR_SIZE) {
+		return;
+	}
+	size = (size + 3) & ~3;
+	delete[] _data;
+	_data = new uint8_t[size];
+	_size = size;
+	memcpy(_data, _flash, _size);
+	_dirty = false;
+}
+
+
+uint8_t EEPROMClass::read(int address) {
+	if (address < 0 || (size_t)address >= _size) {
+		return 0;
+	}
+	return _data[address];
+}
+
+
+void EEPROMClass::write(int address, uint8_t value) {
+	if (address < 0 || (size_t)address >= _size) {
+		return;
+	}
+	if (_data[address] != value) {
+		_data[address] = value;
+		_dirty = true;
+	}
+}
+
+
+// Like the ESP8266 core, a commit erases the whole sector and writes the
+// complete cache back, but only when the cache was changed.
+bool EEPROMClass::commit(void) {
+	if ( ! _size) {
+		return false;
+	}
+	if ( ! _dirty) {
+		return true;
+	}
+	memset(_flash, 0xff, sizeof(_flash));
+	sectorErases++;
+	memcpy(_flash, _data, _size);
+	bytesWritten += _size;
+	commits++;
+	_dirty = false;
+	return true;
+}
+
+
+void EEPROMClass::end(void) {
+	if ( ! _size) {
+		return;
+	}
+	commit();
+	delete[] _data;
+	_data = NULL;
+	_size = 0;
+}
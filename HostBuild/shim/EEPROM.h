@@ -0,0 +1,64 @@
+/*
+ *	EEPROM.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Shim of the ESP8266 EEPROM class for building the libraries on a Linux
+ *	host. Like on the device, the EEPROM is emulated by a RAM cache that is
+ *	written to a simulated flash sector on commit().
+ */
+
+# ifndef __HOST_EEPROM_H__
+# define __HOST_EEPROM_H__
+
+# include "Arduino.h"
+
+# define HOST_FLASH_SECTOR_SIZE		4096
+
+
+class EEPROMClass {
+private:
+	uint8_t			 _flash[HOST_FLASH_SECTOR_SIZE];	// simulated flash sector
+	uint8_t			*_data;								// RAM cache
+	size_t			 _size;
+	bool			 _dirty;
+
+public:
+	// Statistics of the simulated flash
+	unsigned long	 commits;			// number of commit() calls that wrote the flash
+	unsigned long	 sectorErases;		// number of sector erases
+	unsigned long	 bytesWritten;		// number of bytes written to the flash
+
+	EEPROMClass();
+
+	void			 begin(size_t size);
+	uint8_t			 read(int address);
+	void			 write(int address, uint8_t value);
+	bool			 commit(void);
+	void			 end(void);
+	size_t			 length(void)	{ return _size; }
+
+	template<typename T>
+	T &get(int address, T &t) {
+		if (address >= 0 && address + sizeof(T) <= _size) {
+			memcpy((uint8_t *)&t, _data + address, sizeof(T));
+		}
+		return t;
+	}
+
+	template<typename T>
+	const T &put(int address, const T &t) {
+		if (address >= 0 && address + sizeof(T) <= _size) {
+			if (memcmp(_data + address, (const uint8_t *)&t, sizeof(T)) != 0) {
+				_dirty = true;
+				memcpy(_data + address, (const uint8_t *)&t, sizeof(T));
+			}
+		}
+		return t;
+	}
+};
+
+extern EEPROMClass EEPROM;
+
+# endif
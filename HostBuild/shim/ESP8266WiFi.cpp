@@ -0,0 +1,349 @@
+/*
+ *	ESP8266WiFi.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Socket-backed shim of the ESP8266 WiFi classes for building the
+ *	libraries on a Linux host.
+ */
+
+# include <errno.h>
+# include <fcntl.h>
+# include <netdb.h>
+# include <poll.h>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <linux/sockios.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include "ESP8266WiFi.h"
+
+
+ESP8266WiFiClass WiFi;
+
+static size_t _writeLimit = 0;
+
+
+void hostLimitWrites(size_t size) {
+	_writeLimit = size;
+}
+
+
+String IPAddress::toString(void) const {
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _address[0], _address[1], _address[2], _address[3]);
+	return String(buf);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//	WiFiClient
+//
+
+WiFiClient::WiFiClient() : _connection(NULL), _timeout(1000) {
+}
+
+
+WiFiClient::WiFiClient(int fd) : _connection(NULL), _timeout(1000) {
+	if (fd < 0) {
+		return;
+	}
+	_connection = new Connection();
+	_connection->fd = fd;
+	_connection->references = 1;
+	_connection->rxStart = _connection->rxEnd = 0;
+	setNoDelay(true);
+}
+
+
+WiFiClient::WiFiClient(const WiFiClient &other) : _connection(other._connection), _timeout(other._timeout) {
+	if (_connection) {
+		_connection->references++;
+	}
+}
+
+
+WiFiClient::~WiFiClient() {
+	_release();
+}
+
+
+WiFiClient &WiFiClient::operator=(const WiFiClient &other) {
+	if (this != &other) {
+		if (other._connection) {
+			other._connection->references++;
+		}
+		_release();
+		_connection = other._connection;
+		_timeout = other._timeout;
+	}
+	return *this;
+}
+
+
+// Drop this client's reference. The socket is closed with the last reference.
+void WiFiClient::_release(void) {
+	if (_connection == NULL) {
+		return;
+	}
+	if (--_connection->references == 0) {
+		if (_connection->fd >= 0) {
+			close(_connection->fd);
+		}
+		delete _connection;
+	}
+	_connection = NULL;
+}
+
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+	_release();
+
+	struct addrinfo hints, *res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+	if (getaddrinfo(host, service, &hints, &res) != 0) {
+		return 0;
+	}
+	int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd < 0 || ::connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		freeaddrinfo(res);
+		return 0;
+	}
+	freeaddrinfo(res);
+	*this = WiFiClient(fd);
+	return 1;
+}
+
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+	return connect(ip.toString().c_str(), port);
+}
+
+
+void WiFiClient::setNoDelay(bool nodelay) {
+	if (*this) {
+		int flag = nodelay ? 1 : 0;
+		setsockopt(_connection->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	}
+}
+
+
+// Read pending data from the socket into the receive buffer. When *wait*
+// is true then block up to the timeout for data to arrive. A closed
+// connection is marked by an fd of -1.
+size_t WiFiClient::_fill(bool wait) {
+	if ( ! *this) {
+		return 0;
+	}
+	Connection *c = _connection;
+	if (c->rxStart < c->rxEnd) {
+		return c->rxEnd - c->rxStart;
+	}
+	c->rxStart = c->rxEnd = 0;
+	if (wait) {
+		struct pollfd pfd = { c->fd, POLLIN, 0 };
+		if (poll(&pfd, 1, _timeout) <= 0) {
+			return 0;
+		}
+	}
+	ssize_t n = recv(c->fd, c->rx, sizeof(c->rx), MSG_DONTWAIT);
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		close(c->fd);
+		c->fd = -1;
+		return 0;
+	}
+	if (n > 0) {
+		c->rxEnd = n;
+	}
+	return c->rxEnd;
+}
+
+
+uint8_t WiFiClient::connected(void) {
+	if (_connection == NULL) {
+		return 0;
+	}
+	_fill(false);
+	return _connection->fd >= 0 || _connection->rxStart < _connection->rxEnd;
+}
+
+
+void WiFiClient::stop(void) {
+	if (_connection && _connection->fd >= 0) {
+		close(_connection->fd);
+		_connection->fd = -1;
+		_connection->rxStart = _connection->rxEnd = 0;
+	}
+	_release();
+}
+
+
+int WiFiClient::available(void) {
+	if (_connection == NULL) {
+		return 0;
+	}
+	int pending = 0;
+	if (_connection->fd >= 0) {
+		ioctl(_connection->fd, FIONREAD, &pending);
+	}
+	if (_connection->rxStart == _connection->rxEnd && pending == 0) {
+		_fill(false);	// detect a closed connection
+	}
+	return (int)(_connection->rxEnd - _connection->rxStart) + pending;
+}
+
+
+int WiFiClient::read(void) {
+	if (_connection == NULL || _fill(false) == 0) {
+		return -1;
+	}
+	return _connection->rx[_connection->rxStart++];
+}
+
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (n < size && _connection != NULL) {
+		size_t a = _fill(false);
+		if (a == 0) {
+			break;
+		}
+		if (a > size - n) {
+			a = size - n;
+		}
+		memcpy(buffer + n, _connection->rx + _connection->rxStart, a);
+		_connection->rxStart += a;
+		n += a;
+	}
+	return (int)n;
+}
+
+
+int WiFiClient::peek(void) {
+	if (_connection == NULL || _fill(false) == 0) {
+		return -1;
+	}
+	return _connection->rx[_connection->rxStart];
+}
+
+
+size_t WiFiClient::readBytes(char *buffer, size_t length) {
+	size_t n = 0;
+	while (n < length && _connection != NULL) {
+		if (_fill(true) == 0) {
+			break;
+		}
+		buffer[n++] = _connection->rx[_connection->rxStart++];
+	}
+	return n;
+}
+
+
+String WiFiClient::readStringUntil(char terminator) {
+	String result;
+	while (_connection != NULL && _fill(true) > 0) {
+		char c = _connection->rx[_connection->rxStart++];
+		if (c == terminator) {
+			break;
+		}
+		result += c;
+	}
+	return result;
+}
+
+
+// Return the free space in the socket's send buffer, which can be written
+// without blocking.
+int WiFiClient::availableForWrite(void) {
+	if ( ! *this) {
+		return 0;
+	}
+	int 		size = 0;
+	int 		queued = 0;
+	socklen_t 	length = sizeof(size);
+	if (getsockopt(_connection->fd, SOL_SOCKET, SO_SNDBUF, &size, &length) < 0 ||
+		ioctl(_connection->fd, SIOCOUTQ, &queued) < 0) {
+		return 0;
+	}
+	return size > queued ? size - queued : 0;
+}
+
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+	if ( ! *this) {
+		return 0;
+	}
+	if (_writeLimit > 0 && size > _writeLimit) {
+		size = _writeLimit;
+	}
+	size_t n = 0;
+	while (n < size) {
+		ssize_t w = send(_connection->fd, buffer + n, size - n, MSG_NOSIGNAL);
+		if (w <= 0) {
+			break;
+		}
+		n += w;
+	}
+	return n;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//	WiFiServer
+//
+
+WiFiServer::WiFiServer(uint16_t port) : _fd(-1), _port(port) {
+}
+
+
+WiFiServer::~WiFiServer() {
+	stop();
+}
+
+
+void WiFiServer::begin(void) {
+	_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (_fd < 0) {
+		return;
+	}
+	int flag = 1;
+	setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(_port);
+	if (bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(_fd, 16) != 0) {
+		close(_fd);
+		_fd = -1;
+		return;
+	}
+	fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+}
+
+
+void WiFiServer::stop(void) {
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+}
+
+
+WiFiClient WiFiServer::available(void) {
+	if (_fd < 0) {
+		return WiFiClient();
+	}
+	return WiFiClient(accept(_fd, NULL, NULL));
+}
@@ -0,0 +1,125 @@
+/*
+ *	ESP8266WiFi.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Socket-backed shim of the ESP8266 WiFi classes for building the
+ *	libraries on a Linux host. Like on the device, copies of a WiFiClient
+ *	share the same underlying connection.
+ */
+
+# ifndef __HOST_ESP8266WIFI_H__
+# define __HOST_ESP8266WIFI_H__
+
+# include "Arduino.h"
+
+
+enum WiFiMode {
+	WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3
+};
+
+
+class IPAddress {
+private:
+	uint8_t		_address[4];
+
+public:
+	IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) {
+		_address[0] = a; _address[1] = b; _address[2] = c; _address[3] = d;
+	}
+	uint8_t		operator[](int index) const	{ return _address[index]; }
+	String		toString(void) const;
+};
+
+
+class WiFiClient {
+private:
+	struct Connection {
+		int				fd;
+		int				references;
+		uint8_t			rx[1460];
+		size_t			rxStart;
+		size_t			rxEnd;
+	};
+
+	Connection			*_connection;
+	unsigned long		 _timeout;
+
+	void				 _release(void);
+	size_t				 _fill(bool wait);
+
+public:
+	WiFiClient();
+	explicit WiFiClient(int fd);
+	WiFiClient(const WiFiClient &other);
+	~WiFiClient();
+	WiFiClient 			&operator=(const WiFiClient &other);
+
+	int					 connect(const char *host, uint16_t port);
+	int					 connect(IPAddress ip, uint16_t port);
+	uint8_t				 connected(void);
+	void				 stop(void);
+	operator 			 bool(void) const	{ return _connection != NULL && _connection->fd >= 0; }
+
+	int					 available(void);
+	int					 read(void);
+	int					 read(uint8_t *buffer, size_t size);
+	int					 peek(void);
+	size_t				 readBytes(char *buffer, size_t length);
+	String				 readStringUntil(char terminator);
+	void				 setTimeout(unsigned long timeout)	{ _timeout = timeout; }
+	void				 setNoDelay(bool nodelay);
+	void				 flush(void) {}
+
+	int					 availableForWrite(void);
+	size_t				 write(uint8_t c)	{ return write(&c, 1); }
+	size_t				 write(const uint8_t *buffer, size_t size);
+	size_t				 write(const char *buffer, size_t size)	{ return write((const uint8_t *)buffer, size); }
+	size_t				 write_P(PGM_P buffer, size_t size)		{ return write((const uint8_t *)buffer, size); }
+	size_t				 print(const String &s)		{ return write(s.c_str(), s.length()); }
+	size_t				 print(const char *s)		{ return write(s, strlen(s)); }
+	size_t				 print(char c)				{ return write((uint8_t)c); }
+	size_t				 print(long v)				{ return print(String(v)); }
+	size_t				 print(unsigned long v)		{ return print(String(v)); }
+	size_t				 print(int v)				{ return print(String(v)); }
+	size_t				 print(unsigned int v)		{ return print(String(v)); }
+	size_t				 print(const __FlashStringHelper *s)	{ return print((const char *)s); }
+	template<typename T>
+	size_t				 println(const T &v)		{ size_t n = print(v); return n + print("\r\n"); }
+	size_t				 println(void)				{ return print("\r\n"); }
+};
+
+
+class WiFiServer {
+private:
+	int					 _fd;
+	uint16_t			 _port;
+
+public:
+	WiFiServer(uint16_t port);
+	~WiFiServer();
+
+	void				 begin(void);
+	void				 stop(void);
+	WiFiClient			 available(void);
+	uint16_t			 port(void) const	{ return _port; }
+};
+
+
+class ESP8266WiFiClass {
+public:
+	IPAddress			 localIP(void)		{ return IPAddress(127, 0, 0, 1); }
+	IPAddress			 softAPIP(void)		{ return IPAddress(127, 0, 0, 1); }
+	bool				 softAP(const char *, const char * = NULL)	{ return true; }
+	bool				 softAPdisconnect(bool = false)				{ return true; }
+	bool				 mode(WiFiMode)		{ return true; }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+//	Limit the number of bytes that a single WiFiClient::write() accepts, like
+//	a full send buffer on the device. 0 removes the limit.
+void 					hostLimitWrites(size_t size);
+
+# endif
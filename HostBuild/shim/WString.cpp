@@ -0,0 +1,333 @@
+/*
+ *	WString.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Minimal implementation of the Arduino String class for building the
+ *	libraries on a Linux host.
+ */
+
+# include "Arduino.h"
+
+
+String::String(const char *cstr) : _buffer(NULL), _capacity(0), _len(0) {
+	if (cstr) {
+		_copy(cstr, strlen(cstr));
+	}
+}
+
+String::String(const String &str) : _buffer(NULL), _capacity(0), _len(0) {
+	_copy(str.c_str(), str._len);
+}
+
+String::String(const __FlashStringHelper *str) : _buffer(NULL), _capacity(0), _len(0) {
+	if (str) {
+		_copy((const char *)str, strlen((const char *)str));
+	}
+}
+
+String::String(char c) : _buffer(NULL), _capacity(0), _len(0) {
+	_copy(&c, 1);
+}
+
+String::String(unsigned char value, unsigned char base) : String((unsigned long)value, base) {}
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) : _buffer(NULL), _capacity(0), _len(0) {
+	if (base == 10 || value >= 0) {
+		char buf[34];
+		if (base == 10) {
+			snprintf(buf, sizeof(buf), "%ld", value);
+			_copy(buf, strlen(buf));
+		} else {
+			*this = String((unsigned long)value, base);
+		}
+	} else {
+		*this = String((unsigned long)value, base);
+	}
+}
+
+String::String(unsigned long value, unsigned char base) : _buffer(NULL), _capacity(0), _len(0) {
+	char buf[66];
+	char *p = &buf[sizeof(buf) - 1];
+	*p = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		unsigned long d = value % base;
+		*--p = d < 10 ? '0' + d : 'A' + d - 10;
+		value /= base;
+	} while (value > 0);
+	_copy(p, strlen(p));
+}
+
+String::String(double value, unsigned char decimalPlaces) : _buffer(NULL), _capacity(0), _len(0) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+	_copy(buf, strlen(buf));
+}
+
+String::~String() {
+	delete[] _buffer;
+}
+
+
+bool String::_grow(unsigned int size) {
+	if (_buffer && _capacity >= size) {
+		return true;
+	}
+	char *nb = new char[size + 1];
+	if (_buffer) {
+		memcpy(nb, _buffer, _len + 1);
+		delete[] _buffer;
+	} else {
+		nb[0] = '\0';
+	}
+	_buffer = nb;
+	_capacity = size;
+	return true;
+}
+
+
+String &String::_copy(const char *cstr, unsigned int length) {
+	_grow(length);
+	memmove(_buffer, cstr, length);
+	_buffer[length] = '\0';
+	_len = length;
+	return *this;
+}
+
+
+String &String::operator=(const String &rhs) {
+	if (this != &rhs) {
+		_copy(rhs.c_str(), rhs._len);
+	}
+	return *this;
+}
+
+String &String::operator=(const char *cstr) {
+	return cstr ? _copy(cstr, strlen(cstr)) : _copy("", 0);
+}
+
+String &String::operator=(const __FlashStringHelper *str) {
+	return *this = (const char *)str;
+}
+
+
+bool String::reserve(unsigned int size) {
+	return _grow(size);
+}
+
+
+bool String::concat(const char *cstr, unsigned int length) {
+	if (cstr == NULL) {
+		return false;
+	}
+	if (length == 0) {
+		return true;
+	}
+	unsigned int newLen = _len + length;
+	if (newLen > _capacity) {
+		unsigned int cap = _capacity * 2;
+		_grow(cap > newLen ? cap : newLen);
+	}
+	memmove(_buffer + _len, cstr, length);
+	_len = newLen;
+	_buffer[_len] = '\0';
+	return true;
+}
+
+bool String::concat(const String &str)				{ return concat(str.c_str(), str._len); }
+bool String::concat(const char *cstr)				{ return cstr ? concat(cstr, strlen(cstr)) : false; }
+bool String::concat(const __FlashStringHelper *str)	{ return concat((const char *)str); }
+bool String::concat(char c)							{ return concat(&c, 1); }
+bool String::concat(int value)						{ return concat(String(value)); }
+bool String::concat(unsigned int value)				{ return concat(String(value)); }
+bool String::concat(long value)						{ return concat(String(value)); }
+bool String::concat(unsigned long value)			{ return concat(String(value)); }
+
+
+int String::compareTo(const String &s) const {
+	return strcmp(c_str(), s.c_str());
+}
+
+bool String::equals(const String &s) const {
+	return _len == s._len && compareTo(s) == 0;
+}
+
+bool String::equals(const char *cstr) const {
+	if (cstr == NULL) {
+		return _len == 0;
+	}
+	return strcmp(c_str(), cstr) == 0;
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+	if (offset + prefix._len > _len) {
+		return false;
+	}
+	return strncmp(c_str() + offset, prefix.c_str(), prefix._len) == 0;
+}
+
+bool String::startsWith(const String &prefix) const {
+	return startsWith(prefix, 0);
+}
+
+bool String::endsWith(const String &suffix) const {
+	if (suffix._len > _len) {
+		return false;
+	}
+	return strcmp(c_str() + _len - suffix._len, suffix.c_str()) == 0;
+}
+
+
+char String::charAt(unsigned int index) const {
+	return index < _len ? _buffer[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+	if (index < _len) {
+		_buffer[index] = c;
+	}
+}
+
+char &String::operator[](unsigned int index) {
+	static char dummy;
+	if (index >= _len) {
+		dummy = 0;
+		return dummy;
+	}
+	return _buffer[index];
+}
+
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+	if (fromIndex >= _len) {
+		return -1;
+	}
+	const char *p = strchr(c_str() + fromIndex, ch);
+	return p ? (int)(p - c_str()) : -1;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const {
+	if (fromIndex >= _len) {
+		return -1;
+	}
+	const char *p = strstr(c_str() + fromIndex, str.c_str());
+	return p ? (int)(p - c_str()) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+	const char *p = strrchr(c_str(), ch);
+	return p ? (int)(p - c_str()) : -1;
+}
+
+int String::lastIndexOf(const String &str) const {
+	if (str._len == 0 || str._len > _len) {
+		return -1;
+	}
+	for (int i = _len - str._len; i >= 0; i--) {
+		if (strncmp(c_str() + i, str.c_str(), str._len) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+	if (beginIndex > endIndex) {
+		unsigned int t = beginIndex;
+		beginIndex = endIndex;
+		endIndex = t;
+	}
+	String result;
+	if (beginIndex >= _len) {
+		return result;
+	}
+	if (endIndex > _len) {
+		endIndex = _len;
+	}
+	result._copy(c_str() + beginIndex, endIndex - beginIndex);
+	return result;
+}
+
+
+void String::replace(const String &find, const String &replace) {
+	if (_len == 0 || find._len == 0) {
+		return;
+	}
+	String result;
+	result.reserve(_len);
+	const char *p = c_str();
+	const char *hit;
+	while ((hit = strstr(p, find.c_str())) != NULL) {
+		result.concat(p, hit - p);
+		result.concat(replace);
+		p = hit + find._len;
+	}
+	result.concat(p);
+	*this = result;
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+	if (index >= _len) {
+		return;
+	}
+	if (count > _len - index) {
+		count = _len - index;
+	}
+	memmove(_buffer + index, _buffer + index + count, _len - index - count + 1);
+	_len -= count;
+}
+
+void String::toLowerCase(void) {
+	for (unsigned int i = 0; i < _len; i++) {
+		_buffer[i] = tolower(_buffer[i]);
+	}
+}
+
+void String::toUpperCase(void) {
+	for (unsigned int i = 0; i < _len; i++) {
+		_buffer[i] = toupper(_buffer[i]);
+	}
+}
+
+void String::trim(void) {
+	if (_len == 0) {
+		return;
+	}
+	unsigned int b = 0;
+	while (b < _len && isspace((unsigned char)_buffer[b])) {
+		b++;
+	}
+	unsigned int e = _len;
+	while (e > b && isspace((unsigned char)_buffer[e - 1])) {
+		e--;
+	}
+	_len = e - b;
+	memmove(_buffer, _buffer + b, _len);
+	_buffer[_len] = '\0';
+}
+
+
+long String::toInt(void) const {
+	return atol(c_str());
+}
+
+double String::toFloat(void) const {
+	return atof(c_str());
+}
+
+
+String operator+(const String &lhs, const String &rhs)	{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, const char *rhs)	{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const char *lhs, const String &rhs)	{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, char rhs)			{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, int rhs)			{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, unsigned int rhs)	{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, long rhs)			{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, unsigned long rhs)	{ String r(lhs); r.concat(rhs); return r; }
+String operator+(const String &lhs, const __FlashStringHelper *rhs)	{ String r(lhs); r.concat(rhs); return r; }
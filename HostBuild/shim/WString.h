@@ -0,0 +1,117 @@
+/*
+ *	WString.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Minimal implementation of the Arduino String class for building the
+ *	libraries on a Linux host. Only the methods used by the libraries are
+ *	provided. Like the original, the buffer lives on the heap.
+ */
+
+# ifndef __HOST_WSTRING_H__
+# define __HOST_WSTRING_H__
+
+# include <stddef.h>
+
+# define DEC	10
+# define HEX	16
+
+class __FlashStringHelper;
+
+class String {
+	// Safe bool idiom as in the Arduino core
+	typedef void (String::*StringIfHelperType)() const;
+	void StringIfHelper() const {}
+
+private:
+	char			*_buffer;
+	unsigned int	 _capacity;
+	unsigned int	 _len;
+
+	bool			 _grow(unsigned int size);
+	String 			&_copy(const char *cstr, unsigned int length);
+
+public:
+	String(const char *cstr = "");
+	String(const String &str);
+	String(const __FlashStringHelper *str);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+	~String();
+
+	String 			&operator=(const String &rhs);
+	String 			&operator=(const char *cstr);
+	String 			&operator=(const __FlashStringHelper *str);
+
+	bool			 reserve(unsigned int size);
+	unsigned int	 length(void) const	{ return _len; }
+	const char		*c_str(void) const	{ return _buffer ? _buffer : ""; }
+	operator 		 StringIfHelperType() const	{ return _buffer ? &String::StringIfHelper : 0; }
+
+	bool			 concat(const String &str);
+	bool			 concat(const char *cstr);
+	bool			 concat(const char *cstr, unsigned int length);
+	bool			 concat(const __FlashStringHelper *str);
+	bool			 concat(char c);
+	bool			 concat(int value);
+	bool			 concat(unsigned int value);
+	bool			 concat(long value);
+	bool			 concat(unsigned long value);
+
+	template<typename T>
+	String 			&operator+=(const T &rhs)	{ concat(rhs); return *this; }
+
+	int				 compareTo(const String &s) const;
+	bool			 equals(const String &s) const;
+	bool			 equals(const char *cstr) const;
+	bool			 operator==(const String &rhs) const	{ return equals(rhs); }
+	bool			 operator==(const char *cstr) const		{ return equals(cstr); }
+	bool			 operator!=(const String &rhs) const	{ return ! equals(rhs); }
+	bool			 operator!=(const char *cstr) const		{ return ! equals(cstr); }
+	bool			 operator<(const String &rhs) const		{ return compareTo(rhs) < 0; }
+	bool			 startsWith(const String &prefix) const;
+	bool			 startsWith(const String &prefix, unsigned int offset) const;
+	bool			 endsWith(const String &suffix) const;
+
+	char			 charAt(unsigned int index) const;
+	void			 setCharAt(unsigned int index, char c);
+	char			 operator[](unsigned int index) const	{ return charAt(index); }
+	char			&operator[](unsigned int index);
+
+	int				 indexOf(char ch, unsigned int fromIndex = 0) const;
+	int				 indexOf(const String &str, unsigned int fromIndex = 0) const;
+	int				 lastIndexOf(char ch) const;
+	int				 lastIndexOf(const String &str) const;
+	String			 substring(unsigned int beginIndex) const	{ return substring(beginIndex, _len); }
+	String			 substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	void			 replace(const String &find, const String &replace);
+	void			 remove(unsigned int index, unsigned int count);
+	void			 toLowerCase(void);
+	void			 toUpperCase(void);
+	void			 trim(void);
+
+	long			 toInt(void) const;
+	double			 toFloat(void) const;
+};
+
+
+//	Concatenation operators. Arduino uses a StringSumHelper for this, but
+//	returning a new String has the same semantics.
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+String operator+(const String &lhs, int rhs);
+String operator+(const String &lhs, unsigned int rhs);
+String operator+(const String &lhs, long rhs);
+String operator+(const String &lhs, unsigned long rhs);
+String operator+(const String &lhs, const __FlashStringHelper *rhs);
+
+# endif
@@ -0,0 +1,10 @@
+/*
+ *	WiFi.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	ESP32 name of the host WiFi shim.
+ */
+
+# include "ESP8266WiFi.h"
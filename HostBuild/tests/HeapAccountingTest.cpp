@@ -0,0 +1,152 @@
+/*
+ *	HeapAccountingTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks that the hot paths of the TaskManager and the HttpServer don't
+ *	allocate memory, and that allocations are attributed to the right
+ *	subsystem.
+ */
+
+# define HEAP_ACCOUNTING
+
+# include "Arduino.h"
+# include "../../HeapAccounting/HeapAccounting.ino"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../TaskManager/TaskManager.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "Test.h"
+
+# define TEST_PORT		18190
+
+static unsigned long 	taskRuns = 0;
+static String 			taskText;
+
+
+static bool countingTask() {
+	taskRuns++;
+	return true;
+}
+
+
+static bool allocatingTask() {
+	taskText += "x";
+	return true;
+}
+
+
+// Return the number of allocations of all subsystems
+static unsigned long allAllocations(void) {
+	unsigned long result = 0;
+	for (int i = 0; i < HEAP_SUBSYSTEMS; i++) {
+		result += HeapAccounting::allocations((HeapSubsystem)i);
+	}
+	return result;
+}
+
+
+static void testRunTasks(void) {
+	TaskManager idleTaskManager;
+	TaskManager dueTaskManager;
+	for (int i = 0; i < 10; i++) {
+		idleTaskManager.addTask(countingTask, 1000000UL);
+		dueTaskManager.addTask(countingTask, 0);
+	}
+	idleTaskManager.runTasks();		// all tasks are run once after being started
+
+	// The checks themselves allocate, so the counters are read first
+	unsigned long allocations = allAllocations();
+	unsigned long hostAllocations = hostHeapAllocations();
+	unsigned long runs = taskRuns;
+	for (int i = 0; i < 100; i++) {
+		idleTaskManager.runTasks();
+	}
+	unsigned long idleAllocations = allAllocations() - allocations;
+	unsigned long idleHostAllocations = hostHeapAllocations() - hostAllocations;
+	unsigned long idleRuns = taskRuns - runs;
+
+	allocations = allAllocations();
+	hostAllocations = hostHeapAllocations();
+	runs = taskRuns;
+	for (int i = 0; i < 100; i++) {
+		dueTaskManager.runTasks();
+	}
+	unsigned long dueAllocations = allAllocations() - allocations;
+	unsigned long dueHostAllocations = hostHeapAllocations() - hostAllocations;
+	unsigned long dueRuns = taskRuns - runs;
+
+	CHECK_EQUAL(idleRuns, 0);
+	CHECK_EQUAL(idleAllocations, 0);
+	CHECK_EQUAL(idleHostAllocations, 0);
+	CHECK_EQUAL(dueRuns, 1000);
+	CHECK_EQUAL(dueAllocations, 0);
+	CHECK_EQUAL(dueHostAllocations, 0);
+}
+
+
+static void testIdleCheck(void) {
+	HttpServer server(TEST_PORT);
+	server.check();
+
+	unsigned long allocations = allAllocations();
+	unsigned long hostAllocations = hostHeapAllocations();
+	for (int i = 0; i < 100; i++) {
+		server.check();
+	}
+	unsigned long checkAllocations = allAllocations() - allocations;
+	unsigned long checkHostAllocations = hostHeapAllocations() - hostAllocations;
+	CHECK_EQUAL(checkAllocations, 0);
+	CHECK_EQUAL(checkHostAllocations, 0);
+}
+
+
+static void testAttribution(void) {
+	const HeapStatistics &list = HeapAccounting::statistics(HEAP_LINKEDLIST);
+	const HeapStatistics &tasks = HeapAccounting::statistics(HEAP_TASKMANAGER);
+	const HeapStatistics &application = HeapAccounting::statistics(HEAP_APPLICATION);
+
+	// a list of the application
+	LinkedList<int> l;
+	unsigned long listAllocations = list.allocations;
+	long listBytes = list.currentBytes;
+	l.add(1);
+	l.add(2);
+	CHECK_EQUAL(list.allocations, listAllocations + 2);
+	CHECK(list.currentBytes > listBytes);
+	l.clear();
+	CHECK_EQUAL(list.currentBytes, listBytes);
+
+	// the list of a TaskManager belongs to the TaskManager
+	TaskManager taskManager;
+	unsigned long taskAllocations = tasks.allocations;
+	listAllocations = list.allocations;
+	long taskBytes = tasks.currentBytes;
+	long id = taskManager.addTask(allocatingTask, 0);
+	CHECK_EQUAL(tasks.allocations, taskAllocations + 2);	// the task and its list node
+	CHECK_EQUAL(list.allocations, listAllocations);
+
+	// allocations of task handlers belong to the application
+	unsigned long applicationAllocations = application.allocations;
+	taskAllocations = tasks.allocations;
+	taskManager.runTasks();
+	CHECK(application.allocations > applicationAllocations);
+	CHECK_EQUAL(tasks.allocations, taskAllocations);
+	CHECK_EQUAL(HeapAccounting::currentSubsystem(), HEAP_APPLICATION);
+
+	taskManager.removeTask(id);
+	CHECK_EQUAL(tasks.currentBytes, taskBytes);
+	CHECK(tasks.peakBytes > taskBytes);
+
+	HeapAccounting::reset();
+	CHECK_EQUAL(tasks.allocations, 0);
+	CHECK_EQUAL(tasks.peakBytes, tasks.currentBytes);
+}
+
+
+int main() {
+	testRunTasks();
+	testIdleCheck();
+	testAttribution();
+	return testResult("HeapAccountingTest");
+}
@@ -0,0 +1,204 @@
+/*
+ *	HttpServerMetricsTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the request metrics of the HttpServer, which is compiled with
+ *	HTTPSERVER_METRICS by the Makefile: the counters, timeouts, and the
+ *	Prometheus text with one group per metric family and escaped labels.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "Test.h"
+
+# ifndef HTTPSERVER_METRICS
+# error "HttpServerMetricsTest must be compiled with HTTPSERVER_METRICS"
+# endif
+
+# define TEST_PORT		18200
+# define ODD_PATH		"/odd\"path\\\\"
+
+static const uint8_t 	assetData[] PROGMEM = "body { }";
+
+
+HttpServer::RequestResult okHandler(String, HttpServer::Method, long, String, char *) {
+	HttpServer::RequestResult result;
+	result.returnCode = 200;
+	result.type = "text/plain";
+	result.content = "ok";
+	return result;
+}
+
+
+HttpServer::RequestResult failHandler(String, HttpServer::Method, long, String, char *) {
+	HttpServer::RequestResult result;
+	result.returnCode = 500;
+	return result;
+}
+
+
+// Send a request to the server and return the complete answer
+static String request(HttpServer &server, String method, String path) {
+	WiFiClient client;
+	if ( ! client.connect("127.0.0.1", TEST_PORT)) {
+		return "";
+	}
+	client.print(method + " " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+	server.check();
+	String answer;
+	unsigned long start = millis();
+	while ((client.connected() || client.available()) && millis() - start < 2000) {
+		if (client.available()) {
+			answer += (char)client.read();
+		}
+	}
+	client.stop();
+	return answer;
+}
+
+
+// An incomplete request that times out
+static void timeout(HttpServer &server) {
+	WiFiClient client;
+	client.connect("127.0.0.1", TEST_PORT);
+	client.print("GET /ok HTTP/1.1\r\n");
+	server.setTimeout(100);
+	server.check();
+	server.setTimeout(HTTPSERVER_TIMEOUT);
+	client.stop();
+}
+
+
+// Return the lines of the text that start with *prefix*, one per line
+static String lines(const String &text, String prefix) {
+	String result;
+	unsigned int start = 0;
+	while (start < text.length()) {
+		int end = text.indexOf('\n', start);
+		if (end < 0) {
+			end = text.length();
+		}
+		String line = text.substring(start, end);
+		if (line.startsWith(prefix)) {
+			result += line + "\n";
+		}
+		start = end + 1;
+	}
+	return result;
+}
+
+
+static void testCounters(HttpServer &server) {
+	CHECK(request(server, "GET", "/ok").startsWith("HTTP/1.1 200"));
+	CHECK(request(server, "GET", "/ok").startsWith("HTTP/1.1 200"));
+	CHECK(request(server, "POST", ODD_PATH).startsWith("HTTP/1.1 500"));
+	CHECK(request(server, "GET", "/style.css").startsWith("HTTP/1.1 200"));
+	CHECK(request(server, "GET", "/unknown").startsWith("HTTP/1.1 501"));
+	timeout(server);
+
+	const HttpServer::Metrics &metrics = server.getMetrics();
+	CHECK_EQUAL(metrics.requests, 5);
+	CHECK_EQUAL(metrics.requestsByMethod[HttpServer::GET], 4);
+	CHECK_EQUAL(metrics.requestsByMethod[HttpServer::POST], 1);
+	CHECK_EQUAL(metrics.responsesByStatus[2], 3);
+	CHECK_EQUAL(metrics.responsesByStatus[5], 2);
+	CHECK_EQUAL(metrics.notImplemented, 1);
+	CHECK_EQUAL(metrics.timeouts, 1);
+	CHECK_EQUAL(metrics.parseTime.count, 5);
+	CHECK_EQUAL(metrics.handlerTime.count, 3);
+	CHECK(metrics.bytesOut > 0);
+
+	const HttpServer::RouteMetrics *route = server.getRouteMetrics("/ok", HttpServer::GET);
+	CHECK(route != NULL && route->requests == 2 && route->errors == 0 && route->handlerTime.count == 2);
+	route = server.getRouteMetrics(ODD_PATH, HttpServer::POST);
+	CHECK(route != NULL && route->requests == 1 && route->errors == 1);
+	CHECK(server.getRouteMetrics("/unknown", HttpServer::GET) == NULL);
+}
+
+
+// Every metric family is written at once after its HELP and TYPE lines, and
+// label values are escaped
+static void testExposition(HttpServer &server) {
+	String answer = request(server, "GET", "/metrics");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK(answer.indexOf("Content-Type: text/plain; version=0.0.4") > 0);
+	int idx = answer.indexOf("\r\n\r\n");
+	CHECK(idx > 0);
+	String text = answer.substring(idx + 4);
+	CHECK(text.endsWith("\n"));
+
+	// the samples of a family follow its HELP and TYPE lines without interruption
+	String family;
+	int 	families = 0;
+	String 		seen = " ";
+	unsigned int	start = 0;
+	while (start < text.length()) {
+		int end = text.indexOf('\n', start);
+		String line = text.substring(start, end);
+		start = end + 1;
+		if (line.startsWith("# HELP ")) {
+			family = line.substring(7, line.indexOf(' ', 7));
+			CHECK(seen.indexOf(" " + family + " ") < 0);		// each family only once
+			seen += family + " ";
+			families++;
+			continue;
+		}
+		if (line.startsWith("# TYPE ")) {
+			CHECK(line.startsWith("# TYPE " + family + " "));
+			continue;
+		}
+		CHECK(family.length() > 0 && line.startsWith(family));
+	}
+	CHECK_EQUAL(families, 15);
+
+	// counters and histograms
+	CHECK_EQUAL(lines(text, "httpserver_requests_total{"), 
+				"httpserver_requests_total{method=\"GET\"} 5\nhttpserver_requests_total{method=\"POST\"} 1\n");
+	CHECK_EQUAL(lines(text, "httpserver_timeouts_total "), "httpserver_timeouts_total 1\n");
+	CHECK_EQUAL(lines(text, "httpserver_not_implemented_total "), "httpserver_not_implemented_total 1\n");
+	CHECK_EQUAL(lines(text, "httpserver_parse_seconds_count "), "httpserver_parse_seconds_count 6\n");
+	CHECK_EQUAL(lines(text, "httpserver_parse_seconds_bucket{le=\"+Inf\"} "), "httpserver_parse_seconds_bucket{le=\"+Inf\"} 6\n");
+
+	// per route, with an escaped path
+	CHECK_EQUAL(lines(text, "httpserver_route_requests_total{"),
+				"httpserver_route_requests_total{path=\"/ok\",method=\"GET\"} 2\n"
+				"httpserver_route_requests_total{path=\"/odd\\\"path\\\\\\\\\",method=\"POST\"} 1\n"
+				"httpserver_route_requests_total{path=\"/style.css\",method=\"GET\"} 1\n");
+	CHECK_EQUAL(lines(text, "httpserver_route_errors_total{path=\"/odd"),
+				"httpserver_route_errors_total{path=\"/odd\\\"path\\\\\\\\\",method=\"POST\"} 1\n");
+	CHECK_EQUAL(lines(text, "httpserver_route_handler_seconds_count{path=\"/ok\""),
+				"httpserver_route_handler_seconds_count{path=\"/ok\",method=\"GET\"} 2\n");
+
+	// the text is allocated once with its exact size. Only the temporary
+	// Strings of a single line are added to the peak.
+	size_t used = hostHeapUsed();
+	hostHeapResetPeak();
+	String metrics = server.metricsText();
+	CHECK(metrics.length() > 0);
+	CHECK(hostHeapPeak() - used < metrics.length() + 2048);
+}
+
+
+static void testReset(HttpServer &server) {
+	server.resetMetrics();
+	CHECK_EQUAL(server.getMetrics().requests, 0);
+	CHECK_EQUAL(server.getMetrics().timeouts, 0);
+	CHECK_EQUAL(server.getRouteMetrics("/ok", HttpServer::GET)->requests, 0);
+}
+
+
+int main() {
+	HttpServer server(TEST_PORT);
+	server.addHandler("/ok", HttpServer::GET, okHandler);
+	server.addHandler(ODD_PATH, HttpServer::POST, failHandler);
+	server.addStaticAsset("/style.css", "text/css", assetData, sizeof(assetData) - 1);
+	server.enableMetricsHandler();
+
+	testCounters(server);
+	testExposition(server);
+	testReset(server);
+	return testResult("HttpServerMetricsTest");
+}
@@ -0,0 +1,188 @@
+/*
+ *	HttpServerTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the content negotiation of static assets, that a shared content
+ *	of a request handler is sent without copying it, and that an incomplete
+ *	request is answered with 408 after the timeout.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "Test.h"
+
+# define TEST_PORT		18191
+
+static const uint8_t 	gzipData[] PROGMEM = { 0x1f, 0x8b, 0x08, 0x00, 0x01, 0x02, 0x03 };
+static const uint8_t 	identityData[] PROGMEM = "console.log(1);";
+static String 			sharedPage;
+
+
+// Send a request with additional *headers* to the server and return the
+// complete answer. *serverPeak* receives the increase of the heap peak while
+// the server handled the request.
+static String request(HttpServer &server, String path, String headers, size_t *serverPeak = NULL) {
+	WiFiClient client;
+	if ( ! client.connect("127.0.0.1", TEST_PORT)) {
+		return "";
+	}
+	client.print("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n");
+	size_t used = hostHeapUsed();
+	hostHeapResetPeak();
+	server.check();
+	if (serverPeak != NULL) {
+		*serverPeak = hostHeapPeak() - used;
+	}
+	String answer;
+	unsigned long start = millis();
+	while ((client.connected() || client.available()) && millis() - start < 2000) {
+		if (client.available()) {
+			answer += (char)client.read();
+		}
+	}
+	client.stop();
+	return answer;
+}
+
+
+static String header(String answer, String name) {
+	int idx = answer.indexOf("\r\n" + name + ": ");
+	if (idx < 0) {
+		return "";
+	}
+	int end = answer.indexOf("\r\n", idx + 2);
+	return answer.substring(idx + name.length() + 4, end);
+}
+
+
+static void testAcceptEncoding(void) {
+	CHECK(HttpServer::acceptsEncoding("gzip, deflate, br", "gzip"));
+	CHECK(HttpServer::acceptsEncoding("deflate, GZIP;q=0.5", "gzip"));
+	CHECK(HttpServer::acceptsEncoding("x-gzip", "gzip"));
+	CHECK(HttpServer::acceptsEncoding("*", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("gzip;q=0", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("gzip; q=0.0, identity", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("*;q=0", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("*, gzip;q=0", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("deflate, br", "gzip"));
+	CHECK( ! HttpServer::acceptsEncoding("", "gzip"));
+	CHECK(HttpServer::acceptsEncoding("", "identity"));
+	CHECK(HttpServer::acceptsEncoding("gzip", "identity"));
+	CHECK( ! HttpServer::acceptsEncoding("gzip, identity;q=0", "identity"));
+	CHECK( ! HttpServer::acceptsEncoding("*;q=0", "identity"));
+}
+
+
+static void testStaticAssets(HttpServer &server) {
+	server.addStaticAsset("/gzip.js", "application/javascript", gzipData, sizeof(gzipData), true);
+	server.addStaticAsset("/both.js", "application/javascript", gzipData, sizeof(gzipData), true, 60,
+						  identityData, sizeof(identityData) - 1);
+
+	// gzip only
+	String answer = request(server, "/gzip.js", "Accept-Encoding: gzip\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK_EQUAL(header(answer, "Content-Encoding"), "gzip");
+	answer = request(server, "/gzip.js", "Accept-Encoding: gzip;q=0\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 406"));
+	answer = request(server, "/gzip.js", "Accept-Encoding: identity\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 406"));
+
+	// a client without Accept-Encoding header accepts every encoding
+	answer = request(server, "/gzip.js", "");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK_EQUAL(header(answer, "Content-Encoding"), "gzip");
+
+	// gzip with an identity copy
+	answer = request(server, "/both.js", "Accept-Encoding: br, gzip\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK_EQUAL(header(answer, "Content-Encoding"), "gzip");
+	CHECK_EQUAL(header(answer, "Content-Length"), sizeof(gzipData));
+	CHECK_EQUAL(header(answer, "Vary"), "Accept-Encoding");
+	String gzipEtag = header(answer, "ETag");
+
+	answer = request(server, "/both.js", "Accept-Encoding: gzip;q=0, identity\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK_EQUAL(header(answer, "Content-Encoding"), "");
+	CHECK_EQUAL(header(answer, "Vary"), "Accept-Encoding");
+	CHECK(answer.endsWith("\r\n\r\nconsole.log(1);"));
+	String identityEtag = header(answer, "ETag");
+	CHECK(identityEtag.length() > 0 && identityEtag != gzipEtag);
+	answer = request(server, "/both.js", "Accept-Encoding: gzip;q=0, identity;q=0\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 406"));
+
+	// without Accept-Encoding header the uncompressed copy is preferred
+	answer = request(server, "/both.js", "");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK_EQUAL(header(answer, "Content-Encoding"), "");
+	CHECK_EQUAL(header(answer, "ETag"), identityEtag);
+
+	// revalidation with the entity tag of the delivered representation
+	answer = request(server, "/both.js", "If-None-Match: " + identityEtag + "\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 304"));
+	answer = request(server, "/both.js", "Accept-Encoding: gzip\r\nIf-None-Match: " + identityEtag + "\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	answer = request(server, "/both.js", "Accept-Encoding: gzip\r\nIf-None-Match: " + gzipEtag + "\r\n");
+	CHECK(answer.startsWith("HTTP/1.1 304"));
+}
+
+
+HttpServer::RequestResult sharedPageHandler(String, HttpServer::Method, long, String, char *) {
+	HttpServer::RequestResult result;
+	result.returnCode = 200;
+	result.type = "text/html";
+	result.sharedContent = &sharedPage;
+	return result;
+}
+
+
+// A shared content is sent completely, without a copy in the server
+static void testSharedContent(HttpServer &server) {
+	for (int i = 0; i < 8000; i++) {
+		sharedPage += (char)('a' + i % 26);
+	}
+	server.addHandler("/page", HttpServer::GET, sharedPageHandler);
+	size_t peak;
+	String answer = request(server, "/page", "", &peak);
+	CHECK(answer.startsWith("HTTP/1.1 200"));
+	CHECK(answer.indexOf("Content-Length: " + String(sharedPage.length()) + "\r\n") > 0);
+	CHECK(answer.endsWith("\r\n\r\n" + sharedPage));
+	CHECK(peak < sharedPage.length());
+}
+
+
+// A request that is not completed in time is answered with 408. The server
+// continues with the next request.
+static void testTimeout(HttpServer &server) {
+	WiFiClient client;
+	CHECK(client.connect("127.0.0.1", TEST_PORT));
+	client.print("GET /page HTTP/1.1\r\nHost: local");		// the header is never finished
+	server.setTimeout(100);
+	unsigned long start = millis();
+	server.check();
+	CHECK(millis() - start >= 100);
+	String answer;
+	start = millis();
+	while ((client.connected() || client.available()) && millis() - start < 2000) {
+		if (client.available()) {
+			answer += (char)client.read();
+		}
+	}
+	client.stop();
+	CHECK(answer.startsWith("HTTP/1.1 408"));
+
+	CHECK(request(server, "/page", "").startsWith("HTTP/1.1 200"));
+	server.setTimeout(HTTPSERVER_TIMEOUT);
+}
+
+
+int main() {
+	HttpServer server(TEST_PORT);
+	testAcceptEncoding();
+	testStaticAssets(server);
+	testSharedContent(server);
+	testTimeout(server);
+	return testResult("HttpServerTest");
+}
@@ -0,0 +1,222 @@
+/*
+ *	OneM2MConnectionTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks that the OneM2M client reuses its connections to the mock CSE,
+ *	that only idempotent requests are sent again when a reused connection
+ *	is closed before the response, and that asynchronous requests connect
+ *	and send without blocking and leave a connection for synchronous ones.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../RingBuffer/Ringbuffer.ino"
+# include "../../EEPROMStore/EEPROMStore.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "../../oneM2M/oneM2M.ino"
+# include "../MockCSE.ino"
+# include "Test.h"
+
+# define TEST_PORT		18192
+# define CLOSED_PORT	18199
+# define CONTAINER_PATH	"/cse/testAE/container"
+
+static int 	completedRequests = 0;
+static int 	lastStatusCode = -1;
+
+
+void completionCallback(long, int statusCode, String) {
+	completedRequests++;
+	lastStatusCode = statusCode;
+}
+
+
+// Poll the asynchronous requests until they are completed
+static void waitForRequests(OneM2M &cse) {
+	unsigned long start = millis();
+	while (cse.pendingRequests() > 0 && millis() - start < 2000) {
+		cse.poll();
+		yield();
+	}
+}
+
+
+static void testReuse(OneM2M &cse, MockCSE &mockCSE) {
+	CHECK(cse.getAE("/cse/testAE", "test").length() > 0);
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	for (int i = 0; i < 10; i++) {
+		CHECK(cse.addContentInstance(CONTAINER_PATH, String(i)).length() > 0);
+	}
+	const OneM2M::ConnectionStatistics &statistics = cse.connectionStatistics();
+	CHECK_EQUAL(statistics.connects, 1);
+	CHECK(statistics.reuses > 0);
+	CHECK_EQUAL(statistics.reuses, statistics.requests - 1);
+	CHECK_EQUAL(statistics.reconnects, 0);
+	CHECK_EQUAL(mockCSE.statistics().connections, 1);
+	CHECK_EQUAL(mockCSE.openConnections(), 1);
+}
+
+
+// A GET request is sent again over a new connection
+static void testRetryGet(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::ConnectionStatistics 	statistics = cse.connectionStatistics();
+	unsigned long 					retrieves = mockCSE.statistics().retrieves;
+
+	mockCSE.dropRequests(1);
+	CHECK(cse.retrieveContainer(CONTAINER_PATH).length() > 0);
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, statistics.reconnects + 1);
+	CHECK_EQUAL(cse.connectionStatistics().connects, statistics.connects + 1);
+	CHECK_EQUAL(mockCSE.statistics().retrieves, retrieves + 2);
+
+	// no retry if the new connection fails as well
+	mockCSE.dropRequests(2);
+	CHECK_EQUAL(cse.retrieveContainer(CONTAINER_PATH), "");
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, statistics.reconnects + 2);
+	CHECK_EQUAL(mockCSE.statistics().retrieves, retrieves + 4);
+}
+
+
+// A POST request that was sent completely is not sent again, because the
+// CSE might have created the resource already
+static void testNoRetryPost(OneM2M &cse, MockCSE &mockCSE) {
+	unsigned long reconnects = cse.connectionStatistics().reconnects;
+	unsigned long creates = mockCSE.statistics().creates;
+
+	CHECK(cse.retrieveContainer(CONTAINER_PATH).length() > 0);		// open a connection to reuse
+	mockCSE.dropRequests(1);
+	CHECK_EQUAL(cse.addContentInstance(CONTAINER_PATH, "once"), "");
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 1);
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, reconnects);
+	CHECK_EQUAL(cse.getLatestContentInstance(CONTAINER_PATH).content, "once");
+
+	// the following request uses a new connection
+	CHECK(cse.addContentInstance(CONTAINER_PATH, "twice").length() > 0);
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 2);
+}
+
+
+static void testAsyncRetry(OneM2M &cse, MockCSE &mockCSE) {
+	unsigned long reconnects = cse.connectionStatistics().reconnects;
+	unsigned long creates = mockCSE.statistics().creates;
+
+	// GET is sent again
+	CHECK(cse.retrieveContainer(CONTAINER_PATH).length() > 0);
+	mockCSE.dropRequests(1);
+	cse.getResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTAINER, completionCallback);
+	waitForRequests(cse);
+	CHECK_EQUAL(completedRequests, 1);
+	CHECK_EQUAL(lastStatusCode, 200);
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, reconnects + 1);
+
+	// POST is not sent again
+	CHECK(cse.retrieveContainer(CONTAINER_PATH).length() > 0);
+	mockCSE.dropRequests(1);
+	cse.createResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTENTINSTANCE, "{\"m2m:cin\":{\"con\":\"async\"}}", completionCallback);
+	waitForRequests(cse);
+	CHECK_EQUAL(completedRequests, 2);
+	CHECK_EQUAL(lastStatusCode, 0);
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, reconnects + 1);
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 1);
+}
+
+
+// Synchronous requests use the reserved connection while asynchronous
+// requests occupy the others
+static void testReservedConnection(OneM2M &cse) {
+	int completed = completedRequests;
+	for (int i = 0; i < ONEM2M_MAX_CONNECTIONS + 1; i++) {
+		cse.getResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTAINER, completionCallback);
+	}
+	cse.poll();
+	CHECK_EQUAL(cse.pendingRequests(), ONEM2M_MAX_CONNECTIONS + 1);
+	CHECK(cse.retrieveContainer(CONTAINER_PATH).length() > 0);
+	CHECK_EQUAL(cse.pendingRequests(), ONEM2M_MAX_CONNECTIONS + 1);		// no need to wait for them
+	CHECK_EQUAL(completedRequests, completed);							// callbacks only from poll()
+	waitForRequests(cse);
+	CHECK_EQUAL(completedRequests, completed + ONEM2M_MAX_CONNECTIONS + 1);
+	CHECK_EQUAL(lastStatusCode, 200);
+}
+
+
+// A large request is sent in parts by several calls of poll()
+static void testPartialSend(OneM2M &cse, MockCSE &mockCSE) {
+	String content;
+	for (int i = 0; i < 3 * ONEM2M_SEND_SIZE; i++) {
+		content += (char)('a' + i % 26);
+	}
+	int 			completed = completedRequests;
+	unsigned long 	creates = mockCSE.statistics().creates;
+	cse.createResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTENTINSTANCE, "{\"m2m:cin\":{\"con\":\"" + content + "\"}}", completionCallback);
+	int polls = 0;
+	while (cse.pendingRequests() > 0 && polls < 10000) {
+		cse.poll();
+		yield();
+		polls++;
+	}
+	CHECK_EQUAL(completedRequests, completed + 1);
+	CHECK_EQUAL(lastStatusCode, 201);
+	CHECK(polls >= 5);		// waiting, at least three parts, receiving
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 1);
+}
+
+
+// A client that accepts only a part of each write doesn't fail the request.
+// The remaining data is sent by the following calls of poll().
+static void testShortWrites(OneM2M &cse, MockCSE &mockCSE) {
+	String content;
+	for (int i = 0; i < 2 * ONEM2M_SEND_SIZE; i++) {
+		content += (char)('a' + i % 26);
+	}
+	int 			completed = completedRequests;
+	unsigned long 	creates = mockCSE.statistics().creates;
+	unsigned long 	reconnects = cse.connectionStatistics().reconnects;
+	hostLimitWrites(100);
+	cse.createResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTENTINSTANCE, "{\"m2m:cin\":{\"con\":\"" + content + "\"}}", completionCallback);
+	waitForRequests(cse);
+	hostLimitWrites(0);
+	CHECK_EQUAL(completedRequests, completed + 1);
+	CHECK_EQUAL(lastStatusCode, 201);
+	CHECK_EQUAL(cse.connectionStatistics().reconnects, reconnects);
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 1);
+	CHECK_EQUAL(cse.getLatestContentInstance(CONTAINER_PATH).content, content.substring(0, ONEM2M_CONTENT_SIZE - 1));
+}
+
+
+// Connecting to a port without a server doesn't block poll(), and the 
+// request fails
+static void testConnectFailure(void) {
+	OneM2M 	cse("127.0.0.1", CLOSED_PORT, "/", "CTest");
+	int 	completed = completedRequests;
+
+	cse.setTimeout(1000);
+	cse.getResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTAINER, completionCallback);
+	unsigned long longest = 0;
+	while (cse.pendingRequests() > 0) {
+		unsigned long t = millis();
+		cse.poll();
+		longest = millis() - t > longest ? millis() - t : longest;
+	}
+	CHECK_EQUAL(completedRequests, completed + 1);
+	CHECK_EQUAL(lastStatusCode, 0);
+	CHECK_EQUAL(cse.connectionStatistics().failures, 1);
+	CHECK(longest < 100);
+}
+
+
+int main() {
+	MockCSE 	mockCSE(TEST_PORT);
+	OneM2M 		cse("127.0.0.1", TEST_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+
+	testReuse(cse, mockCSE);
+	testRetryGet(cse, mockCSE);
+	testNoRetryPost(cse, mockCSE);
+	testAsyncRetry(cse, mockCSE);
+	testReservedConnection(cse);
+	testPartialSend(cse, mockCSE);
+	testShortWrites(cse, mockCSE);
+	testConnectFailure();
+	return testResult("OneM2MConnectionTest");
+}
@@ -0,0 +1,190 @@
+/*
+ *	ResourceCacheTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the resource cache of the OneM2M client against the mock CSE:
+ *	hits and misses, the invalidation of resources that were removed, are
+ *	not accessible anymore or were deleted, and the reload of the cache
+ *	from an EEPROMStore for the same CSE and originator only. A disabled
+ *	cache doesn't access its store.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../RingBuffer/Ringbuffer.ino"
+# include "../../EEPROMStore/EEPROMStore.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "../../oneM2M/oneM2M.ino"
+# include "../MockCSE.ino"
+# include "Test.h"
+
+# define TEST_PORT		18196
+# define OTHER_PORT		18197
+# define AE_PATH		"/cse/testAE"
+# define CONTAINER_PATH	"/cse/testAE/container"
+# define STORE_ENTRIES	4
+
+
+// The first requests for resources are misses, the following ones are
+// answered from the cache without a request to the CSE
+static void testHitAndMiss(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::CacheStatistics statistics = cse.cacheStatistics();
+
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 2);
+	CHECK_EQUAL(cse.cacheStatistics().hits, statistics.hits);
+
+	unsigned long requests = mockCSE.statistics().requests;
+	for (int i = 0; i < 3; i++) {
+		CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+		CHECK(cse.getResourceIdentifier(cse.getContainer(CONTAINER_PATH)).length() > 0);
+	}
+	CHECK_EQUAL(cse.cacheStatistics().hits, statistics.hits + 6);
+	CHECK_EQUAL(cse.cacheStatistics().roundTripsSaved, statistics.roundTripsSaved + 6);
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 2);
+	CHECK_EQUAL(mockCSE.statistics().requests, requests);
+}
+
+
+// A resource that was removed from the CSE is removed from the cache after
+// a request was answered with 404
+static void testInvalidateNotFound(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::CacheStatistics statistics = cse.cacheStatistics();
+	unsigned long 			creates = mockCSE.statistics().creates;
+
+	CHECK(mockCSE.removeResource(CONTAINER_PATH));
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);		// still cached
+	CHECK_EQUAL(cse.addContentInstance(CONTAINER_PATH, "lost"), "");
+	CHECK_EQUAL(cse.cacheStatistics().invalidations, statistics.invalidations + 1);
+
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);		// created again
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 2);		// the ContentInstance and the Container
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 1);
+	CHECK_EQUAL(cse.cacheStatistics().roundTripsSaved, statistics.roundTripsSaved + 1);
+	CHECK(cse.addContentInstance(CONTAINER_PATH, "found").length() > 0);
+}
+
+
+// A resource that is not accessible anymore is removed from the cache after
+// a request was answered with 403. Its parent resource stays in the cache.
+static void testInvalidateForbidden(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::CacheStatistics statistics = cse.cacheStatistics();
+
+	mockCSE.forbid(CONTAINER_PATH);
+	CHECK_EQUAL(cse.retrieveContainer(CONTAINER_PATH), "");
+	CHECK_EQUAL(cse.cacheStatistics().invalidations, statistics.invalidations + 1);
+	CHECK_EQUAL(cse.getContainer(CONTAINER_PATH), "");
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 1);
+
+	mockCSE.forbid("");
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 2);
+	CHECK_EQUAL(cse.cacheStatistics().hits, statistics.hits + 1);
+}
+
+
+// A deleted resource is removed from the cache together with its child
+// resources
+static void testInvalidateDelete(OneM2M &cse) {
+	OneM2M::CacheStatistics statistics = cse.cacheStatistics();
+
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	CHECK(cse.deleteResource(AE_PATH).length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().invalidations, statistics.invalidations + 2);
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().misses, statistics.misses + 2);
+	CHECK(cse.addContentInstance(CONTAINER_PATH, "again").length() > 0);
+}
+
+
+// A new client reads the cache from the store when it uses the same CSE
+// and originator. Otherwise the stored resources are removed.
+static void testStore(MockCSE &mockCSE) {
+	EEPROMStore store(STORE_ENTRIES, 64);
+	{
+		OneM2M cse("127.0.0.1", TEST_PORT, "/", "CTest");
+		cse.setTimeout(2000);
+		cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+		CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+		CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+		CHECK_EQUAL(cse.cacheStatistics().misses, 2);
+		CHECK_EQUAL(store.getString(0), "127.0.0.1:" + String(TEST_PORT) + "/ CTest");
+	}
+	{
+		OneM2M cse("127.0.0.1", TEST_PORT, "/", "CTest");
+		cse.setTimeout(2000);
+		cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+		unsigned long requests = mockCSE.statistics().requests;
+		CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+		CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+		CHECK_EQUAL(cse.cacheStatistics().hits, 2);
+		CHECK_EQUAL(cse.cacheStatistics().roundTripsSaved, 2);
+		CHECK_EQUAL(cse.cacheStatistics().misses, 0);
+		CHECK_EQUAL(mockCSE.statistics().requests, requests);
+	}
+	{
+		// another originator
+		OneM2M cse("127.0.0.1", TEST_PORT, "/", "COther");
+		cse.setTimeout(2000);
+		cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+		CHECK_EQUAL(store.getString(1), "");
+		CHECK_EQUAL(store.getString(2), "");
+		CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+		CHECK_EQUAL(cse.cacheStatistics().hits, 0);
+		CHECK_EQUAL(cse.cacheStatistics().misses, 1);
+	}
+	{
+		// another CSE
+		OneM2M cse("127.0.0.1", OTHER_PORT, "/", "COther");
+		cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+		CHECK_EQUAL(store.getString(0), "127.0.0.1:" + String(OTHER_PORT) + "/ COther");
+		CHECK_EQUAL(store.getString(1), "");
+	}
+}
+
+
+// A cache that was disabled doesn't use its store anymore. The stored
+// resources are kept for the next time the cache is enabled.
+static void testDisableStore(void) {
+	EEPROMStore store(STORE_ENTRIES, 64);
+	OneM2M 		cse("127.0.0.1", TEST_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+	cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	String stored = store.getString(1);
+	CHECK(stored.length() > 0);
+
+	cse.disableResourceCache();
+	cse.clearResourceCache();
+	cse.invalidateResource(AE_PATH);
+	CHECK_EQUAL(store.getString(1), stored);
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().hits, 0);
+
+	cse.enableResourceCache(&store, 0, STORE_ENTRIES);
+	CHECK(cse.getAE(AE_PATH, "test").length() > 0);
+	CHECK_EQUAL(cse.cacheStatistics().hits, 1);
+	cse.invalidateResource(AE_PATH);
+	CHECK_EQUAL(store.getString(1), "");
+}
+
+
+int main() {
+	MockCSE 	mockCSE(TEST_PORT);
+	OneM2M 		cse("127.0.0.1", TEST_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+	cse.enableResourceCache();
+
+	testHitAndMiss(cse, mockCSE);
+	testInvalidateNotFound(cse, mockCSE);
+	testInvalidateForbidden(cse, mockCSE);
+	testInvalidateDelete(cse);
+	testStore(mockCSE);
+	testDisableStore();
+	return testResult("ResourceCacheTest");
+}
@@ -0,0 +1,367 @@
+/*
+ *	ScannerTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the JSON scanner of the OneM2M client: escapes and \u sequences,
+ *	captured objects, full buffers, malformed documents, response bodies
+ *	that arrive in small parts, and the verification requests and JSON and
+ *	CBOR notifications of the notification server.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../RingBuffer/Ringbuffer.ino"
+# include "../../EEPROMStore/EEPROMStore.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "../../oneM2M/oneM2M.ino"
+# include "Test.h"
+
+# define SERVER_PORT		18194
+# define NOTIFICATION_PORT	18195
+# define MAX_PARTS			512
+
+static WiFiServer 	*server = NULL;
+static WiFiClient 	 serverClient;
+static String 		 serverRequest;
+static String 		 parts[MAX_PARTS];		// parts of the next response, one is sent per yield()
+static int 			 partCount = 0;
+static int 			 nextPart = 0;
+
+static int 						notifiedFields = 0;
+static OneM2M::ResourceFields 	lastFields;
+static int 						notifiedResources = 0;
+static String 					lastResource;
+static OneM2M::ResourceType 	lastType;
+
+
+// Answer a request of the client with the parts of the response. This
+// function is called by yield() while the client waits for the response.
+static void serveResponse(void) {
+	if ( ! serverClient) {
+		serverClient = server->available();
+		return;
+	}
+	while (serverClient.available() > 0) {
+		serverRequest += (char)serverClient.read();
+	}
+	if (serverRequest.indexOf("\r\n\r\n") >= 0 && nextPart < partCount) {
+		serverClient.print(parts[nextPart++]);
+	}
+}
+
+
+// Split a response into parts of *size* bytes
+static void setResponse(String response, int size) {
+	partCount = 0;
+	nextPart = 0;
+	serverRequest = "";
+	for (unsigned int i = 0; i < response.length() && partCount < MAX_PARTS; i += size) {
+		parts[partCount++] = response.substring(i, i + size);
+	}
+}
+
+
+static String contentLengthResponse(String body) {
+	return "HTTP/1.1 200 OK\r\nX-M2M-RSC: 2000\r\nContent-Type: application/json\r\nContent-Length: " +
+		   String(body.length()) + "\r\n\r\n" + body;
+}
+
+
+// A chunked response with chunks of *size* bytes
+static String chunkedResponse(String body, int size) {
+	String response = "HTTP/1.1 200 OK\r\nX-M2M-RSC: 2000\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+	for (unsigned int i = 0; i < body.length(); i += size) {
+		String chunk = body.substring(i, i + size);
+		response += String(chunk.length(), 16) + "\r\n" + chunk + "\r\n";
+	}
+	return response + "0\r\n\r\n";
+}
+
+
+static bool decode(String document, OneM2M::ResourceFields &fields) {
+	return OneM2M::decodeResource(OneM2M::JSON, (const uint8_t *)document.c_str(), document.length(), fields);
+}
+
+
+static bool wellFormed(String document) {
+	OneM2M::ResourceFields fields;
+	return decode(document, fields);
+}
+
+
+static void testEscapes(void) {
+	OneM2M::ResourceFields fields;
+
+	CHECK(decode("{\"m2m:cin\":{\"con\":\"a\\\"b\\\\c\\/d\\n\\t\\r\\b\\f\"}}", fields));
+	CHECK_EQUAL(fields.content, "a\"b\\c/d\n\t\r\b\f");
+	CHECK(decode("{\"m2m:cin\":{\"con\":\"\\u0041\\u00e9\\u20AC!\"}}", fields));
+	CHECK_EQUAL(fields.content, "A\xc3\xa9\xe2\x82\xac!");
+	CHECK( ! decode("{\"m2m:cin\":{\"con\":\"\\u12G4\"}}", fields));
+	CHECK( ! decode("{\"m2m:cin\":{\"con\":\"\\u12", fields));
+}
+
+
+// Objects and arrays are captured as JSON text, with the strings unchanged
+static void testNestedContent(void) {
+	OneM2M::ResourceFields fields;
+
+	CHECK(decode("{\"m2m:cin\":{\"con\": {\"a\": [1, -2.5e3, true, null, {\"b\": \"x\\\"y\\u0041\"}]}, \"ty\": 4}}", fields));
+	CHECK_EQUAL(fields.content, "{\"a\":[1,-2.5e3,true,null,{\"b\":\"x\\\"y\\u0041\"}]}");
+	CHECK_EQUAL(fields.type, 4);
+
+	// only the first occurrence is captured
+	CHECK(decode("{\"m2m:cin\":{\"con\":\"first\",\"lbl\":{\"con\":\"second\"}}}", fields));
+	CHECK_EQUAL(fields.content, "first");
+	CHECK( ! fields.truncated);
+}
+
+
+static void testOverflow(void) {
+	OneM2M::ResourceFields 	fields;
+	String 					value;
+
+	for (int i = 0; i < ONEM2M_CONTENT_SIZE + 10; i++) {
+		value += 'x';
+	}
+	CHECK(decode("{\"m2m:cin\":{\"con\":\"" + value + "\",\"ri\":\"cin1\"}}", fields));
+	CHECK(fields.truncated);
+	CHECK_EQUAL(strlen(fields.content), ONEM2M_CONTENT_SIZE - 1);
+	CHECK_EQUAL(fields.resourceIdentifier, "cin1");
+	CHECK(decode("{\"m2m:cin\":{\"ri\":\"" + value + "\"}}", fields));
+	CHECK(fields.truncated);
+	CHECK_EQUAL(strlen(fields.resourceIdentifier), ONEM2M_ID_SIZE - 1);
+
+	// a long key doesn't match a shorter attribute name
+	CHECK(decode("{\"m2m:cin\":{\"conconconconcon\":\"x\"}}", fields));
+	CHECK_EQUAL(fields.content, "");
+
+	// nesting depth
+	String open = "";
+	String close = "";
+	for (int i = 0; i < 20; i++) {
+		open += "[";
+		close += "]";
+	}
+	CHECK(wellFormed("{\"a\":" + open + close + "}"));
+	CHECK( ! wellFormed("{\"a\":" + open + open + close + close + "}"));
+}
+
+
+static void testMalformed(void) {
+	OneM2M::ResourceFields fields;
+
+	CHECK(wellFormed("{}"));
+	CHECK(wellFormed("[]"));
+	CHECK(wellFormed(" { \"a\" : [ ] , \"b\" : { } } "));
+	CHECK(decode("{\"m2m:cin\":{\"ty\":-4}}", fields));
+	CHECK_EQUAL(fields.type, -4);
+
+	CHECK( ! wellFormed("{\"con\":\"x\",}"));
+	CHECK( ! wellFormed("[1,2,]"));
+	CHECK( ! wellFormed("{\"a\":[1,{},]}"));
+	CHECK( ! wellFormed("{,}"));
+	CHECK( ! wellFormed("{\"a\":1,,\"b\":2}"));
+	CHECK( ! wellFormed("{\"a\":[1 2]}"));
+	CHECK( ! wellFormed("{\"con\" \"x\"}"));
+	CHECK( ! wellFormed("{\"con\":\"x\""));
+	CHECK( ! wellFormed("{\"con\":\"x}"));
+	CHECK( ! wellFormed("{\"con\":\"x\"}}"));
+	CHECK( ! wellFormed("{\"con\":\"x\"} x"));
+	CHECK( ! wellFormed("{\"con\":\"x\"]"));
+	CHECK( ! wellFormed(""));
+
+	// the resource type must be an integer
+	CHECK( ! decode("{\"m2m:cin\":{\"ty\":-4e2}}", fields));
+	CHECK_EQUAL(fields.type, OneM2M::UNKNOWN);
+	CHECK( ! wellFormed("{\"m2m:cin\":{\"ty\":1.5}}"));
+	CHECK( ! wellFormed("{\"m2m:cin\":{\"ty\":true}}"));
+	CHECK( ! wellFormed("{\"m2m:cin\":{\"ty\":\"abc\"}}"));
+	CHECK( ! wellFormed("{\"m2m:cin\":{\"ty\":[4]}}"));
+}
+
+
+// Responses are scanned correctly when they arrive in small parts, also
+// when a part ends inside an escape sequence
+static void testSplitReads(OneM2M &cse) {
+	OneM2M::ResourceFields 	fields;
+	String 					body = "{\"m2m:cin\":{\"ri\":\"cin1\",\"ty\":4,\"con\":\"a\\\"b\\u00e9\\u20ac\",\"cnf\":\"text/plain:0\"}}";
+
+	setResponse(contentLengthResponse(body), 1);
+	CHECK(cse.getResourceFields("/cse/ae/cnt/cin1", OneM2M::ResourceType::CONTENTINSTANCE, fields));
+	CHECK(serverRequest.startsWith("GET /cse/ae/cnt/cin1 HTTP/1.1\r\n"));
+	CHECK_EQUAL(fields.resourceIdentifier, "cin1");
+	CHECK_EQUAL(fields.type, 4);
+	CHECK_EQUAL(fields.content, "a\"b\xc3\xa9\xe2\x82\xac");
+	CHECK_EQUAL(fields.contentFormat, "text/plain:0");
+
+	for (int size = 1; size <= 5; size++) {
+		memset(&fields, 0, sizeof(fields));
+		setResponse(chunkedResponse(body, size), 3);
+		CHECK(cse.getResourceFields("/cse/ae/cnt/cin1", OneM2M::ResourceType::CONTENTINSTANCE, fields));
+		CHECK_EQUAL(fields.content, "a\"b\xc3\xa9\xe2\x82\xac");
+	}
+
+	setResponse(chunkedResponse("{\"m2m:cin\":{\"con\":\"x\",}}", 4), 2);
+	CHECK( ! cse.getResourceFields("/cse/ae/cnt/cin1", OneM2M::ResourceType::CONTENTINSTANCE, fields));
+	setResponse(contentLengthResponse("{\"m2m:cin\":{\"ty\":-4e2}}"), 3);
+	CHECK( ! cse.getResourceFields("/cse/ae/cnt/cin1", OneM2M::ResourceType::CONTENTINSTANCE, fields));
+}
+
+
+void fieldsCallback(const OneM2M::ResourceFields &fields) {
+	notifiedFields++;
+	lastFields = fields;
+}
+
+
+void resourceCallback(String, OneM2M::ResourceType type, String resource) {
+	notifiedResources++;
+	lastResource = resource;
+	lastType = type;
+}
+
+
+// Send a notification to the notification server and return the status
+// code of the answer. *serverPeak* receives the increase of the heap peak
+// while the server handled the notification.
+static int notify(const uint8_t *body, size_t length, String type, size_t *serverPeak = NULL) {
+	WiFiClient client;
+	if ( ! client.connect("127.0.0.1", NOTIFICATION_PORT)) {
+		return 0;
+	}
+	client.print("POST /notify HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Type: " + type + "\r\nContent-Length: " +
+				 String((unsigned long)length) + "\r\n\r\n");
+	client.write(body, length);
+	String answer;
+	unsigned long start = millis();
+	size_t peak = 0;
+	while ((client.connected() || client.available()) && millis() - start < 2000) {
+		size_t used = hostHeapUsed();
+		hostHeapResetPeak();
+		OneM2M::checkNotifications();
+		peak = hostHeapPeak() - used > peak ? hostHeapPeak() - used : peak;
+		while (client.available()) {
+			answer += (char)client.read();
+		}
+	}
+	client.stop();
+	if (serverPeak != NULL) {
+		*serverPeak = peak;
+	}
+	return answer.startsWith("HTTP/1.1 ") ? answer.substring(9, 12).toInt() : 0;
+}
+
+
+static int notify(String body, size_t *serverPeak = NULL) {
+	return notify((const uint8_t *)body.c_str(), body.length(), "application/json", serverPeak);
+}
+
+
+// Append a CBOR text string
+static void cborText(uint8_t *buffer, size_t &length, const char *text) {
+	size_t n = strlen(text);
+	buffer[length++] = 0x78;	// text string with a 1 byte length
+	buffer[length++] = n;
+	memcpy(buffer + length, text, n);
+	length += n;
+}
+
+
+// The rep attribute of a CBOR notification is converted to JSON for a
+// NotificationCallback, in a buffer of its exact size. Compared to the same
+// notification in JSON only this buffer is added to the heap peak.
+static void testCborNotification(void) {
+	uint8_t body[ONEM2M_CBOR_BUFFER_SIZE];
+	size_t 	length = 0;
+	String 	content;
+	for (int i = 0; i < 100; i++) {
+		content += i % 10 == 0 ? '"' : (char)('a' + i % 26);		// escaped in JSON
+	}
+
+	body[length++] = 0xa1;		// {"m2m:sgn":{"sur":"sub2","nev":{"rep":<cin>}}}
+	cborText(body, length, "m2m:sgn");
+	body[length++] = 0xa2;
+	cborText(body, length, "sur");
+	cborText(body, length, "sub2");
+	cborText(body, length, "nev");
+	body[length++] = 0xa1;
+	cborText(body, length, "rep");
+	size_t repLength = OneM2M::encodeContentInstance(OneM2M::CBOR, content, "text/plain:0", body + length, sizeof(body) - length);
+	CHECK(repLength > 0);
+	length += repLength;
+
+	String escaped = content;
+	escaped.replace("\"", "\\\"");
+	String json = "{\"m2m:cin\":{\"cnf\":\"text/plain:0\",\"con\":\"" + escaped + "\"}}";
+
+	int 	notified = notifiedResources;
+	size_t 	jsonPeak, cborPeak;
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"sur\":\"sub2\",\"nev\":{\"rep\":" + json + "}}}", &jsonPeak), 200);
+	CHECK_EQUAL(lastResource, json);
+	CHECK_EQUAL(notify(body, length, "application/cbor", &cborPeak), 200);
+	CHECK_EQUAL(notifiedResources, notified + 2);
+	CHECK_EQUAL(lastResource, json);
+	CHECK(cborPeak < jsonPeak + json.length() + 64);
+}
+
+
+static void testNotifications(void) {
+	String rep = "{\"m2m:cin\":{\"ri\":\"cin9\",\"ty\":4,\"con\":\"4\\u0032\"}}";
+
+	OneM2M::setupNotifications("127.0.0.1", NOTIFICATION_PORT, "/notify");
+	OneM2M::addNotificationFieldsCallback("sub1", fieldsCallback);
+	OneM2M::addNotificationCallback("sub2", resourceCallback);
+
+	// verification requests are answered without calling the callback
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"vrq\":true,\"sur\":\"sub1\"}}"), 200);
+	CHECK_EQUAL(notify("{\"sgn\":{\"vrq\":true}}"), 200);
+	CHECK_EQUAL(notifiedFields, 0);
+
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"nev\":{\"rep\":" + rep + ",\"net\":3},\"sur\":\"sub1\"}}"), 200);
+	CHECK_EQUAL(notifiedFields, 1);
+	CHECK_EQUAL(lastFields.resourceIdentifier, "cin9");
+	CHECK_EQUAL(lastFields.type, 4);
+	CHECK_EQUAL(lastFields.content, "42");
+	CHECK_EQUAL(lastFields.subscriptionReference, "sub1");
+	CHECK( ! lastFields.verificationRequest);
+
+	// the original text of the rep attribute is passed to a NotificationCallback
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"sur\":\"sub2\",\"nev\":{\"net\":3,\"rep\": " + rep + "}}}"), 200);
+	CHECK_EQUAL(notifiedResources, 1);
+	CHECK_EQUAL(lastResource, rep);
+	CHECK_EQUAL(lastType, 4);
+
+	// malformed notifications and other resources are rejected
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"nev\":{\"rep\":" + rep + "},\"sur\":\"sub1\",}}"), 400);
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"nev\":{\"rep\":{\"m2m:cin\":{\"ty\":4.5}}},\"sur\":\"sub1\"}}"), 400);
+	CHECK_EQUAL(notify("{\"m2m:sgn\":{\"sur\":\"sub1\"}}"), 400);
+	CHECK_EQUAL(notify("{\"m2m:cin\":{\"con\":\"x\"}}"), 400);
+	CHECK_EQUAL(notifiedFields, 1);
+	CHECK_EQUAL(notifiedResources, 1);
+
+	testCborNotification();
+	OneM2M::shutdownNotifications();
+}
+
+
+int main() {
+	server = new WiFiServer(SERVER_PORT);
+	server->begin();
+	hostSetBackgroundTask(serveResponse);
+	OneM2M cse("127.0.0.1", SERVER_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+
+	testEscapes();
+	testNestedContent();
+	testOverflow();
+	testMalformed();
+	testSplitReads(cse);
+	testNotifications();
+
+	hostSetBackgroundTask(NULL);
+	serverClient.stop();
+	delete server;
+	return testResult("ScannerTest");
+}
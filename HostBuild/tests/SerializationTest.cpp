@@ -0,0 +1,135 @@
+/*
+ *	SerializationTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the JSON and CBOR serialization of the OneM2M client: encoded
+ *	ContentInstances are decoded to the same attributes, requests with CBOR
+ *	bodies and responses are round-tripped through the mock CSE, and the
+ *	buffer for CBOR bodies only exists while CBOR serialization is selected.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../RingBuffer/Ringbuffer.ino"
+# include "../../EEPROMStore/EEPROMStore.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "../../oneM2M/oneM2M.ino"
+# include "../MockCSE.ino"
+# include "Test.h"
+
+# define TEST_PORT		18198
+# define CONTAINER_PATH	"/cse/testAE/container"
+
+static String 	contents[] = { "", "22.5", "quote \" backslash \\ slash /", "\xc3\xbc \xe2\x82\xac", "" };
+static int 		completedRequests = 0;
+static int 		lastStatusCode = -1;
+
+
+void completionCallback(long, int statusCode, String) {
+	completedRequests++;
+	lastStatusCode = statusCode;
+}
+
+
+// Encode and decode a ContentInstance
+static void checkRoundTrip(OneM2M::Serialization serialization, String content) {
+	uint8_t 				buffer[ONEM2M_CBOR_BUFFER_SIZE];
+	OneM2M::ResourceFields 	fields;
+
+	size_t length = OneM2M::encodeContentInstance(serialization, content, "text/plain:0", buffer, sizeof(buffer));
+	CHECK(length > 0);
+	CHECK(OneM2M::decodeResource(serialization, buffer, length, fields));
+	CHECK_EQUAL(String(fields.content), content);
+	CHECK_EQUAL(String(fields.contentFormat), "text/plain:0");
+	CHECK( ! fields.truncated);
+}
+
+
+static void testEncodeDecode(void) {
+	for (int i = 0; i < 200; i++) {		// the last content is long
+		contents[4] += (char)('a' + i % 26);
+	}
+	for (unsigned int i = 0; i < sizeof(contents) / sizeof(contents[0]); i++) {
+		checkRoundTrip(OneM2M::JSON, contents[i]);
+		checkRoundTrip(OneM2M::CBOR, contents[i]);
+	}
+
+	// CBOR is more compact, and nothing is written to a buffer that is too small
+	uint8_t 				json[ONEM2M_CBOR_BUFFER_SIZE], cbor[ONEM2M_CBOR_BUFFER_SIZE];
+	OneM2M::ResourceFields 	fields;
+	size_t jsonLength = OneM2M::encodeContentInstance(OneM2M::JSON, contents[4], "text/plain:0", json, sizeof(json));
+	size_t cborLength = OneM2M::encodeContentInstance(OneM2M::CBOR, contents[4], "text/plain:0", cbor, sizeof(cbor));
+	CHECK(cborLength < jsonLength);
+	CHECK_EQUAL(OneM2M::encodeContentInstance(OneM2M::JSON, contents[4], "text/plain:0", json, jsonLength), 0);
+	CHECK_EQUAL(OneM2M::encodeContentInstance(OneM2M::CBOR, contents[4], "text/plain:0", cbor, cborLength - 1), 0);
+	CHECK( ! OneM2M::decodeResource(OneM2M::CBOR, cbor, cborLength - 1, fields));
+}
+
+
+// The buffer for CBOR bodies is allocated when CBOR is selected, and
+// released again for JSON
+static void testBuffer(OneM2M &cse) {
+	size_t used = hostHeapUsed();
+	cse.setSerialization(OneM2M::CBOR);
+	CHECK(hostHeapUsed() >= used + ONEM2M_CBOR_BUFFER_SIZE);
+	cse.setSerialization(OneM2M::CBOR);
+	CHECK(hostHeapUsed() < used + 2 * ONEM2M_CBOR_BUFFER_SIZE);
+	cse.setSerialization(OneM2M::JSON);
+	CHECK(hostHeapUsed() == used);
+}
+
+
+// Resources are created with CBOR bodies, and contents are retrieved from
+// CBOR responses
+static void testCborRequests(OneM2M &cse, MockCSE &mockCSE) {
+	unsigned long cborRequests = mockCSE.statistics().cborRequests;
+
+	cse.setSerialization(OneM2M::CBOR);
+	CHECK(cse.getAE("/cse/testAE", "test").length() > 0);
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	for (unsigned int i = 0; i < sizeof(contents) / sizeof(contents[0]); i++) {
+		CHECK(cse.addContentInstance(CONTAINER_PATH, contents[i]).length() > 0);
+		CHECK_EQUAL(cse.getLatestContentInstance(CONTAINER_PATH).content, contents[i]);
+	}
+
+	// a ContentInstance created asynchronously, after the buffer was reused
+	cse.createResourceAsync(CONTAINER_PATH, OneM2M::ResourceType::CONTENTINSTANCE, "{\"m2m:cin\":{\"con\":\"async\"}}", completionCallback);
+	CHECK(cse.addContentInstance(CONTAINER_PATH, "sync").length() > 0);
+	unsigned long start = millis();
+	while (cse.pendingRequests() > 0 && millis() - start < 2000) {
+		cse.poll();
+		yield();
+	}
+	CHECK_EQUAL(completedRequests, 1);
+	CHECK_EQUAL(lastStatusCode, 201);
+	CHECK_EQUAL(cse.getLatestContentInstance(CONTAINER_PATH).content, "async");
+
+	// a resource that doesn't fit into the buffer is not sent
+	String content;
+	for (int i = 0; i < ONEM2M_CBOR_BUFFER_SIZE; i++) {
+		content += 'x';
+	}
+	unsigned long requests = mockCSE.statistics().requests;
+	CHECK_EQUAL(cse.addContentInstance(CONTAINER_PATH, content), "");
+	CHECK_EQUAL(mockCSE.statistics().requests, requests);
+	CHECK(mockCSE.statistics().cborRequests >= cborRequests + 2 * (sizeof(contents) / sizeof(contents[0])) + 1);
+
+	// the same resources with JSON
+	cse.setSerialization(OneM2M::JSON);
+	CHECK(cse.addContentInstance(CONTAINER_PATH, content).length() > 0);
+	CHECK_EQUAL(cse.getLatestContentInstance(CONTAINER_PATH).content, content.substring(0, ONEM2M_CONTENT_SIZE - 1));
+}
+
+
+int main() {
+	MockCSE 	mockCSE(TEST_PORT);
+	OneM2M 		cse("127.0.0.1", TEST_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+
+	testEncodeDecode();
+	testBuffer(cse);
+	testCborRequests(cse, mockCSE);
+	return testResult("SerializationTest");
+}
@@ -0,0 +1,50 @@
+/*
+ *	Test.h
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Minimal checks for the host tests. A failed check prints its location
+ *	and the values, and the test program exits with a non-zero status.
+ */
+
+# ifndef __HOST_TEST_H__
+# define __HOST_TEST_H__
+
+# include "Arduino.h"
+
+# define CHECK(condition)				_testCheck((condition), #condition, __FILE__, __LINE__)
+# define CHECK_EQUAL(actual, expected)	_testCheckEqual(String(actual), String(expected), #actual, __FILE__, __LINE__)
+
+static int 	_testChecks = 0;
+static int 	_testFailures = 0;
+
+
+static bool _testCheck(bool ok, const char *text, const char *file, int line) {
+	_testChecks++;
+	if ( ! ok) {
+		_testFailures++;
+		printf("%s:%d: check failed: %s\n", file, line, text);
+	}
+	return ok;
+}
+
+
+static bool _testCheckEqual(const String &actual, const String &expected, const char *text, const char *file, int line) {
+	_testChecks++;
+	if (actual != expected) {
+		_testFailures++;
+		printf("%s:%d: check failed: %s is \"%s\", expected \"%s\"\n", file, line, text, actual.c_str(), expected.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// Print a summary and return the exit status of the test program
+static int testResult(const char *name) {
+	printf("%s: %d checks, %d failed\n", name, _testChecks, _testFailures);
+	return _testFailures > 0 ? 1 : 0;
+}
+
+# endif
@@ -0,0 +1,209 @@
+/*
+ *	UploadQueueTest.cpp
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Checks the upload queues of the OneM2M client against the mock CSE:
+ *	the flush thresholds, the policies for full queues, partial batches when
+ *	the CSE stops in the middle of a batch, temporary and permanent errors
+ *	of the CSE, and draining the queue when the CSE is back.
+ */
+
+# include "Arduino.h"
+# include "../../LinkedList/LinkedList.ino"
+# include "../../RingBuffer/Ringbuffer.ino"
+# include "../../EEPROMStore/EEPROMStore.ino"
+# include "../../HttpServer/HttpServer.ino"
+# include "../../oneM2M/oneM2M.ino"
+# include "../MockCSE.ino"
+# include "Test.h"
+
+# define TEST_PORT		18193
+# define CONTAINER_PATH	"/cse/testAE/container"
+
+
+static String latestContent(OneM2M &cse) {
+	return String(cse.getLatestContentInstance(CONTAINER_PATH).content);
+}
+
+
+// Contents are uploaded when the queue reaches its flush size, or when the
+// flush is forced
+static void testQueueing(OneM2M &cse, MockCSE &mockCSE) {
+	unsigned long creates = mockCSE.statistics().creates;
+
+	CHECK(cse.addUploadQueue(CONTAINER_PATH, 8, 4, 0));
+	CHECK( ! cse.addUploadQueue(CONTAINER_PATH, 8, 4, 0));
+	CHECK( ! cse.queueContentInstance("/cse/testAE/unknown", "0"));
+	for (int i = 0; i < 3; i++) {
+		CHECK(cse.queueContentInstance(CONTAINER_PATH, String(i)));
+	}
+	CHECK_EQUAL(cse.flushUploadQueues(), 0);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 3);
+	CHECK(cse.queueContentInstance(CONTAINER_PATH, "3"));
+	CHECK_EQUAL(cse.flushUploadQueues(), 4);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 0);
+	CHECK_EQUAL(mockCSE.statistics().creates, creates + 4);
+	CHECK_EQUAL(latestContent(cse), "3");
+
+	CHECK(cse.queueContentInstance(CONTAINER_PATH, "4"));
+	CHECK_EQUAL(cse.flushUploadQueues(true), 1);
+	CHECK_EQUAL(latestContent(cse), "4");
+	CHECK(cse.removeUploadQueue(CONTAINER_PATH));
+	CHECK( ! cse.removeUploadQueue(CONTAINER_PATH));
+}
+
+
+// A full queue overwrites the oldest contents while the CSE is not reachable
+static void testDropOldest(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::UploadStatistics statistics = cse.uploadStatistics();
+
+	cse.addUploadQueue(CONTAINER_PATH, 4, 4, 0, OneM2M::DROP_OLDEST);
+	mockCSE.stop();
+	for (int i = 0; i < 6; i++) {
+		CHECK(cse.queueContentInstance(CONTAINER_PATH, "oldest" + String(i)));
+		cse.flushUploadQueues();
+	}
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 4);
+	CHECK_EQUAL(cse.uploadStatistics().dropped, statistics.dropped + 2);
+	CHECK_EQUAL(cse.uploadStatistics().uploaded, statistics.uploaded);
+
+	mockCSE.start();
+	CHECK_EQUAL(cse.flushUploadQueues(), 4);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 0);
+	CHECK_EQUAL(latestContent(cse), "oldest5");
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+// A full queue rejects new contents while the CSE is not reachable
+static void testDropNewest(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::UploadStatistics statistics = cse.uploadStatistics();
+
+	cse.addUploadQueue(CONTAINER_PATH, 4, 4, 0, OneM2M::DROP_NEWEST);
+	mockCSE.stop();
+	for (int i = 0; i < 6; i++) {
+		CHECK_EQUAL(cse.queueContentInstance(CONTAINER_PATH, "newest" + String(i)), i < 4);
+		cse.flushUploadQueues();
+	}
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 4);
+	CHECK_EQUAL(cse.uploadStatistics().dropped, statistics.dropped + 2);
+
+	mockCSE.start();
+	CHECK_EQUAL(cse.flushUploadQueues(), 4);
+	CHECK_EQUAL(latestContent(cse), "newest3");
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+// Only the answered contents of a batch are removed when the CSE stops in
+// the middle of the batch. The others are uploaded when the CSE is back.
+static void testPartialBatch(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::UploadStatistics statistics = cse.uploadStatistics();
+
+	cse.addUploadQueue(CONTAINER_PATH, 2 * ONEM2M_PIPELINE_DEPTH, 2 * ONEM2M_PIPELINE_DEPTH, 0);
+	for (int i = 0; i < ONEM2M_PIPELINE_DEPTH; i++) {
+		cse.queueContentInstance(CONTAINER_PATH, "partial" + String(i));
+	}
+	mockCSE.stopAfter(2);
+	CHECK_EQUAL(cse.flushUploadQueues(true), 2);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), ONEM2M_PIPELINE_DEPTH - 2);
+	CHECK_EQUAL(latestContent(cse), "");		// the CSE is stopped
+	CHECK_EQUAL(cse.flushUploadQueues(true), 0);
+
+	mockCSE.start();
+	CHECK_EQUAL(latestContent(cse), "partial1");
+	CHECK_EQUAL(cse.flushUploadQueues(true), ONEM2M_PIPELINE_DEPTH - 2);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 0);
+	CHECK_EQUAL(latestContent(cse), "partial" + String(ONEM2M_PIPELINE_DEPTH - 1));
+	CHECK_EQUAL(cse.uploadStatistics().uploaded, statistics.uploaded + ONEM2M_PIPELINE_DEPTH);
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+// Contents that are answered with a temporary error stay in the queue and
+// are uploaded with the next flush
+static void testTemporaryError(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::UploadStatistics statistics = cse.uploadStatistics();
+
+	cse.addUploadQueue(CONTAINER_PATH, 8, 8, 0);
+	for (int i = 0; i < 4; i++) {
+		cse.queueContentInstance(CONTAINER_PATH, "temporary" + String(i));
+	}
+	mockCSE.failRequests(1, 503);
+	CHECK_EQUAL(cse.flushUploadQueues(true), 0);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 4);
+	CHECK_EQUAL(cse.uploadStatistics().deferred, statistics.deferred + 1);
+	CHECK_EQUAL(cse.uploadStatistics().rejected, statistics.rejected);
+
+	mockCSE.failRequests(1, 429);
+	CHECK_EQUAL(cse.flushUploadQueues(true), 0);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 4);
+
+	CHECK_EQUAL(cse.flushUploadQueues(true), 4);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 0);
+	CHECK_EQUAL(latestContent(cse), "temporary3");
+	CHECK_EQUAL(cse.uploadStatistics().rejected, statistics.rejected);
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+// A content that is answered with a permanent error is removed from the
+// queue, and the following contents are uploaded
+static void testPermanentError(OneM2M &cse, MockCSE &mockCSE) {
+	OneM2M::UploadStatistics statistics = cse.uploadStatistics();
+
+	cse.addUploadQueue(CONTAINER_PATH, 8, 8, 0);
+	for (int i = 0; i < 4; i++) {
+		cse.queueContentInstance(CONTAINER_PATH, "permanent" + String(i));
+	}
+	mockCSE.failRequests(1, 400);
+	CHECK_EQUAL(cse.flushUploadQueues(true), 3);
+	CHECK_EQUAL(cse.queuedContentInstances(CONTAINER_PATH), 0);
+	CHECK_EQUAL(cse.uploadStatistics().rejected, statistics.rejected + 1);
+	CHECK_EQUAL(cse.uploadStatistics().deferred, statistics.deferred);
+	CHECK_EQUAL(latestContent(cse), "permanent3");
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+// Contents that were uploaded don't keep their memory in the queue
+static void testDrainReleasesMemory(OneM2M &cse, MockCSE &mockCSE) {
+	String content;
+	for (int i = 0; i < 1000; i++) {
+		content += 'x';
+	}
+	cse.addUploadQueue(CONTAINER_PATH, 8, 8, 0);
+	cse.queueContentInstance(CONTAINER_PATH, "first");
+	cse.flushUploadQueues(true);	// open the connection before measuring
+
+	size_t used = hostHeapUsed();
+	mockCSE.stop();
+	for (int i = 0; i < 8; i++) {
+		cse.queueContentInstance(CONTAINER_PATH, content);
+	}
+	CHECK(hostHeapUsed() > used + 7 * content.length());
+	mockCSE.start();
+	CHECK_EQUAL(cse.flushUploadQueues(true), 8);
+	CHECK(hostHeapUsed() < used + content.length());
+	cse.removeUploadQueue(CONTAINER_PATH);
+}
+
+
+int main() {
+	MockCSE 	mockCSE(TEST_PORT);
+	OneM2M 		cse("127.0.0.1", TEST_PORT, "/", "CTest");
+	cse.setTimeout(2000);
+
+	CHECK(cse.getAE("/cse/testAE", "test").length() > 0);
+	CHECK(cse.getContainer(CONTAINER_PATH).length() > 0);
+	testQueueing(cse, mockCSE);
+	testDropOldest(cse, mockCSE);
+	testDropNewest(cse, mockCSE);
+	testPartialBatch(cse, mockCSE);
+	testTemporaryError(cse, mockCSE);
+	testPermanentError(cse, mockCSE);
+	testDrainReleasesMemory(cse, mockCSE);
+	return testResult("UploadQueueTest");
+}
@@ -18,6 +18,33 @@
 #endif
 # include "LinkedList.h"
 
+// Define HEAP_ACCOUNTING to attribute the allocations of handlers and
+// requests to HEAP_HTTPSERVER.
+# include "HeapScope.h"
+
+// Size of the buffer that is used to stream static assets from flash memory.
+# ifndef HTTPSERVER_ASSET_CHUNK_SIZE
+# define HTTPSERVER_ASSET_CHUNK_SIZE	256
+# endif
+
+// Default time in milliseconds to wait for a client to send a complete request.
+# ifndef HTTPSERVER_TIMEOUT
+# define HTTPSERVER_TIMEOUT				5000
+# endif
+
+// Define HTTPSERVER_METRICS before including this file to enable the
+// collection of request metrics. Without it all instrumentation is
+// compiled out.
+// # define HTTPSERVER_METRICS
+# ifdef HTTPSERVER_METRICS
+# define HTTPSERVER_METRIC(...)			__VA_ARGS__
+# else
+# define HTTPSERVER_METRIC(...)
+# endif
+
+// Number of buckets of a latency histogram. The last bucket counts all
+// values above the largest bound.
+# define HTTPSERVER_HISTOGRAM_BUCKETS	10
 
 class HttpServer {
 public:
@@ -33,6 +60,7 @@ public:
 		String attributes;
 		String type;
 		String content;
+		const String *sharedContent = NULL;		// content that is sent without copying it, instead of *content*
 	};
 
 	// Struct that holds a key/value pair of a request or form request arguments
@@ -44,6 +72,39 @@ public:
 	// typedef for request handlers
 	typedef RequestResult (*RequestHandler)(String path, Method method, long length, String type, char *content);
 
+# ifdef HTTPSERVER_METRICS
+	// Struct that holds a latency histogram. Values are in microseconds.
+	struct Histogram {
+		unsigned long buckets[HTTPSERVER_HISTOGRAM_BUCKETS];
+		unsigned long count;
+		unsigned long sum;
+	};
+
+	// Struct that holds the metrics of a single handler or static asset.
+	struct RouteMetrics {
+		unsigned long requests;
+		unsigned long errors;					// answers with a status code >= 400
+		unsigned long bytesOut;
+		Histogram handlerTime;
+	};
+
+	// Struct that holds the metrics of a server.
+	struct Metrics {
+		unsigned long requests;
+		unsigned long requestsByMethod[ALL + 1];	// indexed by *Method*
+		unsigned long responsesByStatus[6];		// indexed by status code / 100
+		unsigned long defaultHandlerRequests;		// requests handled by the default request handler
+		unsigned long notImplemented;				// requests answered with 501
+		unsigned long timeouts;					// requests that were not completed in time
+		unsigned long bytesIn;
+		unsigned long bytesOut;
+		unsigned long peakBodySize;
+		Histogram parseTime;
+		Histogram handlerTime;
+		Histogram sendTime;
+	};
+# endif
+
 
 private:
 
@@ -52,19 +113,54 @@ private:
 		String 				path;
 		Method 				method;
 		RequestHandler		handler;
+		HTTPSERVER_METRIC(RouteMetrics metrics;)
+	};
+
+	// internal struct for keeping static assets
+	struct StaticAsset {
+		String 				path;
+		String 				type;
+		const uint8_t		*data;			// pointer to the data in flash memory
+		size_t 				length;
+		bool				gzipped;
+		unsigned long 		maxAge;
+		String 				etag;
+		const uint8_t		*identityData;	// optional uncompressed copy of gzipped data in flash memory
+		size_t 				identityLength;
+		String 				identityEtag;
+		HTTPSERVER_METRIC(RouteMetrics metrics;)
 	};
 
 	WiFiServer	 			*server;
 	RequestHandler			 defaultRequestHandler;
 	LinkedList<Handler *>	 handlers;
+	LinkedList<StaticAsset *> assets;
+	unsigned long			 requestTimeout;
+# ifdef HTTPSERVER_METRICS
+	Metrics 				 metrics;
+	String 					 metricsPath;
+# endif
 	
 	static int 				 requestArgumentsCount;				// number of current request arguments
 	static RequestArgument 	*requestArguments;					// array of current request arguments
 
 	void 			initServer(int port);						// init the WifiServer
+	RequestResult 	callHandler(RequestHandler rh, const String &path, Method method, long contentLength, const String &contentType, char *body);	// call a request handler
 	Method 			getMethod(String v);						// get the HTTP method from a string
 	Handler*		findHandler(String path, Method method); 	// find the handler for a request
 	String 			getResultMessage(int code);					// get the message for a http result code
+	StaticAsset*	findAsset(String path);						// find the static asset for a request
+	int 			sendAsset(WiFiClient &client, StaticAsset *asset, Method method, String ifNoneMatch, String acceptEncoding, bool hasAcceptEncoding, size_t &sent);	// send a static asset
+	static String 	calculateETag(const uint8_t *data, size_t length);	// calculate an entity tag for flash data
+# ifdef HTTPSERVER_METRICS
+	static void 	recordHistogram(Histogram &histogram, unsigned long value);		// add a value to a histogram
+	size_t 			writeMetrics(String *out);					// write or count the Prometheus text
+	String 			routeLabels(int index, const RouteMetrics *&rm);	// labels and metrics of a handler or static asset
+	static String 	escapeLabel(const String &value);			// escape a Prometheus label value
+	static void 	writeFamily(String *out, size_t &length, const char *name, const char *type, const char *help);	// HELP and TYPE lines
+	static void 	writeSample(String *out, size_t &length, const String &line);	// write or count a line
+	static void 	writeHistogram(String *out, size_t &length, const char *name, String labels, const Histogram &histogram);	// add a histogram in Prometheus format
+# endif
 
 
 public:
@@ -93,6 +189,11 @@ public:
 	//	appropriate handler function) and sending the answer back to the client.
 	void check();
 
+	//	Set the time a client has to send a complete request. When the time
+	//	is exceeded then the request is answered with *408 Request Timeout*.
+	//	*timeout* is the time in milliseconds. The default is 5000 ms.
+	void setTimeout(unsigned long timeout);
+
 	//	Add a new request handler function.
 	//	*path* is the matching request path.
 	//	*method* is the matching request method (see enum *Method* below).
@@ -115,6 +216,56 @@ public:
 	//	*method* is a matching request method (see enum *Method* below).
 	bool hasHandler(String path, Method method);
 
+	//	Add a static asset that is served directly from flash memory for
+	//	GET and HEAD requests. The data is streamed in small chunks and is
+	//	never copied into RAM as a whole. An entity tag is calculated once,
+	//	and requests with a matching *If-None-Match* header are answered
+	//	with *304 Not Modified*.
+	//	*path* is the matching request path.
+	//	*type* is the MIME content-type of the asset.
+	//	*data* is a pointer to the asset's bytes in flash memory (PROGMEM).
+	//	*length* is the number of bytes of the asset.
+	//	*gzipped* indicates that *data* is gzip compressed. The answer then
+	//	has the *Content-Encoding: gzip* header. Clients that don't accept
+	//	gzip encoding get the uncompressed *identityData*, or a *406 Not 
+	//	Acceptable* answer if there is none. Clients without an 
+	//	*Accept-Encoding* header accept every encoding. They get the 
+	//	*identityData* if there is one, and the gzipped *data* otherwise.
+	//	*maxAge* is the number of seconds a client may cache the asset without
+	//	revalidation. 0 means that the client must always revalidate.
+	//	*identityData* and *identityLength* are an optional uncompressed copy
+	//	of a gzipped asset in flash memory.
+	//	An existing asset with the same *path* is replaced.
+	void addStaticAsset(String path, String type, const uint8_t *data, size_t length, bool gzipped = false, unsigned long maxAge = 0, 
+						const uint8_t *identityData = NULL, size_t identityLength = 0);
+
+	//	Remove a previously added static asset.
+	//	*path* is the matching request path.
+	void removeStaticAsset(String path);
+
+# ifdef HTTPSERVER_METRICS
+	//	Return the server's global request metrics. Only available when
+	//	*HTTPSERVER_METRICS* is defined.
+	const Metrics &getMetrics();
+
+	//	Return the request metrics of a handler. NULL is returned if no handler
+	//	is defined for *path* and *method*.
+	const RouteMetrics *getRouteMetrics(String path, Method method);
+
+	//	Reset the global and all handler and static asset metrics.
+	void resetMetrics();
+
+	//	Serve all metrics in the Prometheus text format. GET requests for
+	//	*path* are answered by the server itself.
+	//	*path* is the request path, by default */metrics*.
+	void enableMetricsHandler(String path = "/metrics");
+
+	//	Return all metrics in the Prometheus text format. Each metric family
+	//	is written at once with its HELP and TYPE lines, and the String is
+	//	allocated once with the exact size.
+	String metricsText();
+# endif
+
 	//	Parse a request path for arguments. Found arguments are stored them for
 	//	later retrieval and processing. Only one set of arguments can be stored 
 	//	at a time for all instances of the HTTPServer class. The names and 
@@ -131,6 +282,14 @@ public:
 	//	*value* the String to decode.
 	static String urlDecode(String value);
 
+	//	Check whether the value of an *Accept-Encoding* header accepts an
+	//	encoding. Quality values are respected, e.g. "gzip;q=0" doesn't
+	//	accept gzip. "identity" is accepted unless it is excluded, e.g. by
+	//	"identity;q=0" or "*;q=0".
+	//	*value* the header value.
+	//	*encoding* the encoding in lower case, e.g. "gzip".
+	static bool acceptsEncoding(String value, String encoding);
+
 
 };
 
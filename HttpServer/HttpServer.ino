@@ -35,13 +35,20 @@ HttpServer::HttpServer(int port, RequestHandler defaultRequestHandler) {
 
 
 HttpServer::~HttpServer() {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
 	if (server) {
 		server->stop();
+		delete server;
 		server = NULL;
 	}
 	while (handlers.size() > 0) {
+		delete handlers.get(0);
 		handlers.remove(0);
 	}
+	while (assets.size() > 0) {
+		delete assets.get(0);
+		assets.remove(0);
+	}
 }
 
 
@@ -51,7 +58,9 @@ void HttpServer::check() {
 	}
 	WiFiClient client = server->available();
 	if (client) {	// has connection
+		HEAP_SCOPE(HEAP_HTTPSERVER);	// only with a request, check() is called very often
 		// Serial.println("New Client connected.");
+		HTTPSERVER_METRIC(unsigned long timestamp = micros();)
 
 		String 			currentLine = "";
 		String 			responseHeader = "";
@@ -59,13 +68,19 @@ void HttpServer::check() {
 		unsigned long 	contentLength = 0;
 		unsigned long 	currentLength = 0;
 		String 			contentType = "";
+		String 			ifNoneMatch = "";
+		String 			acceptEncoding = "";
+		bool 			hasAcceptEncoding = false;
 		Method 			method = NONE;
 		String 			path;
 		char 			*body = NULL;
+		unsigned long 	startMs = millis();
+		bool 			timedOut = false;
 
 		while(client.connected()) {
 			if (client.available()) { 
 				char c = client.read();
+				HTTPSERVER_METRIC(metrics.bytesIn++;)
 				// Serial.print(c);
 				if (headerFinished) {
 					body[currentLength++] = c;
@@ -105,6 +120,14 @@ void HttpServer::check() {
 							} else if (currentLine.startsWith("Content-Type:")) {
 								contentType = currentLine.substring(13);
 								contentType.trim();
+
+							// look for conditional and encoding headers for static assets
+							} else if (currentLine.startsWith("If-None-Match:")) {
+								ifNoneMatch = currentLine.substring(14);
+								ifNoneMatch.trim();
+							} else if (currentLine.startsWith("Accept-Encoding:")) {
+								acceptEncoding = currentLine.substring(16);
+								hasAcceptEncoding = true;
 							}
 							currentLine = "";
 						}
@@ -112,33 +135,115 @@ void HttpServer::check() {
 						currentLine += c;
 					}
 				}
+			} else if (millis() - startMs > requestTimeout) {
+				timedOut = true;
+				break;
 			}
 		}
 
+		if (timedOut) {
+			HTTPSERVER_METRIC(metrics.timeouts++;)
+			client.println("HTTP/1.1 408 Request Timeout");
+			if (body) {
+				free(body);
+			}
+			client.stop();
+			return;
+		}
+
+# ifdef HTTPSERVER_METRICS
+		metrics.requests++;
+		metrics.requestsByMethod[method]++;
+		if (contentLength > metrics.peakBodySize) {
+			metrics.peakBodySize = contentLength;
+		}
+		recordHistogram(metrics.parseTime, micros() - timestamp);
+		timestamp = micros();
+		RouteMetrics 	*route = NULL;
+		unsigned long 	handlerTime = 0;
+		bool 			isMetricsRequest = metricsPath.length() > 0 && method == GET && 
+										   (path == metricsPath || path.startsWith(metricsPath + "?"));
+		int 			returnCode = 501;
+# endif
+		size_t 			sent = 0;
+
 		// call the handler and return the result
 		Handler *handler = findHandler(path, method); // do we have a request handler for that path and method?
 
+		// or a static asset for that path?
+		StaticAsset *asset = (handler == NULL && (method == GET || method == HEAD)) ? findAsset(path) : NULL;
+
 		RequestHandler rh = handler != NULL ? handler->handler : defaultRequestHandler; // otherwise assign the provided one
-		if (rh) {
-			RequestResult result = (*rh)(path, method, contentLength, contentType, body);
-			String answer = "HTTP/1.1 "  + String(result.returnCode) + " " + getResultMessage(result.returnCode);
+		HTTPSERVER_METRIC(if (isMetricsRequest) { rh = NULL; asset = NULL; })
+		if (asset) {
+			HTTPSERVER_METRIC(returnCode =) sendAsset(client, asset, method, ifNoneMatch, acceptEncoding, hasAcceptEncoding, sent);
+			HTTPSERVER_METRIC(route = &asset->metrics; handlerTime = micros() - timestamp;)	// time to serve the asset
+		} else if (rh HTTPSERVER_METRIC(|| isMetricsRequest)) {
+			RequestResult result;
+# ifdef HTTPSERVER_METRICS
+			if (isMetricsRequest) {
+				result.returnCode = 200;
+				result.type = "text/plain; version=0.0.4";
+				result.content = metricsText();
+			} else {
+				result = callHandler(rh, path, method, contentLength, contentType, body);
+				if (handler != NULL) {
+					route = &handler->metrics;
+				} else {
+					metrics.defaultHandlerRequests++;
+				}
+			}
+			handlerTime = micros() - timestamp;
+			recordHistogram(metrics.handlerTime, handlerTime);
+			timestamp = micros();
+# else
+			result = callHandler(rh, path, method, contentLength, contentType, body);
+# endif
+			HTTPSERVER_METRIC(returnCode = result.returnCode;)
+			const String &content = result.sharedContent != NULL ? *result.sharedContent : result.content;
+			String answer;
+			answer.reserve(64 + result.type.length() + result.attributes.length() + 
+						   (result.sharedContent == NULL ? content.length() : 0));	// allocate only once
+			answer += "HTTP/1.1 "  + String(result.returnCode) + " " + getResultMessage(result.returnCode);
 			if (result.type.length() > 0) {
 				answer += "\nContent-Type: " + result.type;
 			}
 			if (result.attributes.length() > 0) {
 				answer += "\n" + result.attributes;
 			}
-			if (result.content.length() > 0) {
+			if (content.length() > 0) {
 				answer += "\nContent-Length: ";
-				answer += result.content.length();
+				answer += content.length();
 				answer += "\r\n\r\n";
-				answer += result.content;
+				if (result.sharedContent == NULL) {
+					answer += content;
+				}
+			}
+			sent = client.print(answer);
+			if (result.sharedContent != NULL && content.length() > 0) {
+				sent += client.print(content);	// the shared content is not copied into the answer
 			}
-			client.print(answer);
 		} else {
-			client.println("HTTP/1.1 501 Not Implemented");
+			HTTPSERVER_METRIC(metrics.notImplemented++;)
+			sent = client.println("HTTP/1.1 501 Not Implemented");
 		}
 
+# ifdef HTTPSERVER_METRICS
+		recordHistogram(metrics.sendTime, micros() - timestamp);
+		metrics.bytesOut += sent;
+		if (returnCode >= 100 && returnCode < 600) {
+			metrics.responsesByStatus[returnCode / 100]++;
+		}
+		if (route) {
+			route->requests++;
+			route->bytesOut += sent;
+			if (returnCode >= 400) {
+				route->errors++;
+			}
+			recordHistogram(route->handlerTime, handlerTime);
+		}
+# endif
+
 		// Close the client connection
 		if (body) {
 			free(body);
@@ -149,7 +254,13 @@ void HttpServer::check() {
 }
 
 
+void HttpServer::setTimeout(unsigned long timeout) {
+	requestTimeout = timeout;
+}
+
+
 void HttpServer::addHandler(String path, Method method, RequestHandler handler) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
 	// find an existing handler for that path. If yes, then replace the handler
 	Handler *h = findHandler(path, method);
 	if (h) {	
@@ -166,6 +277,7 @@ void HttpServer::addHandler(String path, Method method, RequestHandler handler)
 
 
 void HttpServer::removeHandler(String path, Method method) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
 	// We can't use findHandler() here bc we need the index
 	for (int i = 0; i < handlers.size(); i++) {
 		Handler *h = handlers.get(i);
@@ -185,6 +297,41 @@ bool HttpServer::hasHandler(String path, Method method) {
 }
 
 
+void HttpServer::addStaticAsset(String path, String type, const uint8_t *data, size_t length, bool gzipped, unsigned long maxAge, 
+								const uint8_t *identityData, size_t identityLength) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
+	// find an existing asset for that path. If yes, then replace it
+	StaticAsset *a = findAsset(path);
+	if ( ! a) {
+		a = new StaticAsset();
+		a->path = path;
+		assets.add(a);
+	}
+	a->type = type;
+	a->data = data;
+	a->length = length;
+	a->gzipped = gzipped;
+	a->maxAge = maxAge;
+	a->etag = calculateETag(data, length);	// only calculated once
+	a->identityData = gzipped ? identityData : NULL;
+	a->identityLength = a->identityData != NULL ? identityLength : 0;
+	a->identityEtag = a->identityData != NULL ? calculateETag(identityData, identityLength) : "";
+}
+
+
+void HttpServer::removeStaticAsset(String path) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
+	for (int i = 0; i < assets.size(); i++) {
+		StaticAsset *a = assets.get(i);
+		if (a && a->path.compareTo(path) == 0) {
+			assets.remove(i);
+			delete a;
+			return;
+		}
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //	Internal methods
@@ -209,6 +356,143 @@ HttpServer::Handler* HttpServer::findHandler(String path, Method method) {
 
 
 
+HttpServer::StaticAsset* HttpServer::findAsset(String path) {
+	//get path without possible parameters
+	int idx = path.indexOf('?');
+	if (idx > 0) {
+		path = path.substring(0,idx);
+	}
+	for (int i = 0; i < assets.size(); i++) {
+		StaticAsset *a = assets.get(i);
+		if (a && a->path.compareTo(path) == 0) {
+			return a;
+		}
+	}
+	return NULL;
+}
+
+
+// Send a static asset. The header is sent first, then the data is streamed
+// from flash memory through a small buffer. Clients that don't accept gzip
+// get the uncompressed copy of a gzipped asset, if there is one. Without an
+// Accept-Encoding header every encoding is acceptable (RFC 7231, 5.3.4), but
+// the uncompressed copy is preferred for such simple clients.
+int HttpServer::sendAsset(WiFiClient &client, StaticAsset *asset, Method method, String ifNoneMatch, String acceptEncoding, bool hasAcceptEncoding, size_t &sent) {
+	bool 			gzip = asset->gzipped;
+	const uint8_t 	*data = asset->data;
+	size_t 			length = asset->length;
+	const String 	*etag = &asset->etag;
+	if (gzip) {
+		bool acceptsGzip = ! hasAcceptEncoding || acceptsEncoding(acceptEncoding, "gzip");
+		bool acceptsIdentity = ! hasAcceptEncoding || acceptsEncoding(acceptEncoding, "identity");
+		gzip = acceptsGzip && (hasAcceptEncoding || asset->identityData == NULL);
+		if ( ! gzip && ( ! acceptsIdentity || asset->identityData == NULL)) {
+			sent = client.print("HTTP/1.1 406 " + getResultMessage(406) + "\r\nContent-Length: 0\r\n\r\n");
+			return 406;
+		}
+	}
+	if (asset->gzipped && ! gzip) {
+		data = asset->identityData;
+		length = asset->identityLength;
+		etag = &asset->identityEtag;
+	}
+	int code = 200;
+	if (ifNoneMatch.length() > 0 && (ifNoneMatch == "*" || ifNoneMatch.indexOf(*etag) > -1)) {
+		code = 304;
+	}
+
+	String header = "HTTP/1.1 " + String(code) + " " + getResultMessage(code);
+	header += "\r\nETag: " + *etag;
+	if (asset->maxAge > 0) {
+		header += "\r\nCache-Control: max-age=" + String(asset->maxAge);
+	} else {
+		header += "\r\nCache-Control: no-cache";
+	}
+	if (asset->gzipped) {
+		header += "\r\nVary: Accept-Encoding";
+	}
+	if (code == 304) {
+		header += "\r\n\r\n";
+		sent = client.print(header);
+		return code;
+	}
+	header += "\r\nContent-Type: " + asset->type;
+	if (gzip) {
+		header += "\r\nContent-Encoding: gzip";
+	}
+	header += "\r\nContent-Length: " + String((unsigned long)length);
+	header += "\r\n\r\n";
+	sent = client.print(header);
+	if (method == HEAD) {
+		return code;
+	}
+
+	uint8_t buffer[HTTPSERVER_ASSET_CHUNK_SIZE];
+	for (size_t pos = 0; pos < length; ) {
+		size_t n = length - pos;
+		if (n > sizeof(buffer)) {
+			n = sizeof(buffer);
+		}
+		memcpy_P(buffer, data + pos, n);
+		size_t w = client.write(buffer, n);
+		sent += w;
+		if (w != n) {
+			break;	// client disconnected
+		}
+		pos += n;
+	}
+	return code;
+}
+
+
+// Check whether the value of an Accept-Encoding header accepts *encoding*.
+// An encoding with the quality value "q=0" is not acceptable. The wildcard
+// "*" matches all encodings that are not listed. "identity" is acceptable
+// unless it is excluded explicitly or by the wildcard.
+bool HttpServer::acceptsEncoding(String value, String encoding) {
+	int wildcard = -1;		// -1: not listed, 0: not acceptable, 1: acceptable
+	value.toLowerCase();
+	for (int start = 0; start < (int)value.length(); ) {
+		int end = value.indexOf(',', start);
+		if (end < 0) {
+			end = value.length();
+		}
+		String item = value.substring(start, end);
+		start = end + 1;
+
+		double quality = 1.0;
+		int idx = item.indexOf(';');
+		String coding = idx > -1 ? item.substring(0, idx) : item;
+		coding.trim();
+		if (idx > -1) {
+			String parameter = item.substring(idx + 1);
+			parameter.trim();
+			if (parameter.startsWith("q=")) {
+				quality = parameter.substring(2).toFloat();
+			}
+		}
+		if (coding == encoding || coding == "x-" + encoding) {
+			return quality > 0;
+		}
+		if (coding == "*") {
+			wildcard = quality > 0 ? 1 : 0;
+		}
+	}
+	return wildcard == 1 || (wildcard == -1 && encoding == "identity");
+}
+
+
+// Calculate an entity tag from the asset's data (FNV-1a hash and length)
+String HttpServer::calculateETag(const uint8_t *data, size_t length) {
+	uint32_t hash = 2166136261UL;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= pgm_read_byte(data + i);
+		hash *= 16777619UL;
+	}
+	return "\"" + String(hash, HEX) + "-" + String((unsigned long)length, HEX) + "\"";
+}
+
+
 HttpServer::Method HttpServer::getMethod(String v) {
 	if (v.compareTo("GET") == 0) {
 		return GET;
@@ -302,31 +586,243 @@ String HttpServer::getResultMessage(int code) {
 }
 
 
+// Call a request handler. Handlers belong to the application, also for the
+// heap accounting.
+HttpServer::RequestResult HttpServer::callHandler(RequestHandler rh, const String &path, Method method, long contentLength, const String &contentType, char *body) {
+	HEAP_SCOPE(HEAP_APPLICATION);
+	return (*rh)(path, method, contentLength, contentType, body);
+}
+
+
 // Init the WifiServer
 void HttpServer::initServer(int port) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
+	requestTimeout = HTTPSERVER_TIMEOUT;
+	HTTPSERVER_METRIC(resetMetrics();)
 	server = new WiFiServer(port);
 	server->begin();
 	//Serial.printf("Started server on port %d\n", port);
 }
 
 
+# ifdef HTTPSERVER_METRICS
+//////////////////////////////////////////////////////////////////////////////
+//
+//	Metrics
+//
+
+// Upper bounds of the histogram buckets in microseconds, and the same bounds
+// in seconds for the Prometheus output.
+static const unsigned long 	histogramBounds[HTTPSERVER_HISTOGRAM_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 50000, 250000 
+};
+static const char 			*histogramLabels[HTTPSERVER_HISTOGRAM_BUCKETS - 1] = {
+	"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.05", "0.25"
+};
+static const char 			*methodNames[HttpServer::ALL + 1] = {
+	"NONE", "GET", "POST", "PUT", "HEAD", "DELETE", "OPTIONS", "CONNECT", "ALL"
+};
+
+
+const HttpServer::Metrics &HttpServer::getMetrics() {
+	return metrics;
+}
+
+
+const HttpServer::RouteMetrics *HttpServer::getRouteMetrics(String path, Method method) {
+	Handler *h = findHandler(path, method);
+	return h != NULL ? &h->metrics : NULL;
+}
+
+
+void HttpServer::resetMetrics() {
+	memset(&metrics, 0, sizeof(metrics));
+	for (int i = 0; i < handlers.size(); i++) {
+		memset(&handlers.get(i)->metrics, 0, sizeof(RouteMetrics));
+	}
+	for (int i = 0; i < assets.size(); i++) {
+		memset(&assets.get(i)->metrics, 0, sizeof(RouteMetrics));
+	}
+}
+
+
+void HttpServer::enableMetricsHandler(String path) {
+	metricsPath = path;
+}
+
+
+// Return all metrics in the Prometheus text format. The text is written
+// twice: the first pass only counts its length, so the String is allocated
+// once with the exact size.
+String HttpServer::metricsText() {
+	String out;
+	out.reserve(writeMetrics(NULL));
+	writeMetrics(&out);
+	return out;
+}
+
+
+// Write all metrics in the Prometheus text format to *out*, or only count
+// their length if *out* is NULL. Each metric family is written completely,
+// after its HELP and TYPE lines. The length of the text is returned.
+size_t HttpServer::writeMetrics(String *out) {
+	size_t length = 0;
+
+	writeFamily(out, length, "httpserver_requests_total", "counter", "Processed requests by method.");
+	for (int m = 0; m <= ALL; m++) {
+		if (metrics.requestsByMethod[m] > 0) {
+			writeSample(out, length, "httpserver_requests_total{method=\"" + String(methodNames[m]) + "\"} " + String(metrics.requestsByMethod[m]));
+		}
+	}
+	writeFamily(out, length, "httpserver_responses_total", "counter", "Answers by status class.");
+	for (int c = 1; c < 6; c++) {
+		writeSample(out, length, "httpserver_responses_total{status=\"" + String(c) + "xx\"} " + String(metrics.responsesByStatus[c]));
+	}
+	writeFamily(out, length, "httpserver_default_handler_requests_total", "counter", "Requests handled by the default request handler.");
+	writeSample(out, length, "httpserver_default_handler_requests_total " + String(metrics.defaultHandlerRequests));
+	writeFamily(out, length, "httpserver_not_implemented_total", "counter", "Requests answered with 501 Not Implemented.");
+	writeSample(out, length, "httpserver_not_implemented_total " + String(metrics.notImplemented));
+	writeFamily(out, length, "httpserver_timeouts_total", "counter", "Requests that were not received in time.");
+	writeSample(out, length, "httpserver_timeouts_total " + String(metrics.timeouts));
+	writeFamily(out, length, "httpserver_received_bytes_total", "counter", "Received bytes.");
+	writeSample(out, length, "httpserver_received_bytes_total " + String(metrics.bytesIn));
+	writeFamily(out, length, "httpserver_sent_bytes_total", "counter", "Sent bytes.");
+	writeSample(out, length, "httpserver_sent_bytes_total " + String(metrics.bytesOut));
+	writeFamily(out, length, "httpserver_peak_body_bytes", "gauge", "Largest request body.");
+	writeSample(out, length, "httpserver_peak_body_bytes " + String(metrics.peakBodySize));
+	writeFamily(out, length, "httpserver_parse_seconds", "histogram", "Time to receive and parse a request.");
+	writeHistogram(out, length, "httpserver_parse_seconds", "", metrics.parseTime);
+	writeFamily(out, length, "httpserver_handler_seconds", "histogram", "Time to handle a request.");
+	writeHistogram(out, length, "httpserver_handler_seconds", "", metrics.handlerTime);
+	writeFamily(out, length, "httpserver_send_seconds", "histogram", "Time to send an answer.");
+	writeHistogram(out, length, "httpserver_send_seconds", "", metrics.sendTime);
+
+	// per route metrics, one family after the other
+	int routes = handlers.size() + assets.size();
+	writeFamily(out, length, "httpserver_route_requests_total", "counter", "Requests by handler and static asset.");
+	for (int i = 0; i < routes; i++) {
+		const RouteMetrics *rm;
+		String labels = routeLabels(i, rm);
+		writeSample(out, length, "httpserver_route_requests_total{" + labels + "} " + String(rm->requests));
+	}
+	writeFamily(out, length, "httpserver_route_errors_total", "counter", "Answers with a status code >= 400 by handler and static asset.");
+	for (int i = 0; i < routes; i++) {
+		const RouteMetrics *rm;
+		String labels = routeLabels(i, rm);
+		writeSample(out, length, "httpserver_route_errors_total{" + labels + "} " + String(rm->errors));
+	}
+	writeFamily(out, length, "httpserver_route_sent_bytes_total", "counter", "Sent bytes by handler and static asset.");
+	for (int i = 0; i < routes; i++) {
+		const RouteMetrics *rm;
+		String labels = routeLabels(i, rm);
+		writeSample(out, length, "httpserver_route_sent_bytes_total{" + labels + "} " + String(rm->bytesOut));
+	}
+	writeFamily(out, length, "httpserver_route_handler_seconds", "histogram", "Time to handle a request by handler and static asset.");
+	for (int i = 0; i < routes; i++) {
+		const RouteMetrics *rm;
+		String labels = routeLabels(i, rm);
+		writeHistogram(out, length, "httpserver_route_handler_seconds", labels + ",", rm->handlerTime);
+	}
+	return length;
+}
+
+
+// Return the labels of a handler (*index* < number of handlers) or a static
+// asset, and its metrics in *rm*
+String HttpServer::routeLabels(int index, const RouteMetrics *&rm) {
+	if (index < handlers.size()) {
+		Handler *h = handlers.get(index);
+		rm = &h->metrics;
+		return "path=\"" + escapeLabel(h->path) + "\",method=\"" + String(methodNames[h->method]) + "\"";
+	}
+	StaticAsset *a = assets.get(index - handlers.size());
+	rm = &a->metrics;
+	return "path=\"" + escapeLabel(a->path) + "\",method=\"GET\"";
+}
+
+
+// Escape a label value: backslash, double quote and line feed
+String HttpServer::escapeLabel(const String &value) {
+	String result;
+	result.reserve(value.length() + 4);
+	for (unsigned int i = 0; i < value.length(); i++) {
+		char c = value[i];
+		if (c == '\\' || c == '"') {
+			result += '\\';
+			result += c;
+		} else if (c == '\n') {
+			result += "\\n";
+		} else {
+			result += c;
+		}
+	}
+	return result;
+}
+
+
+// Write the HELP and TYPE lines of a metric family
+void HttpServer::writeFamily(String *out, size_t &length, const char *name, const char *type, const char *help) {
+	writeSample(out, length, "# HELP " + String(name) + " " + help);
+	writeSample(out, length, "# TYPE " + String(name) + " " + type);
+}
+
+
+// Write a line, or only count its length if *out* is NULL
+void HttpServer::writeSample(String *out, size_t &length, const String &line) {
+	length += line.length() + 1;
+	if (out != NULL) {
+		*out += line;
+		*out += '\n';
+	}
+}
+
+
+// Add a value in microseconds to a histogram
+void HttpServer::recordHistogram(Histogram &histogram, unsigned long value) {
+	int b = 0;
+	while (b < HTTPSERVER_HISTOGRAM_BUCKETS - 1 && value > histogramBounds[b]) {
+		b++;
+	}
+	histogram.buckets[b]++;
+	histogram.count++;
+	histogram.sum += value;
+}
+
+
+// Write a histogram in Prometheus text format. Prometheus buckets are
+// cumulative.
+void HttpServer::writeHistogram(String *out, size_t &length, const char *name, String labels, const Histogram &histogram) {
+	unsigned long cumulative = 0;
+	for (int b = 0; b < HTTPSERVER_HISTOGRAM_BUCKETS; b++) {
+		cumulative += histogram.buckets[b];
+		writeSample(out, length, String(name) + "_bucket{" + labels + "le=\"" + 
+					(b < HTTPSERVER_HISTOGRAM_BUCKETS - 1 ? histogramLabels[b] : "+Inf") + "\"} " + String(cumulative));
+	}
+	String l = labels.length() > 0 ? "{" + labels.substring(0, labels.length() - 1) + "}" : "";
+	writeSample(out, length, String(name) + "_sum" + l + " " + String(histogram.sum / 1000000.0, 6));
+	writeSample(out, length, String(name) + "_count" + l + " " + String(histogram.count));
+}
+# endif
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //	Static methods
 //
 
 int HttpServer::parseRequestArguments(String path) {
+	HEAP_SCOPE(HEAP_HTTPSERVER);
 
 	// free the old argument list
 	if (requestArguments != NULL) {
 		requestArgumentsCount = 0;
-		delete requestArguments;
+		delete[] requestArguments;
 		requestArguments = NULL;
 	}
 
 	// get the arguments.
 	int qm = path.indexOf('?'); 
-	char *token, *argString, *tofree;
+	char *argString, *tofree;
 	tofree = argString = strdup(path.substring(qm+1).c_str()); // This still works when qm is -1
 
 	// determine the number of arguments
@@ -361,7 +857,7 @@ int HttpServer::parseRequestArguments(String path) {
 
 
 String HttpServer::getRequestArgument(const String key) {
-	for (unsigned int i = 0; i < requestArgumentsCount; i++) {
+	for (int i = 0; i < requestArgumentsCount; i++) {
 		if (requestArguments[i].key == key) {
 			return requestArguments[i].value;
 		}
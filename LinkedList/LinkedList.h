@@ -11,6 +11,10 @@
 # ifndef __LINKEDLIST_H__
 # define __LINKEDLIST_H__
 
+// Define HEAP_ACCOUNTING to attribute the allocations of the nodes of a list
+// to HEAP_LINKEDLIST.
+# include "HeapScope.h"
+
 
 // Representation of a single node in the list.
 template<class T> 
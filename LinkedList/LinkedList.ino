@@ -31,6 +31,7 @@ int LinkedList<T>::size() {
 
 template<typename T>
 bool LinkedList<T>::add(T object, int position) {
+	HEAP_SCOPE(HEAP_LINKEDLIST);
 	if (position < 0 || position > cnt) {
 		return false;
 	}
@@ -86,6 +87,7 @@ bool LinkedList<T>::remove() {
 
 template<typename T>
 bool LinkedList<T>::remove(int position) {
+	HEAP_SCOPE(HEAP_LINKEDLIST);
 	if (position < 0 || position >= cnt) {
 		return false;
 	}
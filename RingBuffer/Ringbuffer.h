@@ -10,6 +10,12 @@
 # ifndef __RINGBUFFER_H__
 # define __RINGBUFFER_H__
 
+# include <new>
+
+// Define HEAP_ACCOUNTING to attribute the allocations of the buffer to
+// HEAP_RINGBUFFER.
+# include "HeapScope.h"
+
 template <typename T> 
 class RingBuffer {
 
@@ -22,6 +28,9 @@ private:
 	// calculate the absolute position of an item in the buffer
 	int 			 _relativeToFirst(int pos);		
 
+	// replace the item at an absolute position by a new object
+	void 			 _reset(int pos);
+
 public:
 	RingBuffer(int size);
 	~RingBuffer();
@@ -52,6 +61,10 @@ public:
 	// If the buffer is empty, a new object of Type T is returned.
 	T 				 getLatest();
 
+	// The following methods replace removed elements by a new object of
+	// type T, so that they release their resources, e.g. the memory of a 
+	// String.
+
 	// Remove *count* elements from the tail and head of the ring buffer.
 	// The size of the ring buffer is reduced by *count* * 2 items.
 	// The method returns true if successful, false otherwiese.
@@ -11,6 +11,7 @@
 
 template<typename T>
 RingBuffer<T>::RingBuffer(int size) {
+	HEAP_SCOPE(HEAP_RINGBUFFER);
 	_buffer = new T[size];
 	_size = size;
 	clear();
@@ -19,7 +20,8 @@ RingBuffer<T>::RingBuffer(int size) {
 
 template<typename T>
 RingBuffer<T>::~RingBuffer() {
-	delete _buffer;
+	HEAP_SCOPE(HEAP_RINGBUFFER);
+	delete[] _buffer;
 }
 
 
@@ -63,6 +65,9 @@ T RingBuffer<T>::getLatest() {	// get relative last elemnt
 
 template<typename T>
 void RingBuffer<T>::clear() {
+	for (int i = 0; i < _size; i++) {	// release the resources of the removed items
+		_reset(i);
+	}
 	_index = 0;
 	_count = 0;
 }
@@ -85,6 +90,9 @@ bool RingBuffer<T>::sliceHead(int count) {
 	if (count > _count) {
 		return false;
 	}
+	for (int i = 0; i < count; i++) {	// release the resources of the removed items
+		_reset(_relativeToFirst(_count - i - 1));
+	}
 	_count -= count;
 	_index = (_index - count + _size) % _size;
 	return true;
@@ -96,6 +104,9 @@ bool RingBuffer<T>::sliceTail(int count) {
 	if (count > _count) {
 		return false;
 	}
+	for (int i = 0; i < count; i++) {	// release the resources of the removed items
+		_reset(_relativeToFirst(i));
+	}
 	_count -= count;
 	return true;
 }
@@ -141,3 +152,12 @@ int RingBuffer<T>::_relativeToFirst(int pos) {
 }
 
 
+// Replace an item by a new object. Destroying the item releases its 
+// resources, which an assignment might keep (e.g. the buffer of a String).
+template<typename T>
+void RingBuffer<T>::_reset(int pos) {
+	_buffer[pos].~T();
+	new (&_buffer[pos]) T();
+}
+
+
@@ -12,6 +12,10 @@
 
 # include "LinkedList.h"
 
+// Define HEAP_ACCOUNTING to attribute the allocations of tasks and the task
+// list to HEAP_TASKMANAGER.
+# include "HeapScope.h"
+
 typedef bool (*TaskHandler)();
 
 // Structure to represent a single task
@@ -41,6 +45,7 @@ private:
 	unsigned long		runTaskMs;	// Current millis to use globally for current runTasks
 
 	Task 	*_getTaskById(const long taskId);
+	bool 	 _runHandler(const TaskHandler handler);
 
 public:
 	TaskManager();
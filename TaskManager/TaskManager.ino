@@ -11,6 +11,7 @@
 
 TaskManager::TaskManager() {
 	nextID = 0;
+	runTaskMs = 0;
 }
 
 TaskManager::~TaskManager() {
@@ -35,7 +36,7 @@ void TaskManager::runTasks() {
 				continue;
 			}
 
-			bool result = (*task->taskHandler)();
+			bool result = _runHandler(task->taskHandler);
 			task->runCount++;
 			if ( ! task->runOnTime) {
 				task->nextRun = millis() + task->interval; // next run: current time, after task handler returned, + interval ms
@@ -72,6 +73,7 @@ long TaskManager::addTask(const TaskHandler taskHandler, const unsigned long int
 }
 
 long TaskManager::addTask(const TaskHandler taskHandler, const TaskHandler initTaskHandler, const TaskHandler deinitTaskHandler, const unsigned long interval, const bool autoStart) {
+	HEAP_SCOPE(HEAP_TASKMANAGER);
 	Task *task = new Task();
 	task->id = nextID++;
 	task->taskHandler = taskHandler;
@@ -97,6 +99,7 @@ long TaskManager::addTask(const TaskHandler taskHandler, const TaskHandler initT
 
 
 void TaskManager::removeTask(const long taskId) {
+	HEAP_SCOPE(HEAP_TASKMANAGER);
 	for (int i = 0; i < tasks.size(); i++) {
 		Task *task = tasks.get(i);
 		if (task->id == taskId) {
@@ -110,6 +113,7 @@ void TaskManager::removeTask(const long taskId) {
 
 
 void TaskManager::reset() {
+	HEAP_SCOPE(HEAP_TASKMANAGER);
 	while (tasks.size() > 0) {
 		Task *task = tasks.get(0);
 		stopTask(task->id);
@@ -143,7 +147,7 @@ void TaskManager::startTask(const long taskId, const unsigned long startAfter, c
 		}
 		if (task->initTaskHandler) {
 			task->inStart = true;
-			bool result = (*task->initTaskHandler)();
+			bool result = _runHandler(task->initTaskHandler);
 			task->inStart = false;
 			if ( ! result ) {	// no, then don't start
 				return;
@@ -174,7 +178,7 @@ void TaskManager::stopTask(const long taskId) {
 		task->running = false;
 		if (task->deinitTaskHandler) {
 			task->inStop = true;
-			bool result = (*task->deinitTaskHandler)();
+			bool result = _runHandler(task->deinitTaskHandler);
 			task->inStop = false;
 			if (task->deinitTaskHandler) {
 				if ( ! result) {	// no, then don't stop
@@ -204,3 +208,10 @@ Task *TaskManager::_getTaskById(const long taskId) {
 	}
 	return NULL;
 }
+
+
+// Handlers belong to the application, also for the heap accounting
+bool TaskManager::_runHandler(const TaskHandler handler) {
+	HEAP_SCOPE(HEAP_APPLICATION);
+	return (*handler)();
+}
@@ -0,0 +1,64 @@
+/*
+ *	SerializationBenchmark.ino
+ *
+ *	copyright (c) Andreas Kraft 2018
+ *	Licensed under the BSD 3-Clause License. See the LICENSE file for further details.
+ *
+ *	Compare the size and the time to encode and decode a ContentInstance
+ *	with JSON and CBOR serialization.
+ */
+
+# include "oneM2M.h"
+
+# define ITERATIONS		1000
+
+const int 		contentSizes[] = { 4, 32, 128, 200 };
+uint8_t 		buffer[ONEM2M_CBOR_BUFFER_SIZE];
+
+
+void benchmark(OneM2M::Serialization serialization, String content) {
+	OneM2M::ResourceFields 	fields;
+	size_t 					length = 0;
+	unsigned long 			start;
+
+	start = micros();
+	for (int i = 0; i < ITERATIONS; i++) {
+		length = OneM2M::encodeContentInstance(serialization, content, "text/plain:0", buffer, sizeof(buffer));
+	}
+	unsigned long encodeTime = micros() - start;
+
+	start = micros();
+	for (int i = 0; i < ITERATIONS; i++) {
+		OneM2M::decodeResource(serialization, buffer, length, fields);
+	}
+	unsigned long decodeTime = micros() - start;
+
+	// format, content bytes, encoded bytes, encode µs, decode µs
+	Serial.print(serialization == OneM2M::CBOR ? "cbor," : "json,");
+	Serial.print(content.length());
+	Serial.print(",");
+	Serial.print(length);
+	Serial.print(",");
+	Serial.print((float)encodeTime / ITERATIONS);
+	Serial.print(",");
+	Serial.println((float)decodeTime / ITERATIONS);
+}
+
+
+void setup() {
+	Serial.begin(115200);
+	Serial.println();
+	Serial.println("format,content,bytes,encode_us,decode_us");
+	for (unsigned int i = 0; i < sizeof(contentSizes) / sizeof(contentSizes[0]); i++) {
+		String content;
+		for (int j = 0; j < contentSizes[i]; j++) {
+			content += (char)('0' + j % 10);
+		}
+		benchmark(OneM2M::JSON, content);
+		benchmark(OneM2M::CBOR, content);
+	}
+}
+
+
+void loop() {
+}
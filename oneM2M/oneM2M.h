@@ -10,8 +10,76 @@
 # ifndef __ONEM2M_H__
 # define __ONEM2M_H__
 
+# include "EEPROMStore.h"
 # include "HttpServer.h"
 # include "LinkedList.h"
+# include "Ringbuffer.h"
+
+// Maximum number of simultaneously open connections to the CSE.
+# ifndef ONEM2M_MAX_CONNECTIONS
+# define ONEM2M_MAX_CONNECTIONS		2
+# endif
+
+// Define HEAP_ACCOUNTING to attribute the allocations of requests, queues
+// and notifications to HEAP_ONEM2M.
+# include "HeapScope.h"
+
+// Maximum number of connections that asynchronous requests use at the same
+// time. The remaining connections are reserved for synchronous requests and
+// upload queues, so these don't fail while asynchronous requests are in
+// flight. Synchronous requests never process asynchronous requests, so 
+// without a reserved connection they fail while all connections are in use.
+# ifndef ONEM2M_ASYNC_CONNECTIONS
+# define ONEM2M_ASYNC_CONNECTIONS	(ONEM2M_MAX_CONNECTIONS > 1 ? ONEM2M_MAX_CONNECTIONS - 1 : 1)
+# endif
+# if ONEM2M_ASYNC_CONNECTIONS < 1 || ONEM2M_ASYNC_CONNECTIONS > ONEM2M_MAX_CONNECTIONS
+# error "ONEM2M_ASYNC_CONNECTIONS must be between 1 and ONEM2M_MAX_CONNECTIONS"
+# endif
+
+// Maximum number of bytes of an asynchronous request that are sent during a
+// single call of poll().
+# ifndef ONEM2M_SEND_SIZE
+# define ONEM2M_SEND_SIZE			512
+# endif
+
+// Asynchronous requests open new connections without blocking on platforms
+// with a socket API. The ESP8266 core has no non-blocking connect.
+# if defined(ESP32) || defined(ARDUINO_ARCH_HOST)
+# define ONEM2M_NONBLOCKING_CONNECT
+# endif
+
+// Default time in milliseconds to wait for a response from the CSE.
+# ifndef ONEM2M_TIMEOUT
+# define ONEM2M_TIMEOUT				10000
+# endif
+
+// Maximum number of queued ContentInstances that are sent at once over a
+// connection before the responses are read.
+# ifndef ONEM2M_PIPELINE_DEPTH
+# define ONEM2M_PIPELINE_DEPTH		4
+# endif
+
+// Size of the buffers for resource identifiers and subscription references
+// that are extracted from responses and notifications.
+# ifndef ONEM2M_ID_SIZE
+# define ONEM2M_ID_SIZE				96
+# endif
+
+// Size of the buffer for the content of a ContentInstance that is extracted
+// from a response or notification. Longer contents are truncated.
+# ifndef ONEM2M_CONTENT_SIZE
+# define ONEM2M_CONTENT_SIZE			256
+# endif
+
+// Size of the buffer for CBOR-encoded request bodies. It is allocated once per
+// OneM2M instance when CBOR serialization is selected. Requests with longer 
+// bodies fail when CBOR serialization is selected.
+# ifndef ONEM2M_CBOR_BUFFER_SIZE
+# define ONEM2M_CBOR_BUFFER_SIZE		512
+# endif
+
+// Maximum nesting depth of CBOR-encoded resources
+# define ONEM2M_CBOR_MAX_DEPTH			16
 
 class OneM2M {
 public:
@@ -75,9 +143,69 @@ public:
 		bool	state;					// Indicate the resource's retrieval state 
 	};
 
+	// Serializations of request and response bodies
+	enum Serialization {
+		JSON,				// application/json
+		CBOR				// application/cbor
+	};
+
+	// Structure to hold the attributes of a resource that are extracted while
+	// a response or notification is parsed. Missing attributes are empty.
+	struct ResourceFields {
+		char 	resourceIdentifier[ONEM2M_ID_SIZE];		// ri
+		int 	type;									// ty, or UNKNOWN
+		char 	content[ONEM2M_CONTENT_SIZE];			// con
+		char 	contentFormat[32];						// cnf
+		char 	creationTime[24];						// ct
+		char 	subscriptionReference[ONEM2M_ID_SIZE];	// sur of a notification
+		bool 	verificationRequest;					// vrq of a notification
+		bool 	truncated;								// an attribute did not fit into its buffer
+	};
+
+	// Structure to hold statistics about the connections to the CSE.
+	struct ConnectionStatistics {
+		unsigned long	requests;				// Number of requests sent to the CSE
+		unsigned long	connects;				// Number of newly opened connections
+		unsigned long	reuses;					// Number of requests sent over an already open connection
+		unsigned long	reconnects;				// Number of requests repeated because a reused connection was closed by the CSE
+		unsigned long	failures;				// Number of failed connection attempts
+		unsigned long	timeouts;				// Number of requests that timed out
+	};
+
+	// Structure to hold statistics about the resource cache.
+	struct CacheStatistics {
+		unsigned long	hits;					// Number of resources that were resolved from the cache
+		unsigned long	misses;					// Number of resources that were not found in the cache
+		unsigned long	invalidations;			// Number of removed cache entries
+		unsigned long	roundTripsSaved;		// Number of requests to the CSE that were not necessary
+	};
+
+	// Policies for full upload queues
+	enum QueuePolicy {
+		DROP_OLDEST,		// The oldest queued content is overwritten by new content
+		DROP_NEWEST			// New content is rejected
+	};
+
+	// Structure to hold statistics about queued ContentInstance uploads.
+	struct UploadStatistics {
+		unsigned long	queued;					// Number of queued contents
+		unsigned long	uploaded;				// Number of ContentInstances created on the CSE
+		unsigned long	rejected;				// Number of ContentInstances rejected by the CSE
+		unsigned long	deferred;				// Number of temporary errors of the CSE, the contents stay queued
+		unsigned long	dropped;				// Number of contents dropped because a queue was full
+		unsigned long	batches;				// Number of pipelined batches sent to the CSE
+	};
+
 	// typedef for notification callback functions
 	typedef void (*NotificationCallback)(String resourceIdentifier, OneM2M::ResourceType type, String resource);
 
+	// typedef for notification callback functions that receive the extracted
+	// attributes of the notification
+	typedef void (*NotificationFieldsCallback)(const OneM2M::ResourceFields &fields);
+
+	// typedef for completion callback functions of asynchronous requests
+	typedef void (*CompletionCallback)(long handle, int statusCode, String body);
+
 
 private:
 
@@ -86,16 +214,190 @@ private:
 		String rn;
 	};
 
+	// States of the response parser
+	enum ResponseState {
+		STATUS, HEADER, BODY, CHUNKSIZE, CHUNKDATA, CHUNKEND, TRAILER, DONE
+	};
+
+	// States of the scanner
+	enum ScanState {
+		SCAN_VALUE, SCAN_KEY, SCAN_COLON, SCAN_NEXT, SCAN_STRING, SCAN_ESCAPE, SCAN_UNICODE, SCAN_LITERAL, SCAN_ERROR,
+		CBOR_HEAD, CBOR_ARGUMENT, CBOR_DATA
+	};
+
+	// Attributes extracted by the scanner
+	enum ScanField {
+		FIELD_NONE = 0, FIELD_RI = 1, FIELD_TY = 2, FIELD_CON = 4, FIELD_CNF = 8, FIELD_CT = 16, FIELD_SUR = 32, FIELD_VRQ = 64
+	};
+
+	// Structure to hold a CBOR encoder that writes into a fixed buffer
+	struct CborWriter {
+		uint8_t 		*buffer;
+		size_t 			 size;
+		size_t 			 length;
+		size_t 			 start;					// start of the current text string or literal
+		bool 			 overflow;				// the buffer is too small
+	};
+
+	// Class that provides the CBOR buffer for the body of a request. It uses
+	// the buffer of the OneM2M instance, which is allocated when CBOR 
+	// serialization is selected. A request that is made while that buffer is
+	// in use, e.g. by a completion callback during poll(), gets a temporary
+	// buffer. There is no buffer for JSON serialization.
+	class CborBody {
+	public:
+		CborWriter 		 writer;
+
+		CborBody(OneM2M *owner);
+		~CborBody();
+		void 			 reset(void);		// start a new body in the same buffer
+	private:
+		OneM2M 			*_owner;
+		uint8_t 		*_buffer;
+	};
+
+	// Structure to hold the state of the scanner. The scanner processes a JSON
+	// or CBOR document byte by byte and copies the first occurrence of each
+	// attribute of interest to a ResourceFields structure. Captured objects,
+	// arrays and maps are stored as JSON text. The nesting depth is limited 
+	// to 31 levels for JSON, and to ONEM2M_CBOR_MAX_DEPTH levels for CBOR.
+	struct Scanner {
+		ResourceFields 	*fields;
+		bool 			 cbor;					// the document is CBOR-encoded
+		CborWriter 		*writer;				// transcode a JSON document to CBOR, or NULL
+		ScanState 		 state;
+		int 			 depth;
+		uint32_t 		 objects;				// bit n is set if the container at depth n is an object or map
+		bool 			 empty;					// no member or element follows a comma in the current JSON container
+		bool 			 isKey;
+		char 			 key[12];				// current key. Longer keys are cleared
+		int 			 keyLength;
+		char 			 rootKey[12];			// first key of the top-level object
+		char 			*target;				// buffer for the current value, or NULL
+		size_t 			 targetSize;
+		size_t 			 targetLength;
+		ScanField 		 targetField;
+		int 			 rawDepth;				// depth of a captured object or array, or -1
+		uint8_t 		 captured;				// ScanFields that were already captured
+		char 			 literal[8];			// buffer for the ty and vrq values
+		uint16_t 		 unicode;
+		uint8_t 		 unicodeDigits;
+		long 			 position;				// number of scanned characters
+		int 			 repDepth;
+		long 			 repStart;				// position of the rep value of a notification, or -1
+		long 			 repEnd;
+		long 			 itemStart;				// position of the current CBOR item
+		uint8_t 		 major;					// major type of the current CBOR item
+		uint8_t 		 info;					// additional information of the current CBOR item
+		uint8_t 		 argumentBytes;			// remaining bytes of the current CBOR argument
+		uint64_t 		 argument;
+		bool 			 indefiniteString;
+		uint32_t 		 keyNext;				// bit n is set if the next item of the map at depth n is a key
+		uint32_t 		 hasItems;				// bit n is set if the container at depth n has items
+		uint16_t 		 remaining[ONEM2M_CBOR_MAX_DEPTH + 1];	// remaining items of a CBOR container
+	};
+
+	// Structure to hold a response while it is parsed
+	struct Response {
+		ResponseState 	state;
+		int 			statusCode;
+		long 			contentLength;			// -1 if unknown
+		long 			remaining;				// remaining bytes of the body or the current chunk
+		bool			chunked;
+		bool			keepAlive;
+		String 			line;					// current status, header or chunk size line
+		String 			body;					// not used if a scanner is set
+		Scanner 		*scanner;				// scanner for the body, or NULL
+	};
+
+	// Results of receiving a part of a response, or of checking a connection
+	// that is being opened
+	enum ReceiveState {
+		RECEIVE_PENDING, RECEIVE_DONE, RECEIVE_FAILED
+	};
+
+	// Structure to hold a pooled connection to the CSE
+	struct Connection {
+		WiFiClient 		client;
+		bool 			inUse;
+		int 			socket;					// socket of a connection that is being opened, or -1
+	};
+
+	// States of an asynchronous request
+	enum AsyncState {
+		ASYNC_WAITING, ASYNC_CONNECTING, ASYNC_SENDING, ASYNC_RECEIVING
+	};
+
+	// Structure to hold an asynchronous request
+	struct AsyncRequest {
+		long 				handle;
+		String 				method;
+		String 				path;				// target resource of the request
+		String 				request;
+		uint8_t 			*body;				// CBOR-encoded body, or NULL
+		size_t 				bodyLength;
+		CompletionCallback 	callback;
+		AsyncState 			state;
+		Connection 			*connection;		// NULL while waiting for a connection
+		size_t 				sent;				// bytes of the request and body that were sent
+		bool 				reused;
+		int 				attempts;
+		unsigned long 		started;			// millis() when the request was added
+		Response 			response;
+	};
+
+	// Structure to hold a queued content for a ContentInstance
+	struct QueuedContent {
+		String 			content;
+		unsigned long 	timestamp;				// millis() when the content was queued
+	};
+
+	// Structure to hold an upload queue for a Container
+	struct UploadQueue {
+		String 						 path;
+		String 						 contentType;
+		RingBuffer<QueuedContent> 	*contents;
+		int 						 flushSize;
+		unsigned long 				 maxAge;
+		QueuePolicy 				 policy;
+	};
+
+	// Structure to hold a resolved resource in the resource cache
+	struct CachedResource {
+		String 			path;
+		String 			resourceIdentifier;
+		int 			type;
+		int 			storeIndex;				// entry in the EEPROMStore, or -1
+	};
+
 	struct NotificationCBStruct {
 		String 					subscriptionResourceID;
 		NotificationCallback 	callback;
-		// calback
+		NotificationFieldsCallback fieldsCallback;
 	};
 
 	String 										 _host;
 	int											 _port;
+	uint32_t 									 _hostAddress;		// resolved address of _host for non-blocking connects
+	bool 										 _hostResolved;
 	String 										 _basePath;
 	String 										 _originator;
+	unsigned long 								 _timeout;
+	Serialization 								 _serialization;
+	uint8_t 									*_cborBuffer;		// shared buffer for CBOR-encoded request bodies
+	bool 										 _cborBufferInUse;
+	Connection 									 _connections[ONEM2M_MAX_CONNECTIONS];
+	ConnectionStatistics 						 _statistics;
+	LinkedList<UploadQueue *> 					 _uploadQueues;
+	LinkedList<AsyncRequest *> 					 _asyncRequests;
+	long 										 _nextHandle;
+	UploadStatistics 							 _uploadStatistics;
+	bool 										 _cacheEnabled;
+	LinkedList<CachedResource *> 				 _resourceCache;
+	EEPROMStore 								*_cacheStore;
+	int 										 _cacheStoreIndex;
+	int 										 _cacheStoreEntries;
+	CacheStatistics 							 _cacheStatistics;
 	
 	static int 		 							 _jsonSize;			// Size for JSON buffers
 	static HttpServer							*_notificationServer;
@@ -106,15 +408,68 @@ private:
 	OneM2M();	// prevent usage of simple ctor
 
 	String 										 _getPath(String resourceName);
+	String 										 _requestHeader(String method, String path);
+	String 										 _request(String method, String path, String request, int expectedReturnCode, Scanner *scanner = NULL, const uint8_t *body = NULL, size_t bodyLength = 0);
+	String 										 _retrieveRequest(String path, int type, bool scanned = false);
+	String 										 _bodyRequest(String method, String path, int type, String content, CborWriter &writer);
+	String 										 _bodyHeader(String method, String path, int type, size_t length, bool scanned = false);
+	String 										 _contentInstanceRequest(String path, String content, String contentType, CborWriter &writer, bool scanned = false);
+	UploadQueue 								*_getUploadQueue(String path);
+	int 										 _uploadBatch(UploadQueue *queue, int count);
+	static bool 								 _temporaryError(int statusCode);
+	Connection 									*_acquireConnection(bool &reused, bool blocking = true);
+	bool 										 _startConnect(Connection *connection);
+	ReceiveState 								 _checkConnect(Connection *connection);
+	void 										 _releaseConnection(Connection *connection, bool keepAlive);
+	bool 										 _retryable(String method, bool reused, bool sent, const Response &response);
+	bool 										 _readResponse(Connection *connection, Response &response);
+	ReceiveState 								 _receive(Connection *connection, Response &response);
+	long 										 _addAsyncRequest(String method, String path, String request, CompletionCallback callback, const CborWriter *writer = NULL);
+	void 										 _deleteAsyncRequest(AsyncRequest *request);
+	bool 										 _advanceAsyncRequest(AsyncRequest *request);
+	String 										 _cachedResource(String path, String name);
+	void 										 _cacheResource(String path, int type, String resource);
+	void 										 _checkResource(String path, int statusCode, bool deleted);
+	void 										 _storeCachedResource(CachedResource *resource);
 
 	static NotificationCBStruct 				*_getCallback(String resourceIdentifier);
-	static ResourceType 						 _getCallbackType(String resourceIdentifier);
 	static HttpServer::RequestResult			 _notificationRequestHandler(String path, 
 																			 HttpServer::Method method, 
 																			 long length,
 																			 String type, 
 																			 char *content);
-	static String 								 _getRequestContent(WiFiClient client, int expectedReturnCode);
+	static void 								 _resetResponse(Response &response, Scanner *scanner = NULL);
+	static bool 								 _parseResponse(Response &response, char c);
+	static void 								 _responseBody(Response &response, char c);
+	static Content 								 _content(bool state, const ResourceFields &fields);
+	static String 								 _contentInstance(String content, String contentType);
+	static void 								 _scanReset(Scanner &scanner, ResourceFields *fields);
+	static bool 								 _scanDocument(Scanner &scanner, ResourceFields *fields, const char *data, long length, bool cbor = false);
+	static bool 								 _scan(Scanner &scanner, uint8_t c);
+	static bool 								 _scanJson(Scanner &scanner, char c);
+	static bool 								 _scanCbor(Scanner &scanner, uint8_t c);
+	static bool 								 _cborItem(Scanner &scanner, bool indefinite);
+	static void 								 _cborNext(Scanner &scanner);
+	static void 								 _cborClose(Scanner &scanner);
+	static void 								 _cborEndString(Scanner &scanner);
+	static void 								 _cborNumber(Scanner &scanner, uint64_t value, bool negative);
+	static void 								 _cborLiteral(Scanner &scanner, const char *literal);
+	static void 								 _scanAppendEscaped(Scanner &scanner, char c);
+	static void 								 _scanBeginValue(Scanner &scanner, char c, long position);
+	static void 								 _scanEndValue(Scanner &scanner);
+	static void 								 _scanEndString(Scanner &scanner);
+	static void 								 _scanChar(Scanner &scanner, char c);
+	static void 								 _scanAppend(Scanner &scanner, char c);
+	static void 								 _cborInit(CborWriter &writer, uint8_t *buffer, size_t size);
+	static void 								 _cborByte(CborWriter &writer, uint8_t value);
+	static void 								 _cborHead(CborWriter &writer, uint8_t major, uint64_t value);
+	static void 								 _cborText(CborWriter &writer, const char *text, size_t length);
+	static void 								 _cborContentInstance(CborWriter &writer, String content, String contentType);
+	static void 								 _cborBeginText(CborWriter &writer);
+	static void 								 _cborEndText(CborWriter &writer);
+	static void 								 _cborEndLiteral(CborWriter &writer);
+	static String 								 _cborToJson(const uint8_t *data, long length);
+	static size_t 								 _cborToJson(const uint8_t *data, long length, char *buffer, size_t size);
 	static PathElements 						 _splitPath(String path);
 	static String 								 _escapeJSON(String value);
 
@@ -133,6 +488,25 @@ public:
 	//	*originator* are the originator's credentials to access the CSE.
 	OneM2M(String host, int port, String basePath, String originator);
 
+	//	The class's destructor. Open connections to the CSE are closed.
+	~OneM2M();
+
+
+	//	Select the serialization of request bodies. With *CBOR* the bodies of
+	//	create and update requests are encoded as *application/cbor*, and
+	//	*getResourceFields()*, *getLatestContentInstance()* and queued uploads
+	//	accept CBOR-encoded responses. Methods that return a response as a 
+	//	String still accept only JSON-encoded responses. JSON resources that 
+	//	are passed to *createResource()* and *updateResource()* are converted
+	//	to CBOR. The default is *JSON*. The buffer of *ONEM2M_CBOR_BUFFER_SIZE*
+	//	bytes for CBOR-encoded bodies is allocated when *CBOR* is selected, 
+	//	and released when *JSON* is selected again.
+	//	*serialization* is the new serialization.
+	void 			setSerialization(Serialization serialization);
+
+	//	Return the selected serialization of request bodies.
+	Serialization 	serialization(void);
+
 
 	//	Retrieve the CSEBase resource.
 	String 			getCSE(void);
@@ -143,6 +517,8 @@ public:
 	//
 
 	//	Retrieve an AE resource. The AE is created in case it does not exist yet.
+	//	If the resource cache is enabled and the AE was resolved before then
+	//	only a short resource with the resource name, ID and type is returned.
 	//	*path* is the resource path of the aE resource. The last path
 	//	element must be the resource name of the Subscription.
 	//	*appID* is the application ID of that AE.
@@ -166,7 +542,9 @@ public:
 	//
 
 	//	Retrieve a Container resource. The Container is created in case it does
-	//	not exist yet.  
+	//	not exist yet. If the resource cache is enabled and the Container was 
+	//	resolved before then only a short resource with the resource name, ID 
+	//	and type is returned.
 	//	*path* is the resource path of the Container resource. The last path
 	//	element must be the resource name of the Container.
 	String 			getContainer(String path);
@@ -203,6 +581,8 @@ public:
 	//	*path* is the resource path of the Container, NOT the ContentInstance.  
 	//	This method returns a *Content* structure that contains the content, 
 	//	content type, and creation date of the retrieved content instance.
+	//	The response is parsed while it is received and is not kept in memory.
+	//	Contents longer than *ONEM2M_CONTENT_SIZE* - 1 bytes are truncated.
 	Content 		getLatestContentInstance(String path);
 
 	//	Extract the *Content* information from a JSON-encoded resource String.
@@ -212,12 +592,66 @@ public:
 	Content 		contentFromContentInstance(String resource);
 
 
+	//
+	//	Upload Queues
+	//
+
+	//	Add an upload queue for a Container. Contents added with 
+	//	*queueContentInstance()* are kept in the queue and are uploaded as
+	//	ContentInstances by *flushUploadQueues()*. If the CSE is not
+	//	reachable then the contents stay in the queue until a later flush.
+	//	*path* is the resource path of the Container.
+	//	*capacity* is the maximum number of queued contents.
+	//	*flushSize* is the number of queued contents that triggers a flush.
+	//	*maxAge* is the age in milliseconds of the oldest queued content that
+	//	triggers a flush. 0 means that the age is not checked.
+	//	*policy* determines what happens when new content is added to a full
+	//	queue.
+	//	*contentType* is the content type of the ContentInstances.
+	//	The method returns false if a queue for *path* already exists.
+	bool 			addUploadQueue(String path, int capacity, int flushSize, unsigned long maxAge, QueuePolicy policy = DROP_OLDEST, String contentType = "text/plain:0");
+
+	//	Remove the upload queue for a Container. Queued contents are discarded.
+	//	*path* is the resource path of the Container.
+	bool 			removeUploadQueue(String path);
+
+	//	Add a content to the upload queue of a Container.
+	//	*path* is the resource path of the Container.
+	//	*content* is the actual content of the ContentInstance.
+	//	The method returns false if there is no queue for *path*, or if the
+	//	content was rejected because the queue is full.
+	bool 			queueContentInstance(String path, String content);
+
+	//	Upload the queued contents of all queues that reached their size or
+	//	age threshold. The contents are sent in pipelined batches of up to
+	//	*ONEM2M_PIPELINE_DEPTH* requests over a single connection. This method
+	//	must be called regularly, e.g. from a *TaskManager* task.
+	//	Contents that were answered with a permanent error (e.g. 400 or 404)
+	//	are removed from the queue. After a temporary error (403, 408, 429 or
+	//	5xx) the content and all following contents stay queued. Contents are
+	//	delivered at least once: if the connection fails or a temporary error
+	//	is answered in the middle of a batch then the following contents are 
+	//	sent again with a later flush, even if the CSE already created them.
+	//	*force* uploads all queued contents regardless of the thresholds.
+	//	The method returns the number of uploaded ContentInstances.
+	int 			flushUploadQueues(bool force = false);
+
+	//	Return the number of queued contents for a Container.
+	//	*path* is the resource path of the Container.
+	int 			queuedContentInstances(String path);
+
+	//	Return statistics about the queued uploads.
+	const UploadStatistics &uploadStatistics(void);
+
+
 	//
 	//	Subscription
 	//
 
 	//	Retrieve a Subscription resource. The Subscription is created in case
-	//	it does not exist yet. 
+	//	it does not exist yet. If the resource cache is enabled and the 
+	//	Subscription was resolved before then only a short resource with the 
+	//	resource name, ID and type is returned.
 	//	*path* is the resource path of the Subscription resource. The last path
 	//	element must be the resource name of the Subscription.
 	String 			getSubscription(String path);
@@ -254,6 +688,16 @@ public:
 	//	*type* is the resource type of the resource.
 	String 			getResource(String path, int type);
 
+	//	Retrieve a resource from the CSE and extract its most important
+	//	attributes while the response is received. The response itself is not
+	//	kept in memory, so the memory usage does not depend on the size of the
+	//	resource.
+	//	*path* is the resource path of the resource.
+	//	*type* is the resource type of the resource.
+	//	*fields* receives the extracted attributes.
+	//	The method returns true if the resource was retrieved successfully.
+	bool 			getResourceFields(String path, int type, ResourceFields &fields);
+
 	//	Update an existing resource on the CSE.
 	//	*path* is the resource path of the resource.
 	//	*type* is the resource type of the resource.
@@ -265,6 +709,121 @@ public:
 	String			deleteResource(String path);
 
 
+	//
+	//	Asynchronous Requests
+	//
+
+	//	The following methods work like the methods above, but they return
+	//	immediately with a handle for the request. The request is then 
+	//	processed step by step by calling *poll()*, and the *callback* function
+	//	is called with the status code and body of the response when the 
+	//	request is completed. A status code of 0 indicates that the request
+	//	failed or timed out. Several requests can be in flight at the same
+	//	time, one per connection, up to *ONEM2M_ASYNC_CONNECTIONS*. Further 
+	//	requests wait for a free connection. The remaining connections are
+	//	reserved for the synchronous methods. Callbacks are only called by
+	//	*poll()*, never by a synchronous method.
+	//	Each call of *poll()* sends at most *ONEM2M_SEND_SIZE* bytes of a
+	//	request. On the ESP32 new connections are opened without blocking.
+	//	On the ESP8266, which has no non-blocking connect, *poll()* still
+	//	blocks while a new connection is opened, up to the connect timeout of
+	//	the *WiFiClient*. The host name of the CSE is resolved only once, but
+	//	this blocks on all platforms.
+
+	//	Asynchronously create a resource on the CSE. See *createResource()*.
+	long 			createResourceAsync(String path, int type, String content, CompletionCallback callback);
+
+	//	Asynchronously retrieve a resource from the CSE. See *getResource()*.
+	long 			getResourceAsync(String path, int type, CompletionCallback callback);
+
+	//	Asynchronously update a resource on the CSE. See *updateResource()*.
+	long 			updateResourceAsync(String path, int type, String content, CompletionCallback callback);
+
+	//	Asynchronously delete a resource from the CSE. See *deleteResource()*.
+	long 			deleteResourceAsync(String path, CompletionCallback callback);
+
+	//	Process all pending asynchronous requests without blocking. This method
+	//	must be called very regularly, e.g. in the *loop()* function.
+	void 			poll(void);
+
+	//	Cancel a pending asynchronous request. Its callback is not called.
+	//	*handle* is the handle returned when the request was started.
+	//	The method returns false if there is no pending request for *handle*.
+	bool 			cancelRequest(long handle);
+
+	//	Return the number of pending asynchronous requests.
+	int 			pendingRequests(void);
+
+
+	//
+	//	Resource Cache
+	//
+
+	//	The resource cache maps the paths of resources that were resolved by
+	//	*getAE()*, *getContainer()* and *getSubscription()* to their resource IDs
+	//	and types. Following calls for the same path return immediately without
+	//	sending requests to the CSE. A cached resource and its child resources 
+	//	are removed from the cache when a later request for it is answered with
+	//	*403 Forbidden* or *404 Not Found*, or when it is deleted.
+
+	//	Enable the resource cache.
+	//	*store* is an optional EEPROMStore that keeps the cache across restarts.
+	//	Cached resources are then read from the store when the cache is enabled,
+	//	and newly resolved resources are written to the store. The store must
+	//	be initialized before, e.g. by setting a store identifier. NULL keeps
+	//	the cache only in memory.
+	//	*storeIndex* is the first entry of *store* that is used for the cache.
+	//	This entry identifies the CSE (host, port and base path) and the 
+	//	originator. The stored resources are removed when one of them changed.
+	//	*storeEntries* is the number of entries of *store* that are used for 
+	//	the cache, including the first entry. Resources that don't fit into the
+	//	store are only kept in memory.
+	void 			enableResourceCache(EEPROMStore *store = NULL, int storeIndex = 0, int storeEntries = 0);
+
+	//	Disable the resource cache. The cached resources are removed from 
+	//	memory but are kept in the store.
+	void 			disableResourceCache(void);
+
+	//	Remove all resources from the cache and from the store.
+	void 			clearResourceCache(void);
+
+	//	Remove a resource and its child resources from the cache and from the
+	//	store.
+	//	*path* is the resource path of the resource.
+	void 			invalidateResource(String path);
+
+	//	Return statistics about the resource cache, e.g. how many requests to 
+	//	the CSE were saved.
+	const CacheStatistics &cacheStatistics(void);
+
+
+	//
+	//	Connections
+	//
+
+	//	Requests to the CSE are sent over persistent (keep-alive) connections
+	//	that are kept open and reused for following requests. A connection that
+	//	was closed by the CSE is re-opened transparently. If a reused connection
+	//	is closed before a response was received then GET, PUT and DELETE 
+	//	requests are sent once more over a new connection. POST requests are 
+	//	only repeated if they could not be sent completely, so a resource is
+	//	never created twice. Up to *ONEM2M_MAX_CONNECTIONS* connections are 
+	//	kept open at the same time. If all connections are in use then a 
+	//	synchronous request waits for a free one until the timeout expires.
+
+	//	Set the time to wait for a response from the CSE. For asynchronous 
+	//	requests this includes the time waiting for a free connection.
+	//	*timeout* is the time in milliseconds. The default is 10000 ms.
+	void 			setTimeout(unsigned long timeout);
+
+	//	Close all open connections to the CSE.
+	void 			closeConnections(void);
+
+	//	Return statistics about the connections to the CSE, e.g. how many
+	//	requests reused an already open connection.
+	const ConnectionStatistics &connectionStatistics(void);
+
+
 	//////////////////////////////////////////////////////////////////////////
 	//
 	// 	Static Functions
@@ -306,6 +865,17 @@ public:
 	//	The method returns true when the addition / update was successful.
 	static bool 	addNotificationCallback(String subscriptionResourceID, NotificationCallback callback);
 
+	//	Add a callback function for a specific subscription's resource ID that 
+	//	is called with the extracted attributes of a received notification,
+	//	e.g. the content of a new ContentInstance. Unlike *NotificationCallback*
+	//	no copy of the notified resource is created. The method replaces a
+	//	callback function that was added before for the same resource ID.
+	//	*subscriptionResourceID* is the resource ID of the subscription.
+	//	*callback* is a pointer to a function that will receive the 
+	//	notification's attributes. See also *NotificationFieldsCallback*.
+	//	The method returns true when the addition / update was successful.
+	static bool 	addNotificationFieldsCallback(String subscriptionResourceID, NotificationFieldsCallback callback);
+
 	//	Remove the callback function for specific subscription's resource ID.
 	//	*subscriptionResourceID* is the resource ID of the subscription.
 	//	The method returns true when the removal was successful.
@@ -321,16 +891,39 @@ public:
 	// 	Miscellaneous Functions
 	//
 
-	//	Set the size of the internal JSON buffers. Since memory is very limited
-	//	on Arduino devices the buffers for parsing JSON structures are limited
-	//	to *1024* bytes by default. If, for example, large ContentInstance 
-	//	resources are retrieved then the maximum buffer size must be increased.
+	//	Set the size of the internal JSON buffers. This value is no longer
+	//	used, because JSON structures are not parsed into buffers anymore. The
+	//	sizes of extracted attributes are set by *ONEM2M_ID_SIZE* and 
+	//	*ONEM2M_CONTENT_SIZE* instead. Kept for compatibility.
 	//	*size* is the new maximum size for internal JSON buffers.
 	static void 	setJsonMaxSize(int size);
 
-	//	Return the current set size of internal JSON buffers.
+	//	Return the current set size of internal JSON buffers. Kept for 
+	//	compatibility.
 	static int 		jsonMaxSize(void);
 
+	//	Encode a ContentInstance resource into a buffer. The result is the
+	//	same as the body of a request of *addContentInstance()*.
+	//	*serialization* is the serialization of the resource.
+	//	*content* is the actual content of the ContentInstance.
+	//	*contentType* is the content's content type.
+	//	*buffer* receives the encoded resource. JSON resources are terminated
+	//	with a 0 character.
+	//	*size* is the size of *buffer*.
+	//	This method returns the length of the encoded resource, or 0 if the 
+	//	buffer is too small.
+	static size_t 	encodeContentInstance(Serialization serialization, String content, String contentType, uint8_t *buffer, size_t size);
+
+	//	Extract the attributes of an encoded resource without parsing it into
+	//	a document tree.
+	//	*serialization* is the serialization of the resource.
+	//	*data* is the encoded resource.
+	//	*length* is the length of *data*.
+	//	*fields* receives the extracted attributes.
+	//	This method returns true if the resource is well-formed and its 
+	//	resource type, if present, is an integer.
+	static bool 	decodeResource(Serialization serialization, const uint8_t *data, size_t length, ResourceFields &fields);
+
 	//	Get the resource ID from a JSON-encoded resource.
 	//	*resource* is a JSON-encoded resource.
 	//	This method returns the resource ID as a string.
@@ -9,9 +9,25 @@
 
 // TODO: support labels
 
-#include <ArduinoJson.h>
 #include "oneM2M.h"
 
+# if defined(ONEM2M_NONBLOCKING_CONNECT) && defined(ESP32)
+# include <errno.h>
+# include <lwip/sockets.h>
+# include <lwip/netdb.h>
+# elif defined(ONEM2M_NONBLOCKING_CONNECT)
+# include <errno.h>
+# include <fcntl.h>
+# include <netdb.h>
+# include <unistd.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# endif
+
+// Remaining items of an indefinite-length CBOR container
+# define ONEM2M_CBOR_INDEFINITE		0xffff
+
 
 int 		 								 OneM2M::_jsonSize = 1024;
 HttpServer									*OneM2M::_notificationServer = NULL;
@@ -20,10 +36,43 @@ LinkedList<OneM2M::NotificationCBStruct *>	 OneM2M::_notificationCallbacks;
 
 
 OneM2M::OneM2M(String host, int port, String basePath, String originator) {
+	HEAP_SCOPE(HEAP_ONEM2M);
 	_host = host;
 	_port = port;
+	_hostAddress = 0;
+	_hostResolved = false;
 	_basePath = basePath;
 	_originator = originator;
+	_timeout = ONEM2M_TIMEOUT;
+	_serialization = JSON;
+	_cborBuffer = NULL;
+	_cborBufferInUse = false;
+	memset(&_statistics, 0, sizeof(_statistics));
+	memset(&_uploadStatistics, 0, sizeof(_uploadStatistics));
+	_nextHandle = 1;
+	_cacheEnabled = false;
+	_cacheStore = NULL;
+	_cacheStoreIndex = 0;
+	_cacheStoreEntries = 0;
+	memset(&_cacheStatistics, 0, sizeof(_cacheStatistics));
+	for (int i = 0; i < ONEM2M_MAX_CONNECTIONS; i++) {
+		_connections[i].inUse = false;
+		_connections[i].socket = -1;
+	}
+}
+
+
+OneM2M::~OneM2M() {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	while (_asyncRequests.size() > 0) {
+		cancelRequest(_asyncRequests.get(0)->handle);
+	}
+	closeConnections();
+	while (_uploadQueues.size() > 0) {
+		removeUploadQueue(_uploadQueues.get(0)->path);
+	}
+	disableResourceCache();
+	delete[] _cborBuffer;
 }
 
 
@@ -41,10 +90,15 @@ String OneM2M::getCSE(void) {
 //
 
 String OneM2M::getAE(String path, String appID) {
-	String result = retrieveAE(path);
+	String result = _cachedResource(path, "m2m:ae");
+	if (result.length() > 0) {
+		return result;
+	}
+	result = retrieveAE(path);
 	if (result.length() == 0) {
-		return createAE(path, appID);
+		result = createAE(path, appID);
 	}
+	_cacheResource(path, ResourceType::AE, result);
 	return result;
 }
 
@@ -58,7 +112,8 @@ String OneM2M::createAE(String path, String appID) {
 	PathElements elements = _splitPath(path);
 	return createResource(elements.path, 
 				ResourceType::AE, 
-				"{\"m2m:ae\":{\"rn\":\"" + elements.rn + "\",\"api\":\"" + appID + "\", \"rr\":true}}");
+				"{\"m2m:ae\":{\"rn\":\"" + elements.rn + "\",\"api\":\"" + appID + "\", \"rr\":true" + 
+				(_serialization == CBOR ? ",\"csz\":[\"application/cbor\",\"application/json\"]" : "") + "}}");
 }
 
 
@@ -68,10 +123,15 @@ String OneM2M::createAE(String path, String appID) {
 //
 
 String OneM2M::getContainer(String path) {
-	String result = retrieveContainer(path);
+	String result = _cachedResource(path, "m2m:cnt");
+	if (result.length() > 0) {
+		return result;
+	}
+	result = retrieveContainer(path);
 	if (result.length() == 0) {
-		return createContainer(path);
+		result = createContainer(path);
 	}
+	_cacheResource(path, ResourceType::CONTAINER, result);
 	return result;
 }
 
@@ -99,34 +159,126 @@ String OneM2M::addContentInstance(String path, String content) {
 
 
 String OneM2M::addContentInstance(String path, String content, String contentType) {
-	return createResource(path, // no split here. CIN does not provide an rn
-				ResourceType::CONTENTINSTANCE, 
-				"{\"m2m:cin\":{\"cnf\":\"" + contentType + "\",\"con\":\"" + _escapeJSON(content) + "\"}}");
+	CborBody 	body(this);
+	String request = _contentInstanceRequest(path, content, contentType, body.writer);	// no split here. CIN does not provide an rn
+	if (request.length() == 0) {
+		return "";
+	}
+	return _request("POST", path, request, 201, NULL, body.writer.buffer, body.writer.length);
 }
 
 
 OneM2M::Content OneM2M::getLatestContentInstance(String path) {
-	return contentFromContentInstance(getResource(path + "/la", ResourceType::CONTENTINSTANCE));
+	ResourceFields 	fields;
+	bool 			state = getResourceFields(path + "/la", ResourceType::CONTENTINSTANCE, fields);
+	return _content(state, fields);
 }
 
 
 OneM2M::Content OneM2M::contentFromContentInstance(String resource) {
-	OneM2M::Content 	result;
-	DynamicJsonBuffer 	jsonBuffer(_jsonSize);
+	ResourceFields 	fields;
+	Scanner 		scanner;
+	bool 			state = _scanDocument(scanner, &fields, resource.c_str(), resource.length());
+	return _content(state, fields);
+}
 
-	result.state = false;
-	if (resource.length() == 0) {
-		return result;
+
+//
+//	Upload Queues
+//
+
+bool OneM2M::addUploadQueue(String path, int capacity, int flushSize, unsigned long maxAge, QueuePolicy policy, String contentType) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (capacity <= 0 || _getUploadQueue(path) != NULL) {
+		return false;
 	}
-	JsonObject& cin = jsonBuffer.parseObject(resource);
-	if (cin.success()) {
-		result.resourceIdentifier = cin["m2m:cin"]["ri"].as<String>();
-		result.content = cin["m2m:cin"]["con"].as<String>();
-		result.contentFormat = cin["m2m:cin"]["cnf"].as<String>();
-		result.creationTime = cin["m2m:cin"]["ct"].as<String>();
-		result.state = true;
+	UploadQueue *queue = new UploadQueue();
+	queue->path = path;
+	queue->contentType = contentType;
+	queue->contents = new RingBuffer<QueuedContent>(capacity);
+	queue->flushSize = flushSize > capacity ? capacity : flushSize;
+	queue->maxAge = maxAge;
+	queue->policy = policy;
+	_uploadQueues.add(queue);
+	return true;
+}
+
+
+bool OneM2M::removeUploadQueue(String path) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	for (int i = 0; i < _uploadQueues.size(); i++) {
+		UploadQueue *queue = _uploadQueues.get(i);
+		if (queue->path == path) {
+			_uploadQueues.remove(i);
+			delete queue->contents;
+			delete queue;
+			return true;
+		}
 	}
-	return result;
+	return false;
+}
+
+
+bool OneM2M::queueContentInstance(String path, String content) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	UploadQueue *queue = _getUploadQueue(path);
+	if (queue == NULL) {
+		return false;
+	}
+	if (queue->contents->isFull()) {
+		_uploadStatistics.dropped++;
+		if (queue->policy == DROP_NEWEST) {
+			return false;
+		}
+	}
+	QueuedContent qc;
+	qc.content = content;
+	qc.timestamp = millis();
+	queue->contents->add(qc);	// overwrites the oldest content if full
+	_uploadStatistics.queued++;
+	return true;
+}
+
+
+int OneM2M::flushUploadQueues(bool force) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	int uploaded = 0;
+	for (int i = 0; i < _uploadQueues.size(); i++) {
+		UploadQueue *queue = _uploadQueues.get(i);
+		int count = queue->contents->count();
+		if (count == 0) {
+			continue;
+		}
+		if ( ! force && count < queue->flushSize && 
+			 (queue->maxAge == 0 || millis() - queue->contents->getOldest().timestamp < queue->maxAge)) {
+			continue;	// no threshold reached yet
+		}
+
+		// upload the oldest contents in batches until the queue is empty, or 
+		// the CSE is not reachable
+		while ((count = queue->contents->count()) > 0) {
+			int batch = count < ONEM2M_PIPELINE_DEPTH ? count : ONEM2M_PIPELINE_DEPTH;
+			unsigned long before = _uploadStatistics.uploaded;
+			int answered = _uploadBatch(queue, batch);
+			queue->contents->sliceTail(answered);	// remove the oldest, answered contents
+			uploaded += _uploadStatistics.uploaded - before;
+			if (answered < batch) {
+				break;	// try again with the next flush
+			}
+		}
+	}
+	return uploaded;
+}
+
+
+int OneM2M::queuedContentInstances(String path) {
+	UploadQueue *queue = _getUploadQueue(path);
+	return queue != NULL ? queue->contents->count() : 0;
+}
+
+
+const OneM2M::UploadStatistics &OneM2M::uploadStatistics(void) {
+	return _uploadStatistics;
 }
 
 
@@ -135,10 +287,15 @@ OneM2M::Content OneM2M::contentFromContentInstance(String resource) {
 //
 
 String OneM2M::getSubscription(String path) {
-	String result = retrieveSubscription(path);
+	String result = _cachedResource(path, "m2m:sub");
+	if (result.length() > 0) {
+		return result;
+	}
+	result = retrieveSubscription(path);
 	if (result.length() == 0) {
-		return addSubscription(path);
+		result = addSubscription(path);
 	}
+	_cacheResource(path, ResourceType::SUBSCRIPTION, result);
 	return result;
 }
 
@@ -176,343 +333,2243 @@ String OneM2M::getSubscriptionNotify(String path, NotificationCallback callback)
 
 
 String OneM2M::createResource(String path, int type, String content) {
-	WiFiClient client;
-
-	if ( ! client.connect(_host.c_str(), _port)) {
-		Serial.println("connection failed");
-		client.stop();
+	CborBody 	body(this);
+	String request = _bodyRequest("POST", path, type, content, body.writer);
+	if (request.length() == 0) {
 		return "";
 	}
-
-	String request =	"POST " + path + " HTTP/1.1\r\n" +
-						"Host: " + _host + "\r\n" +
-						"X-M2M-Origin: " + _originator + "\r\n" +
-						"Content-Type: application/json;ty=" + type + "\r\n" +
-						"Content-Length: " +  content.length() + "\r\n" +
-						"Accept: application/json\r\n" +
-						"Connection: close\r\n\r\n" + 
-						content;
-	//Serial.println(request + "\n");
-	client.print(request);
-	return _getRequestContent(client, 201);
+	return _request("POST", path, request, 201, NULL, body.writer.buffer, body.writer.length);
 }
 
 
 String OneM2M::getResource(String path, int type) {
-	WiFiClient client;
+ 	return _request("GET", path, _retrieveRequest(path, type), 200);
+}
 
-	if ( ! client.connect(_host.c_str(), _port)) {
-		Serial.println("connection failed");
-		client.stop();
-		return "";
-	}
-	String request =	"GET " + _getPath(path) + " HTTP/1.1\r\n" +
-						"Host: " + _host + "\r\n" +
-						"X-M2M-Origin: " + _originator + "\r\n" +
-						"Content-Type: application/json;ty=" + type + "\r\n" +
-						"Accept: application/json\r\n" +
-						"Connection: close\r\n\r\n";
-	client.print(request);
- 	return _getRequestContent(client, 200);
+
+bool OneM2M::getResourceFields(String path, int type, ResourceFields &fields) {
+	Scanner scanner;
+	_scanReset(scanner, &fields);
+	bool result = _request("GET", path, _retrieveRequest(path, type, true), 200, &scanner).length() > 0;
+	return result && scanner.state == SCAN_NEXT && scanner.depth == 0;
 }
 
 
 String OneM2M::updateResource(String path, int type, String content) {
-	WiFiClient client;
-
-	if ( ! client.connect(_host.c_str(), _port)) {
-		Serial.println("connection failed");
-		client.stop();
+	CborBody 	body(this);
+	String request = _bodyRequest("PUT", path, type, content, body.writer);
+	if (request.length() == 0) {
 		return "";
 	}
-
-	String request =	"PUT " + path + " HTTP/1.1\r\n" +
-						"Host: " + _host + "\r\n" +
-						"X-M2M-Origin: " + _originator + "\r\n" +
-						"Content-Type: application/json;ty=" + type + "\r\n" +
-						"Content-Length: " +  content.length() + "\r\n" +
-						"Accept: application/json\r\n" +
-						"Connection: close\r\n\r\n" + 
-						content;
-	// Serial.println(request + "\n");
-	client.print(request);
-	return _getRequestContent(client, 200);
+	return _request("PUT", path, request, 200, NULL, body.writer.buffer, body.writer.length);
 }
 
 
 String OneM2M::deleteResource(String path) {
-	WiFiClient client;
-
-	if ( ! client.connect(_host.c_str(), _port)) {
-		Serial.println("connection failed");
-		client.stop();
-		return "";
-	}
-
-	String request =	"DELETE " + path + " HTTP/1.1\r\n" +
-						"Host: " + _host + "\r\n" +
-						"X-M2M-Origin: " + _originator + "\r\n" +
-						"Content-Type: application/json\r\n" +
-						"Connection: close\r\n\r\n";
+	String request =	_requestHeader("DELETE", path) +
+						"Content-Type: application/json\r\n\r\n";
 	// Serial.println(request + "\n");
-	client.print(request);
-	return _getRequestContent(client, 200);
+	return _request("DELETE", path, request, 200);
 }
 
 
 //
-//	Internal helper functions
+//	Serialization
 //
 
+void OneM2M::setSerialization(Serialization serialization) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	_serialization = serialization;
+	if (serialization == CBOR && _cborBuffer == NULL) {
+		_cborBuffer = new uint8_t[ONEM2M_CBOR_BUFFER_SIZE];
+	} else if (serialization == JSON && ! _cborBufferInUse) {
+		delete[] _cborBuffer;
+		_cborBuffer = NULL;
+	}
+}
 
-// Normalize path
-String OneM2M::_getPath(String resourceName) {
-	String t = _basePath + resourceName;
-	t.replace("//", "/");
-	return t;
+
+OneM2M::Serialization OneM2M::serialization(void) {
+	return _serialization;
 }
 
 
-//////////////////////////////////////////////////////////////////////////////
 //
-//	Static class function
+//	Resource Cache
 //
 
-//
-//	Miscellaneous functions
-//
+void OneM2M::enableResourceCache(EEPROMStore *store, int storeIndex, int storeEntries) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	disableResourceCache();
+	_cacheEnabled = true;
+	_cacheStore = store;
+	_cacheStoreIndex = storeIndex;
+	_cacheStoreEntries = store != NULL ? storeEntries : 0;
+
+	// The first entry identifies the CSE and the originator of the stored
+	// resources. The stored resources are removed if they changed.
+	if (_cacheStore != NULL) {
+		String identity = _host + ":" + String(_port) + _basePath + " " + _originator;
+		if (_cacheStoreEntries < 2 || identity.length() >= _cacheStore->getEntrySize()) {
+			_cacheStore = NULL;		// keep the cache only in memory
+			_cacheStoreEntries = 0;
+		} else {
+			bool changed = _cacheStore->getString(_cacheStoreIndex) != identity;
+			_cacheStoreIndex++;
+			_cacheStoreEntries--;
+			if (changed) {
+				clearResourceCache();
+				_cacheStore->putString(_cacheStoreIndex - 1, identity);
+			}
+		}
+	}
 
-void OneM2M::setJsonMaxSize(int value) {
-	_jsonSize = value;
+	// read the resources from the store. Each entry has the format "<path> <type> <ri>"
+	for (int i = _cacheStoreIndex; _cacheStore != NULL && i < _cacheStoreIndex + _cacheStoreEntries; i++) {
+		String entry = _cacheStore->getString(i);
+		int typeIdx = entry.indexOf(' ');
+		int riIdx = entry.indexOf(' ', typeIdx + 1);
+		if (typeIdx <= 0 || riIdx < 0 || riIdx + 1 >= (int)entry.length()) {
+			continue;	// empty or invalid entry
+		}
+		CachedResource *resource = new CachedResource();
+		resource->path = entry.substring(0, typeIdx);
+		resource->type = entry.substring(typeIdx + 1, riIdx).toInt();
+		resource->resourceIdentifier = entry.substring(riIdx + 1);
+		resource->storeIndex = i;
+		_resourceCache.add(resource);
+	}
 }
 
 
-int OneM2M::jsonMaxSize(void) {
-	return _jsonSize;
+void OneM2M::disableResourceCache(void) {
+	while (_resourceCache.size() > 0) {
+		delete _resourceCache.get(0);
+		_resourceCache.remove(0);
+	}
+	_cacheEnabled = false;
+	_cacheStore = NULL;
+	_cacheStoreIndex = 0;
+	_cacheStoreEntries = 0;
 }
 
 
-String OneM2M::getResourceIdentifier(String resource) {
-	DynamicJsonBuffer 	jsonBuffer(OneM2M::jsonMaxSize());
-
-	JsonObject& json = jsonBuffer.parseObject(resource);
-	if (json.success()) {
-		JsonObject::iterator it=json.begin(); // only first one
-		return json[it->key]["ri"].as<String>()	;
+void OneM2M::clearResourceCache(void) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	while (_resourceCache.size() > 0) {
+		delete _resourceCache.get(0);
+		_resourceCache.remove(0);
+	}
+	for (int i = _cacheStoreIndex; _cacheStore != NULL && i < _cacheStoreIndex + _cacheStoreEntries; i++) {
+		if (_cacheStore->getString(i).length() > 0) {	// avoid unnecessary writes to the flash memory
+			_cacheStore->putString(i, "");
+		}
 	}
-	return "";
 }
 
 
-// Escape JSON special chars
-String OneM2M::_escapeJSON(String value) {
-	String result = value;
-
-	result.replace("\\", "\\\\");
-	result.replace("\n", "\\n");
-	result.replace("\r", "\\r");
-	result.replace("\t", "\\t");
-	result.replace("\"", "\\\"");
-	// a bit of optimization: don't handle chars that are likely not used at all.
-	// \b  Backspace (ascii code 08)
-	// \f  Form feed (ascii code 0C)
-	return result;
+void OneM2M::invalidateResource(String path) {
+	for (int i = 0; i < _resourceCache.size(); ) {
+		CachedResource *resource = _resourceCache.get(i);
+		if (resource->path != path && ! resource->path.startsWith(path + "/")) {
+			i++;
+			continue;
+		}
+		if (resource->storeIndex >= 0 && _cacheStore != NULL) {
+			_cacheStore->putString(resource->storeIndex, "");
+		}
+		_resourceCache.remove(i);
+		delete resource;
+		_cacheStatistics.invalidations++;
+	}
 }
 
 
-// Split the path in the resource path and the name
-OneM2M::PathElements OneM2M::_splitPath(String path) {
-	PathElements elements;
-	int l = path.lastIndexOf("/");
-	elements.path = path.substring(0,l);
-	elements.rn = path.substring(l+1);
-	return elements;
+const OneM2M::CacheStatistics &OneM2M::cacheStatistics(void) {
+	return _cacheStatistics;
 }
 
 
-// Get the content of a request answer
-String OneM2M::_getRequestContent(WiFiClient client, int expectedReturnCode) {
-	String result = "";
-	String status = "";
+//
+//	Connections
+//
 
-	unsigned long timeout = millis() + 10000; // TODO Config
-	while (client.available() == 0) {
-		if (OneM2M::_notificationServer != NULL) {	// if notifications enabled call the server to receive srq requests.
-			checkNotifications();
-		}
-		if (timeout < millis()) { 
-			Serial.println(">>> Client Timeout !");
-			client.stop();
-			return "";
-		}
- 	}
+void OneM2M::setTimeout(unsigned long timeout) {
+	_timeout = timeout;
+}
 
-	if (client.available()){
-		status = client.readStringUntil('\n');
-		//Serial.println(status);
-	}
-	if (status.indexOf(String(expectedReturnCode)) == -1) {	// error
-		client.stop();
-		return "";
-	}
-	// read header
-	while(client.available()){
-		String x = client.readStringUntil('\n');
-		x.trim();
-		if (x.length() == 0) {	// end of header reached
-			break;
-		}
-	}
-	// read content 
-	while(client.available()){
-		String x = client.readStringUntil('\n');
-		x.trim();
-		result += x; 
-	}
-	client.stop();
-	// Serial.println("Result:");
-	// Serial.println(result);
 
-	// The following is a hack to fill the buffer in case the call was successul
-	// but the request returns an empty answer. This happens, for example, when
-	// a resource is deleted.
-	if (result.length() == 0) {
-		result = "ok";
+void OneM2M::closeConnections(void) {
+	for (int i = 0; i < ONEM2M_MAX_CONNECTIONS; i++) {
+		_releaseConnection(&_connections[i], false);
 	}
-	return result;
 }
 
 
-//////////////////////////////////////////////////////////////////////////////
+const OneM2M::ConnectionStatistics &OneM2M::connectionStatistics(void) {
+	return _statistics;
+}
+
 
 //
-//	Notification Functions 
+//	Internal helper functions
 //
 
 
-void OneM2M::setupNotifications() {
-	OneM2M::setupNotifications(WiFi.localIP().toString(), 1440, "/onem2m/Notifications");
+// Normalize path
+String OneM2M::_getPath(String resourceName) {
+	String t = _basePath + resourceName;
+	t.replace("//", "/");
+	return t;
 }
 
 
-void OneM2M::setupNotifications(String host, int port, String path) {
-	if (_notificationServer) {
-		return;
-	}
-	_notificationURL = "http://" + host + ":" + String(port) + path;
-	_notificationServer = new HttpServer(port);
-	_notificationServer->addHandler(path, HttpServer::POST, _notificationRequestHandler);
+// Return the common first lines of a request
+String OneM2M::_requestHeader(String method, String path) {
+	return	method + " " + path + " HTTP/1.1\r\n" +
+			"Host: " + _host + "\r\n" +
+			"X-M2M-Origin: " + _originator + "\r\n" +
+			"Connection: keep-alive\r\n";
 }
 
 
-void OneM2M::shutdownNotifications(void) {
-	if (_notificationServer == NULL) {
-		return;
-	}
-	delete _notificationServer;
-	_notificationCallbacks.clear();
-	_notificationServer = NULL;
+// Return a complete retrieve request. A *scanned* response is not returned
+// as a String, so it may be CBOR-encoded.
+String OneM2M::_retrieveRequest(String path, int type, bool scanned) {
+	return	_requestHeader("GET", _getPath(path)) +
+			"Content-Type: application/json;ty=" + type + "\r\n" +
+			"Accept: application/" + (scanned && _serialization == CBOR ? "cbor" : "json") + "\r\n\r\n";
 }
 
 
-bool OneM2M::addNotificationCallback(String subscriptionResourceID, NotificationCallback callback) {
-	if (subscriptionResourceID != NULL && subscriptionResourceID.length() == 0) {
-		return false;
+// Return the header of a create or update request, including the empty line
+String OneM2M::_bodyHeader(String method, String path, int type, size_t length, bool scanned) {
+	return	_requestHeader(method, path) +
+			"Content-Type: application/" + (_serialization == CBOR ? "cbor" : "json") + ";ty=" + type + "\r\n" +
+			"Content-Length: " + length + "\r\n" +
+			"Accept: application/" + (scanned && _serialization == CBOR ? "cbor" : "json") + "\r\n\r\n";
+}
+
+
+// Return a create or update request for a JSON-encoded resource. For JSON
+// serialization the request is complete. For CBOR serialization the 
+// resource is converted and written to *writer*, and only the header is
+// returned. An empty string is returned if the resource doesn't fit into
+// *writer*'s buffer.
+String OneM2M::_bodyRequest(String method, String path, int type, String content, CborWriter &writer) {
+	if (_serialization == JSON) {
+		return _bodyHeader(method, path, type, content.length()) + content;
 	}
-	NotificationCBStruct *cb =  _getCallback(subscriptionResourceID);
-	if (cb) {
-		cb->callback = callback;
-		return true;
+	Scanner scanner;
+	_scanReset(scanner, NULL);
+	scanner.writer = &writer;
+	for (unsigned int i = 0; i < content.length(); i++) {
+		if ( ! _scanJson(scanner, content[i])) {
+			return "";
+		}
 	}
-	cb = new NotificationCBStruct();
-	cb->subscriptionResourceID = subscriptionResourceID;
-	cb->callback = callback;
-	_notificationCallbacks.add(cb);
-	return true;
+	_scanJson(scanner, ' ');	// complete a top-level literal
+	if (writer.overflow || scanner.state != SCAN_NEXT || scanner.depth != 0) {
+		return "";
+	}
+	return _bodyHeader(method, path, type, writer.length);
 }
 
 
-bool OneM2M::removeNotificationCallback(String subscriptionResourceID) {
-	if (subscriptionResourceID != NULL && subscriptionResourceID.length() == 0) {
-		return false;
+// Return a create request for a ContentInstance. See _bodyRequest(). The 
+// CBOR-encoded resource is written directly to *writer*.
+String OneM2M::_contentInstanceRequest(String path, String content, String contentType, CborWriter &writer, bool scanned) {
+	if (_serialization == JSON) {
+		String body = _contentInstance(content, contentType);
+		return _bodyHeader("POST", path, ResourceType::CONTENTINSTANCE, body.length(), scanned) + body;
 	}
-	for (int i = 0; i < _notificationCallbacks.size(); i++) {
-		NotificationCBStruct *cb = _notificationCallbacks.get(i);
-		if (cb->subscriptionResourceID == subscriptionResourceID) {
-			_notificationCallbacks.remove(i);
-			return true;
-		} 
+	_cborContentInstance(writer, content, contentType);
+	if (writer.overflow) {
+		return "";
 	}
-	return false;
+	return _bodyHeader("POST", path, ResourceType::CONTENTINSTANCE, writer.length, scanned);
 }
 
 
-//	Check for notification server activities
-void OneM2M::checkNotifications(void) {
-	if (_notificationServer != NULL) {
-		_notificationServer->check();
+// Return a JSON-encoded ContentInstance resource
+String OneM2M::_contentInstance(String content, String contentType) {
+	return "{\"m2m:cin\":{\"cnf\":\"" + contentType + "\",\"con\":\"" + _escapeJSON(content) + "\"}}";
+}
+
+
+// Return a short resource for a cached resource, or an empty string if
+// the resource is not in the cache.
+String OneM2M::_cachedResource(String path, String name) {
+	if ( ! _cacheEnabled) {
+		return "";
+	}
+	for (int i = 0; i < _resourceCache.size(); i++) {
+		CachedResource *resource = _resourceCache.get(i);
+		if (resource->path == path) {
+			_cacheStatistics.hits++;
+			_cacheStatistics.roundTripsSaved++;
+			return "{\"" + name + "\":{\"rn\":\"" + _splitPath(path).rn + 
+				   "\",\"ri\":\"" + resource->resourceIdentifier + 
+				   "\",\"ty\":" + resource->type + "}}";
+		}
 	}
+	_cacheStatistics.misses++;
+	return "";
 }
 
 
-// Handle the internal interpretation and routing of notifications
-HttpServer::RequestResult OneM2M::_notificationRequestHandler(String path, 
-															  HttpServer::Method method, 
-															  long length,
-															  String type, 
-															  char *content) {
-	DynamicJsonBuffer 			jsonBuffer(OneM2M::jsonMaxSize());
-	HttpServer::RequestResult	result;
-	result.returnCode = 200;
-	result.attributes = "X-M2M-RSC: 2000";
+// Add a resolved resource to the cache
+void OneM2M::_cacheResource(String path, int type, String resource) {
+	if ( ! _cacheEnabled || resource.length() == 0) {
+		return;
+	}
+	HEAP_SCOPE(HEAP_ONEM2M);
+	String ri = getResourceIdentifier(resource);
+	if (ri.length() == 0) {
+		return;
+	}
+	CachedResource *cr = new CachedResource();
+	cr->path = path;
+	cr->resourceIdentifier = ri;
+	cr->type = type;
+	cr->storeIndex = -1;
+	_resourceCache.add(cr);
+	_storeCachedResource(cr);
+}
 
-	JsonObject& json = jsonBuffer.parseObject(content);
-	if (json.success()) {
-		if (json.containsKey("m2m:sgn")) {
-			// verification request
-			if (json["m2m:sgn"]["m2m:vrq"]) {
-				return result;
-			}
-			// notification request 
-			String sur = json["m2m:sgn"]["m2m:sur"];
-			String rep = json["m2m:sgn"]["m2m:nev"]["m2m:rep"];
-			if (sur && rep) {
-				NotificationCBStruct *cb = _getCallback(sur);
-				if (cb && cb->callback) {
-					(*cb->callback)(sur, _getCallbackType(rep), rep); 
-				}
-				return result;
-			}
+
+// Write a cached resource to a free entry of the store. The resource is 
+// only kept in memory if there is no free entry, or if it is too long.
+void OneM2M::_storeCachedResource(CachedResource *resource) {
+	String entry = resource->path + " " + resource->type + " " + resource->resourceIdentifier;
+	if (_cacheStore == NULL || entry.length() >= _cacheStore->getEntrySize()) {
+		return;
+	}
+	for (int i = _cacheStoreIndex; i < _cacheStoreIndex + _cacheStoreEntries; i++) {
+		bool used = false;
+		for (int j = 0; j < _resourceCache.size() && ! used; j++) {
+			used = _resourceCache.get(j)->storeIndex == i;
+		}
+		if ( ! used) {
+			_cacheStore->putString(i, entry);
+			resource->storeIndex = i;
+			return;
 		}
 	}
-	result.returnCode = 400;
-	result.attributes = "X-M2M-RSC: 4000";
-	return result;
 }
 
 
-// search and return a callback struct
-OneM2M::NotificationCBStruct *OneM2M::_getCallback(String resourceIdentifier) {
-	for (int i = 0; i < _notificationCallbacks.size(); i++) {
-		NotificationCBStruct *cb = _notificationCallbacks.get(i);
-		if (cb->subscriptionResourceID == resourceIdentifier) {
-			return cb;
-		} 
+// Invalidate cached resources after a response from the CSE. A resource 
+// that is not found or not accessible anymore, or that was deleted, is 
+// removed from the cache together with its child resources.
+void OneM2M::_checkResource(String path, int statusCode, bool deleted) {
+	if (_cacheEnabled && (statusCode == 403 || statusCode == 404 || (deleted && statusCode == 200))) {
+		invalidateResource(path);
+	}
+}
+
+
+// Return the upload queue for a Container, or NULL
+OneM2M::UploadQueue *OneM2M::_getUploadQueue(String path) {
+	for (int i = 0; i < _uploadQueues.size(); i++) {
+		UploadQueue *queue = _uploadQueues.get(i);
+		if (queue->path == path) {
+			return queue;
+		}
 	}
 	return NULL;
 }
 
 
-// search and return a callback struct
-OneM2M::ResourceType OneM2M::_getCallbackType(String resource) {
-	DynamicJsonBuffer 	jsonBuffer(OneM2M::jsonMaxSize());
+// Upload the *count* oldest contents of a queue. All requests are sent at
+// once over the same connection (HTTP pipelining), then the responses are
+// read in the same order. The method returns the number of contents that
+// were answered by the CSE, either successfully or with a permanent error.
+// Contents that were not answered (e.g. because the CSE is not reachable)
+// remain in the queue. A temporary error stops the batch, and the content
+// and all following contents remain in the queue as well.
+// The batch is only sent again over a new connection if not even the first
+// request could be written to a reused connection. Otherwise the CSE might
+// have created some of the ContentInstances already, and the remaining
+// contents are sent with the next flush (at-least-once delivery).
+int OneM2M::_uploadBatch(UploadQueue *queue, int count) {
+	Response 	response;
+	Scanner 	discard;	// the responses' bodies are not needed
+	CborBody 	body(this);
+
+	discard.fields = NULL;
+	for (int attempt = 0; attempt < 2; attempt++) {
+		bool reused;
+		Connection *connection = _acquireConnection(reused);
+		if (connection == NULL) {
+			return 0;
+		}
+		_uploadStatistics.batches++;
+
+		// send all requests
+		int written = 0;	// requests that were written completely
+		for (int i = 0; i < count && written == i; i++) {
+			body.reset();
+			String request = _contentInstanceRequest(queue->path, queue->contents->get(i).content, queue->contentType, body.writer, true);
+			if (request.length() == 0) {	// too long for the CBOR buffer
+				count = i;
+				break;
+			}
+			if (connection->client.print(request) == request.length() &&
+				(body.writer.length == 0 || connection->client.write(body.writer.buffer, body.writer.length) == body.writer.length)) {
+				written++;
+			}
+			_statistics.requests++;
+		}
+		if (count == 0) {	// the oldest content can never be sent
+			_releaseConnection(connection, true);
+			_uploadStatistics.rejected++;
+			return 1;
+		}
 
-	JsonObject& json = jsonBuffer.parseObject(resource);
-	if (json.success()) {
-		JsonObject::iterator it=json.begin(); // only first one
-		return (OneM2M::ResourceType)json[it->key]["ty"].as<int>()	;
-	}
-	return OneM2M::ResourceType::UNKNOWN;
+		// read the responses of the written requests
+		int answered = 0;
+		_resetResponse(response, &discard);
+		while (answered < written) {
+			_resetResponse(response, &discard);
+			if ( ! _readResponse(connection, response)) {
+				break;
+			}
+			_checkResource(queue->path, response.statusCode, false);
+			if (_temporaryError(response.statusCode)) {
+				_uploadStatistics.deferred++;
+				break;
+			}
+			answered++;
+			if (response.statusCode == 201) {
+				_uploadStatistics.uploaded++;
+			} else {
+				_uploadStatistics.rejected++;
+			}
+			if ( ! response.keepAlive) {	// CSE closes the connection, further requests are not answered
+				break;
+			}
+		}
+		_releaseConnection(connection, answered == count && response.keepAlive);
+
+		if (answered == 0 && _retryable("POST", reused, written > 0, response)) {
+			_statistics.reconnects++;
+			continue;	// try again on a new connection
+		}
+		return answered;
+	}
+	return 0;
+}
+
+
+// Return whether an error status code of the CSE is temporary, e.g. because
+// the CSE is overloaded or restarting, so the request can succeed later
+bool OneM2M::_temporaryError(int statusCode) {
+	return statusCode == 403 || statusCode == 408 || statusCode == 429 || statusCode >= 500;
+}
+
+
+// Send a request to the CSE over a pooled connection. The body of the 
+// response is returned, or an empty string in case of an error.
+// If a *scanner* is given then the body is passed to the scanner while it
+// is received instead of being returned. A CBOR-encoded *body* is sent after
+// the *request*.
+// If a reused connection was closed by the CSE before anything was received
+// (e.g. because of an idle timeout) then the request is sent again once
+// over a new connection, see _retryable().
+String OneM2M::_request(String method, String path, String request, int expectedReturnCode, Scanner *scanner, const uint8_t *body, size_t bodyLength) {
+	HEAP_SCOPE(HEAP_ONEM2M);	// all synchronous requests
+	Response response;
+
+	_statistics.requests++;
+	for (int attempt = 0; attempt < 2; attempt++) {
+		bool reused;
+		Connection *connection = _acquireConnection(reused);
+		if (connection == NULL) {
+			return "";
+		}
+		_resetResponse(response, scanner);
+		bool sent = connection->client.print(request) == request.length() &&
+					(bodyLength == 0 || connection->client.write(body, bodyLength) == bodyLength);
+		bool received = sent && _readResponse(connection, response);
+		_releaseConnection(connection, received && response.keepAlive);
+
+		if ( ! received) {
+			if (_retryable(method, reused, sent, response)) {
+				_statistics.reconnects++;
+				continue;	// try again on a new connection
+			}
+			return "";
+		}
+		_checkResource(path, response.statusCode, method == "DELETE");
+		if (response.statusCode != expectedReturnCode) {	// error
+			return "";
+		}
+		// The following is a hack to fill the buffer in case the call was successul
+		// but the request returns an empty answer. This happens, for example, when
+		// a resource is deleted.
+		if (response.body.length() == 0) {
+			return "ok";
+		}
+		return response.body;
+	}
+	return "";
+}
+
+
+// Return true if a request that failed on a reused connection can be sent
+// again over a new connection. This is the case if the connection was 
+// closed by the CSE before any response was received, and if the request
+// was not sent completely or is idempotent. A POST request that was sent 
+// completely is not repeated, because the CSE might have created the 
+// resource already.
+bool OneM2M::_retryable(String method, bool reused, bool sent, const Response &response) {
+	return reused && response.state == STATUS && response.line.length() == 0 && ( ! sent || method != "POST");
+}
+
+
+// Get a connection to the CSE. An open idle connection is preferred, 
+// otherwise a new connection is opened. NULL is returned if no connection is
+// free or the connection could not be established. 
+// The asynchronous requests are never processed here, so no completion 
+// callback runs inside a synchronous method. These rely on the connections
+// that are reserved for them, see ONEM2M_ASYNC_CONNECTIONS.
+// If *blocking* is false and the platform supports it then a new connection
+// is only started, and it is in progress while its socket is not -1, see
+// _checkConnect().
+OneM2M::Connection *OneM2M::_acquireConnection(bool &reused, bool blocking) {
+	for (int i = 0; i < ONEM2M_MAX_CONNECTIONS; i++) {
+		Connection *c = &_connections[i];
+		if ( ! c->inUse && c->client.connected()) {
+			c->inUse = true;
+			reused = true;
+			_statistics.reuses++;
+			return c;
+		}
+	}
+	for (int i = 0; i < ONEM2M_MAX_CONNECTIONS; i++) {
+		Connection *c = &_connections[i];
+		if ( ! c->inUse) {
+			c->client.stop();
+			reused = false;
+# ifdef ONEM2M_NONBLOCKING_CONNECT
+			if ( ! blocking) {
+				if ( ! _startConnect(c)) {
+					_statistics.failures++;
+					return NULL;
+				}
+				c->inUse = true;
+				return c;
+			}
+# endif
+			if ( ! c->client.connect(_host.c_str(), _port)) {
+				Serial.println("connection failed");
+				c->client.stop();
+				_statistics.failures++;
+				return NULL;
+			}
+			c->client.setNoDelay(true);
+			c->inUse = true;
+			_statistics.connects++;
+			return c;
+		}
+	}
+	return NULL;
+}
+
+
+// Start to open a connection without blocking. The host name is resolved
+// only once, and this blocks. This method returns false if the connection
+// could not be started.
+bool OneM2M::_startConnect(Connection *connection) {
+# ifdef ONEM2M_NONBLOCKING_CONNECT
+	if ( ! _hostResolved) {
+		struct addrinfo hints;
+		struct addrinfo *result = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(_host.c_str(), NULL, &hints, &result) != 0 || result == NULL) {
+			Serial.println("connection failed");
+			return false;
+		}
+		_hostAddress = ((struct sockaddr_in *)result->ai_addr)->sin_addr.s_addr;
+		_hostResolved = true;
+		freeaddrinfo(result);
+	}
+
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	if (s < 0) {
+		Serial.println("connection failed");
+		return false;
+	}
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(_port);
+	address.sin_addr.s_addr = _hostAddress;
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+	if (connect(s, (struct sockaddr *)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+		Serial.println("connection failed");
+		close(s);
+		_hostResolved = false;	// resolve again, the address might have changed
+		return false;
+	}
+	connection->socket = s;
+	return true;
+# else
+	return false;
+# endif
+}
+
+
+// Check without blocking whether a connection that was started by 
+// _startConnect() is open. An open connection is handed to the 
+// connection's WiFiClient.
+OneM2M::ReceiveState OneM2M::_checkConnect(Connection *connection) {
+# ifdef ONEM2M_NONBLOCKING_CONNECT
+	int 			s = connection->socket;
+	fd_set 			writable;
+	struct timeval 	timeout = { 0, 0 };
+	FD_ZERO(&writable);
+	FD_SET(s, &writable);
+	int ready = select(s + 1, NULL, &writable, NULL, &timeout);
+	if (ready == 0 || (ready < 0 && errno == EINTR)) {
+		return RECEIVE_PENDING;
+	}
+	int 		error = 0;
+	socklen_t 	length = sizeof(error);
+	connection->socket = -1;
+	if (ready < 0 || getsockopt(s, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+		Serial.println("connection failed");
+		close(s);
+		_hostResolved = false;
+		_statistics.failures++;
+		return RECEIVE_FAILED;
+	}
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) & ~O_NONBLOCK);
+	connection->client = WiFiClient(s);
+	connection->client.setNoDelay(true);
+	_statistics.connects++;
+	return RECEIVE_DONE;
+# else
+	return RECEIVE_FAILED;
+# endif
+}
+
+
+// Return a connection to the pool. The connection is closed if it cannot
+// be used for further requests.
+void OneM2M::_releaseConnection(Connection *connection, bool keepAlive) {
+# ifdef ONEM2M_NONBLOCKING_CONNECT
+	if (connection->socket >= 0) {	// still being opened
+		close(connection->socket);
+		connection->socket = -1;
+	}
+# endif
+	if ( ! keepAlive) {
+		connection->client.stop();
+	}
+	connection->inUse = false;
+}
+
+
+// Read and parse a response from a connection. This method returns true
+// when a complete response was received.
+bool OneM2M::_readResponse(Connection *connection, Response &response) {
+	unsigned long start = millis();
+
+	while (true) {
+		switch (_receive(connection, response)) {
+			case RECEIVE_DONE:		return true;
+			case RECEIVE_FAILED:	return false;
+			case RECEIVE_PENDING:	break;
+		}
+		if (OneM2M::_notificationServer != NULL) {	// if notifications enabled call the server to receive srq requests.
+			checkNotifications();
+		}
+		if (millis() - start > _timeout) { 
+			Serial.println(">>> Client Timeout !");
+			_statistics.timeouts++;
+			response.keepAlive = false;
+			return false;
+		}
+		yield();
+ 	}
+}
+
+
+// Parse the data of a response that is available on a connection, without
+// waiting for more data.
+OneM2M::ReceiveState OneM2M::_receive(Connection *connection, Response &response) {
+	WiFiClient &client = connection->client;
+
+	int available = client.available();
+	while (available-- > 0) {
+		if (_parseResponse(response, client.read())) {
+			return RECEIVE_DONE;
+		}
+	}
+	if (client.available() == 0 && ! client.connected()) {
+		if (response.state == BODY && response.contentLength < 0) {	// body is delimited by closing the connection
+			response.state = DONE;
+			return RECEIVE_DONE;
+		}
+		return RECEIVE_FAILED;
+	}
+	return RECEIVE_PENDING;
+}
+
+
+//
+//	Asynchronous requests
+//
+
+long OneM2M::createResourceAsync(String path, int type, String content, CompletionCallback callback) {
+	CborBody 	body(this);
+	String request = _bodyRequest("POST", path, type, content, body.writer);
+	if (request.length() == 0) {
+		return 0;
+	}
+	return _addAsyncRequest("POST", path, request, callback, &body.writer);
+}
+
+
+long OneM2M::getResourceAsync(String path, int type, CompletionCallback callback) {
+	return _addAsyncRequest("GET", path, _retrieveRequest(path, type), callback);
+}
+
+
+long OneM2M::updateResourceAsync(String path, int type, String content, CompletionCallback callback) {
+	CborBody 	body(this);
+	String request = _bodyRequest("PUT", path, type, content, body.writer);
+	if (request.length() == 0) {
+		return 0;
+	}
+	return _addAsyncRequest("PUT", path, request, callback, &body.writer);
+}
+
+
+long OneM2M::deleteResourceAsync(String path, CompletionCallback callback) {
+	return _addAsyncRequest("DELETE", path,
+							_requestHeader("DELETE", path) +
+							"Content-Type: application/json\r\n\r\n",
+							callback);
+}
+
+
+void OneM2M::poll(void) {
+	if (_asyncRequests.size() == 0) {
+		return;
+	}
+	HEAP_SCOPE(HEAP_ONEM2M);
+	for (int i = 0; i < _asyncRequests.size(); ) {
+		AsyncRequest *ar = _asyncRequests.get(i);
+		if ( ! _advanceAsyncRequest(ar)) {
+			i++;
+			continue;
+		}
+		// The request is completed. Remove it before calling the callback, 
+		// because the callback might start new requests.
+		_asyncRequests.remove(i);
+		if (ar->callback != NULL) {
+			HEAP_SCOPE(HEAP_APPLICATION);
+			(*ar->callback)(ar->handle, ar->response.statusCode, ar->response.body);
+		}
+		_deleteAsyncRequest(ar);
+	}
+}
+
+
+bool OneM2M::cancelRequest(long handle) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	for (int i = 0; i < _asyncRequests.size(); i++) {
+		AsyncRequest *ar = _asyncRequests.get(i);
+		if (ar->handle == handle) {
+			if (ar->connection != NULL) {
+				_releaseConnection(ar->connection, false);	// a response might still arrive
+			}
+			_asyncRequests.remove(i);
+			_deleteAsyncRequest(ar);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+int OneM2M::pendingRequests(void) {
+	return _asyncRequests.size();
+}
+
+
+// Queue a new asynchronous request. It is started by the next poll(). The
+// CBOR-encoded body of *writer* is copied.
+long OneM2M::_addAsyncRequest(String method, String path, String request, CompletionCallback callback, const CborWriter *writer) {
+	HEAP_SCOPE(HEAP_ONEM2M);	// all asynchronous requests
+	AsyncRequest *ar = new AsyncRequest();
+	ar->handle = _nextHandle++;
+	ar->method = method;
+	ar->path = path;
+	ar->request = request;
+	ar->body = NULL;
+	ar->bodyLength = writer != NULL ? writer->length : 0;
+	if (ar->bodyLength > 0) {
+		ar->body = new uint8_t[ar->bodyLength];
+		memcpy(ar->body, writer->buffer, ar->bodyLength);
+	}
+	ar->callback = callback;
+	ar->state = ASYNC_WAITING;
+	ar->connection = NULL;
+	ar->sent = 0;
+	ar->reused = false;
+	ar->attempts = 0;
+	ar->started = millis();
+	_resetResponse(ar->response);
+	_asyncRequests.add(ar);
+	return ar->handle;
+}
+
+
+// Free an asynchronous request
+void OneM2M::_deleteAsyncRequest(AsyncRequest *ar) {
+	delete[] ar->body;
+	delete ar;
+}
+
+
+// Advance the state of an asynchronous request: wait for a free connection,
+// open it, send the request in parts, and receive the response. This method
+// returns true when the request is completed, either successfully or with 
+// an error. Failed requests are completed with a status code of 0.
+bool OneM2M::_advanceAsyncRequest(AsyncRequest *ar) {
+	if (millis() - ar->started > _timeout) {
+		if (ar->connection != NULL) {
+			_releaseConnection(ar->connection, false);
+			ar->connection = NULL;
+		}
+		_statistics.timeouts++;
+		ar->response.statusCode = 0;
+		return true;
+	}
+
+	switch (ar->state) {
+
+		// wait for a free connection. Connections beyond 
+		// ONEM2M_ASYNC_CONNECTIONS are reserved for synchronous requests.
+		case ASYNC_WAITING: {
+			int used = 0;
+			int free = 0;
+			for (int i = 0; i < _asyncRequests.size(); i++) {
+				used += _asyncRequests.get(i)->connection != NULL ? 1 : 0;
+			}
+			for (int i = 0; i < ONEM2M_MAX_CONNECTIONS; i++) {
+				free += _connections[i].inUse ? 0 : 1;
+			}
+			if (used >= ONEM2M_ASYNC_CONNECTIONS || free == 0) {
+				return false;	// try again later
+			}
+			ar->connection = _acquireConnection(ar->reused, false);
+			if (ar->connection == NULL) {
+				ar->response.statusCode = 0;
+				return true;
+			}
+			if (ar->attempts++ == 0) {
+				_statistics.requests++;
+			}
+			ar->sent = 0;
+			ar->state = ar->connection->socket >= 0 ? ASYNC_CONNECTING : ASYNC_SENDING;
+			return false;
+		}
+
+		// wait until a new connection is open
+		case ASYNC_CONNECTING:
+			switch (_checkConnect(ar->connection)) {
+				case RECEIVE_PENDING:
+					return false;
+				case RECEIVE_DONE:
+					ar->state = ASYNC_SENDING;
+					return false;
+				case RECEIVE_FAILED:
+					_releaseConnection(ar->connection, false);
+					ar->connection = NULL;
+					ar->response.statusCode = 0;
+					return true;
+			}
+			return false;
+
+		// send the next part of the request or the body
+		case ASYNC_SENDING: {
+			WiFiClient 	&client = ar->connection->client;
+			size_t 		headerLength = ar->request.length();
+			size_t 		size = ONEM2M_SEND_SIZE;
+# ifdef ESP8266
+			size_t 		writable = client.availableForWrite();
+			if (writable == 0 && client.connected()) {
+				return false;	// the send buffer is full, try again later
+			}
+			if (writable > 0 && writable < size) {
+				size = writable;
+			}
+# endif
+			const uint8_t *data;
+			if (ar->sent < headerLength) {
+				data = (const uint8_t *)ar->request.c_str() + ar->sent;
+				size = headerLength - ar->sent < size ? headerLength - ar->sent : size;
+			} else {
+				data = ar->body + (ar->sent - headerLength);
+				size = headerLength + ar->bodyLength - ar->sent < size ? headerLength + ar->bodyLength - ar->sent : size;
+			}
+			// the client may accept only a part. Nothing written means that
+			// the send buffer is full, or that the connection was closed.
+			size_t written = client.write(data, size);
+			if (written == 0 && client.connected()) {
+				return false;	// try again later
+			}
+			if (written == 0) {
+				_releaseConnection(ar->connection, false);
+				ar->connection = NULL;
+				ar->state = ASYNC_WAITING;
+				if (ar->attempts == 1 && _retryable(ar->method, ar->reused, ar->sent > 0, ar->response)) {
+					_statistics.reconnects++;
+					return false;	// try again on a new connection with the next poll()
+				}
+				ar->response.statusCode = 0;
+				return true;
+			}
+			ar->sent += written;
+			if (ar->sent == headerLength + ar->bodyLength) {
+				ar->state = ASYNC_RECEIVING;
+			}
+			return false;
+		}
+
+		// receive the response
+		case ASYNC_RECEIVING:
+			switch (_receive(ar->connection, ar->response)) {
+				case RECEIVE_PENDING:
+					return false;
+
+				case RECEIVE_DONE:
+					_releaseConnection(ar->connection, ar->response.keepAlive);
+					ar->connection = NULL;
+					_checkResource(ar->path, ar->response.statusCode, ar->method == "DELETE");
+					return true;
+
+				case RECEIVE_FAILED:
+					_releaseConnection(ar->connection, false);
+					ar->connection = NULL;
+					ar->state = ASYNC_WAITING;
+					if (ar->attempts == 1 && _retryable(ar->method, ar->reused, true, ar->response)) {
+						_statistics.reconnects++;
+						_resetResponse(ar->response);
+						return false;	// try again on a new connection with the next poll()
+					}
+					ar->response.statusCode = 0;
+					return true;
+			}
+			return false;
+	}
+	return false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//	Static class function
+//
+
+//
+//	Miscellaneous functions
+//
+
+void OneM2M::setJsonMaxSize(int value) {
+	_jsonSize = value;
+}
+
+
+int OneM2M::jsonMaxSize(void) {
+	return _jsonSize;
+}
+
+
+String OneM2M::getResourceIdentifier(String resource) {
+	ResourceFields 	fields;
+	Scanner 		scanner;
+
+	if (_scanDocument(scanner, &fields, resource.c_str(), resource.length())) {
+		return fields.resourceIdentifier;
+	}
+	return "";
+}
+
+
+size_t OneM2M::encodeContentInstance(Serialization serialization, String content, String contentType, uint8_t *buffer, size_t size) {
+	if (serialization == JSON) {
+		String body = _contentInstance(content, contentType);
+		if (body.length() >= size) {
+			return 0;
+		}
+		memcpy(buffer, body.c_str(), body.length() + 1);
+		return body.length();
+	}
+	CborWriter writer;
+	_cborInit(writer, buffer, size);
+	_cborContentInstance(writer, content, contentType);
+	return writer.overflow ? 0 : writer.length;
+}
+
+
+bool OneM2M::decodeResource(Serialization serialization, const uint8_t *data, size_t length, ResourceFields &fields) {
+	Scanner scanner;
+	return _scanDocument(scanner, &fields, (const char *)data, length, serialization == CBOR);
+}
+
+
+// Escape JSON special chars
+String OneM2M::_escapeJSON(String value) {
+	String result = value;
+
+	result.replace("\\", "\\\\");
+	result.replace("\n", "\\n");
+	result.replace("\r", "\\r");
+	result.replace("\t", "\\t");
+	result.replace("\"", "\\\"");
+	// a bit of optimization: don't handle chars that are likely not used at all.
+	// \b  Backspace (ascii code 08)
+	// \f  Form feed (ascii code 0C)
+	return result;
+}
+
+
+// Split the path in the resource path and the name
+OneM2M::PathElements OneM2M::_splitPath(String path) {
+	PathElements elements;
+	int l = path.lastIndexOf("/");
+	elements.path = path.substring(0,l);
+	elements.rn = path.substring(l+1);
+	return elements;
+}
+
+
+// Initialize a response structure before parsing. If a *scanner* is given
+// then the body is passed to the scanner instead of being stored.
+void OneM2M::_resetResponse(Response &response, Scanner *scanner) {
+	response.state = STATUS;
+	response.statusCode = 0;
+	response.contentLength = -1;
+	response.remaining = 0;
+	response.chunked = false;
+	response.keepAlive = false;
+	response.line = "";
+	response.body = "";
+	response.scanner = scanner;
+	if (scanner != NULL) {
+		_scanReset(*scanner, scanner->fields);
+	}
+}
+
+
+// Parse the next character of a response. The body's framing is determined
+// by the Content-Length or Transfer-Encoding headers, or by closing the
+// connection. This method returns true when the response is complete.
+bool OneM2M::_parseResponse(Response &response, char c) {
+	switch (response.state) {
+		case STATUS:
+		case HEADER:
+		case CHUNKSIZE:
+		case TRAILER:
+			if (c == '\r') {
+				return false;
+			}
+			if (c != '\n') {
+				response.line += c;
+				return false;
+			}
+			break; 	// handle the line below
+
+		case BODY:
+			_responseBody(response, c);
+			if (response.contentLength >= 0 && --response.remaining == 0) {
+				response.state = DONE;
+			}
+			return response.state == DONE;
+
+		case CHUNKDATA:
+			_responseBody(response, c);
+			if (--response.remaining == 0) {
+				response.state = CHUNKEND;
+			}
+			return false;
+
+		case CHUNKEND:
+			if (c == '\n') {
+				response.state = CHUNKSIZE;
+			}
+			return false;
+
+		case DONE:
+			return true;
+	}
+
+	// handle a complete line
+	String line = response.line;
+	response.line = "";
+	switch (response.state) {
+		case STATUS:	// e.g. "HTTP/1.1 200 OK"
+			response.statusCode = line.substring(9, 12).toInt();
+			response.keepAlive = line.startsWith("HTTP/1.1");
+			response.state = HEADER;
+			break;
+
+		case HEADER:
+			if (line.length() > 0) {
+				int idx = line.indexOf(':');
+				String name = line.substring(0, idx);
+				String value = line.substring(idx + 1);
+				name.toLowerCase();
+				value.trim();
+				if (name == "content-length") {
+					response.contentLength = value.toInt();
+				} else if (name == "transfer-encoding") {
+					value.toLowerCase();
+					response.chunked = value.indexOf("chunked") > -1;
+				} else if (name == "connection") {
+					value.toLowerCase();
+					response.keepAlive = value != "close";
+				} else if (name == "content-type" && response.scanner != NULL) {
+					value.toLowerCase();
+					response.scanner->cbor = value.indexOf("cbor") > -1;
+				}
+				break;
+			}
+			// end of header reached
+			if (response.statusCode == 204 || response.statusCode == 304 || response.statusCode < 200) {
+				response.state = DONE;
+			} else if (response.chunked) {
+				response.state = CHUNKSIZE;
+			} else if (response.contentLength == 0) {
+				response.state = DONE;
+			} else {
+				if (response.contentLength > 0) {
+					response.remaining = response.contentLength;
+					if (response.scanner == NULL) {
+						response.body.reserve(response.contentLength);
+					}
+				} else {
+					response.keepAlive = false;		// body ends when the connection is closed
+				}
+				response.state = BODY;
+			}
+			break;
+
+		case CHUNKSIZE:
+			response.remaining = strtol(line.c_str(), NULL, 16);
+			response.state = response.remaining > 0 ? CHUNKDATA : TRAILER;
+			break;
+
+		case TRAILER:
+			if (line.length() == 0) {
+				response.state = DONE;
+			}
+			break;
+
+		default:
+			break;
+	}
+	return response.state == DONE;
+}
+
+
+// Store or scan a character of a response's body
+void OneM2M::_responseBody(Response &response, char c) {
+	if (response.scanner != NULL) {
+		_scan(*response.scanner, c);
+	} else {
+		response.body += c;
+	}
+}
+
+
+// Return a Content structure for the extracted attributes of a ContentInstance
+OneM2M::Content OneM2M::_content(bool state, const ResourceFields &fields) {
+	Content result;
+	result.state = state;
+	if (state) {
+		result.resourceIdentifier = fields.resourceIdentifier;
+		result.content = fields.content;
+		result.contentFormat = fields.contentFormat;
+		result.creationTime = fields.creationTime;
+	}
+	return result;
+}
+
+
+//
+//	Scanner
+//
+
+// Initialize a scanner. The extracted attributes are stored in *fields*.
+void OneM2M::_scanReset(Scanner &scanner, ResourceFields *fields) {
+	memset(&scanner, 0, sizeof(scanner));
+	scanner.fields = fields;
+	scanner.state = SCAN_VALUE;
+	scanner.targetField = FIELD_NONE;
+	scanner.rawDepth = -1;
+	scanner.repDepth = -1;
+	scanner.repStart = -1;
+	scanner.repEnd = -1;
+	if (fields != NULL) {
+		memset(fields, 0, sizeof(ResourceFields));
+		fields->type = UNKNOWN;
+	}
+}
+
+
+// Scan a complete JSON or CBOR document. This method returns true if the 
+// document is well-formed.
+bool OneM2M::_scanDocument(Scanner &scanner, ResourceFields *fields, const char *data, long length, bool cbor) {
+	_scanReset(scanner, fields);
+	scanner.cbor = cbor;
+	if (data == NULL || length <= 0) {
+		return false;
+	}
+	for (long i = 0; i < length; i++) {
+		if ( ! _scan(scanner, data[i])) {
+			return false;
+		}
+	}
+	return scanner.state == SCAN_NEXT && scanner.depth == 0;
+}
+
+
+// Scan the next byte of a JSON or CBOR document
+bool OneM2M::_scan(Scanner &scanner, uint8_t c) {
+	return (scanner.cbor ? _scanCbor(scanner, c) : _scanJson(scanner, c)) && scanner.state != SCAN_ERROR;
+}
+
+
+// Scan the next character of a JSON document. This method returns false
+// if the document is malformed.
+bool OneM2M::_scanJson(Scanner &scanner, char c) {
+	long position = scanner.position++;
+
+	// strings of captured objects and arrays are copied verbatim
+	if (scanner.rawDepth >= 0 && scanner.state >= SCAN_STRING && scanner.state <= SCAN_UNICODE) {
+		_scanAppend(scanner, c);
+	}
+
+	switch (scanner.state) {
+		case SCAN_STRING:
+			if (c == '\\') {
+				scanner.state = SCAN_ESCAPE;
+			} else if (c == '"') {
+				_scanEndString(scanner);
+				return scanner.state != SCAN_ERROR;
+			} else {
+				_scanChar(scanner, c);
+			}
+			return true;
+
+		case SCAN_ESCAPE:
+			scanner.state = SCAN_STRING;
+			switch (c) {
+				case 'b':	_scanChar(scanner, '\b'); break;
+				case 'f':	_scanChar(scanner, '\f'); break;
+				case 'n':	_scanChar(scanner, '\n'); break;
+				case 'r':	_scanChar(scanner, '\r'); break;
+				case 't':	_scanChar(scanner, '\t'); break;
+				case 'u':	scanner.state = SCAN_UNICODE;
+							scanner.unicode = 0;
+							scanner.unicodeDigits = 0;
+							break;
+				default:	_scanChar(scanner, c); break;	// \" \\ \/
+			}
+			return true;
+
+		case SCAN_UNICODE:	// encode \uXXXX as UTF-8
+			if ( ! isxdigit(c)) {
+				break;
+			}
+			scanner.unicode = (scanner.unicode << 4) | (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+			if (++scanner.unicodeDigits == 4) {
+				uint16_t u = scanner.unicode;
+				if (u < 0x80) {
+					_scanChar(scanner, u);
+				} else if (u < 0x800) {
+					_scanChar(scanner, 0xc0 | (u >> 6));
+					_scanChar(scanner, 0x80 | (u & 0x3f));
+				} else {
+					_scanChar(scanner, 0xe0 | (u >> 12));
+					_scanChar(scanner, 0x80 | ((u >> 6) & 0x3f));
+					_scanChar(scanner, 0x80 | (u & 0x3f));
+				}
+				scanner.state = SCAN_STRING;
+			}
+			return true;
+
+		case SCAN_LITERAL:	// number, true, false, null
+			if (isalnum(c) || c == '.' || c == '-' || c == '+') {
+				_scanAppend(scanner, c);
+				if (scanner.writer != NULL) {
+					_cborByte(*scanner.writer, c);
+				}
+				return true;
+			}
+			if (scanner.writer != NULL) {
+				_cborEndLiteral(*scanner.writer);
+			}
+			_scanEndValue(scanner);
+			if (scanner.state == SCAN_ERROR) {
+				return false;
+			}
+			break;	// handle the character below
+
+		case SCAN_ERROR:
+			return false;
+
+		default:
+			break;
+	}
+
+	if (scanner.state != SCAN_UNICODE) {
+		bool inObject = (scanner.objects >> scanner.depth) & 1;
+		switch (c) {
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				return true;
+
+			case '{':
+			case '[':
+				if (scanner.state != SCAN_VALUE || scanner.depth >= 31) {
+					break;
+				}
+				_scanBeginValue(scanner, c, position);
+				if (scanner.rawDepth >= 0) {
+					_scanAppend(scanner, c);
+				}
+				if (scanner.writer != NULL) {
+					_cborByte(*scanner.writer, c == '{' ? 0xbf : 0x9f);	// indefinite-length map or array
+				}
+				scanner.depth++;
+				scanner.empty = true;
+				if (c == '{') {
+					scanner.objects |= (1UL << scanner.depth);
+					scanner.state = SCAN_KEY;
+				} else {
+					scanner.objects &= ~(1UL << scanner.depth);
+					scanner.state = SCAN_VALUE;
+				}
+				return true;
+
+			case '}':
+			case ']':
+				if (scanner.depth == 0 || inObject != (c == '}') || 
+					(scanner.state != SCAN_NEXT && (scanner.state != (inObject ? SCAN_KEY : SCAN_VALUE) || ! scanner.empty))) {
+					break;	// no trailing comma
+				}
+				if (scanner.rawDepth >= 0) {
+					_scanAppend(scanner, c);
+				}
+				if (scanner.writer != NULL) {
+					_cborByte(*scanner.writer, 0xff);	// break
+				}
+				scanner.depth--;
+				if (scanner.depth == scanner.repDepth) {
+					scanner.repEnd = position + 1;
+					scanner.repDepth = -1;
+				}
+				_scanEndValue(scanner);
+				return scanner.state != SCAN_ERROR;
+
+			case ',':
+				if (scanner.state != SCAN_NEXT || scanner.depth == 0) {
+					break;
+				}
+				if (scanner.rawDepth >= 0) {
+					_scanAppend(scanner, c);
+				}
+				scanner.state = inObject ? SCAN_KEY : SCAN_VALUE;
+				scanner.empty = false;
+				return true;
+
+			case ':':
+				if (scanner.state != SCAN_COLON) {
+					break;
+				}
+				if (scanner.rawDepth >= 0) {
+					_scanAppend(scanner, c);
+				}
+				scanner.state = SCAN_VALUE;
+				return true;
+
+			case '"':
+				if (scanner.state == SCAN_KEY) {
+					scanner.isKey = true;
+					scanner.keyLength = 0;
+				} else if (scanner.state == SCAN_VALUE) {
+					scanner.isKey = false;
+					_scanBeginValue(scanner, c, position);
+				} else {
+					break;
+				}
+				if (scanner.rawDepth >= 0) {
+					_scanAppend(scanner, c);
+				}
+				if (scanner.writer != NULL) {
+					_cborBeginText(*scanner.writer);
+				}
+				scanner.state = SCAN_STRING;
+				return true;
+
+			default:
+				if (scanner.state != SCAN_VALUE || ! (isalnum(c) || c == '-')) {
+					break;
+				}
+				_scanBeginValue(scanner, c, position);
+				_scanAppend(scanner, c);
+				if (scanner.writer != NULL) {
+					scanner.writer->start = scanner.writer->length;
+					_cborByte(*scanner.writer, c);
+				}
+				scanner.state = SCAN_LITERAL;
+				return true;
+		}
+	}
+	scanner.state = SCAN_ERROR;
+	return false;
+}
+
+
+// Start a value. The value is captured if its key is an attribute of 
+// interest that was not captured before. Objects and arrays are captured
+// as JSON text.
+void OneM2M::_scanBeginValue(Scanner &scanner, char c, long position) {
+	if (scanner.rawDepth >= 0 || ! ((scanner.objects >> scanner.depth) & 1)) {
+		return;	// inside a captured value, or an array element
+	}
+	const char *key = scanner.key;
+	if (strncmp(key, "m2m:", 4) == 0) {
+		key += 4;
+	}
+	if (strcmp(key, "rep") == 0 && scanner.repStart < 0 && (c == '{' || c == '[')) {
+		scanner.repStart = position;
+		scanner.repDepth = scanner.depth;
+	}
+	if (scanner.fields == NULL) {
+		return;
+	}
+
+	ScanField 	field = FIELD_NONE;
+	char 		*target = scanner.literal;
+	size_t 		size = sizeof(scanner.literal);
+	if (strcmp(key, "ri") == 0) {
+		field = FIELD_RI;
+		target = scanner.fields->resourceIdentifier;
+		size = sizeof(scanner.fields->resourceIdentifier);
+	} else if (strcmp(key, "ty") == 0) {
+		field = FIELD_TY;
+	} else if (strcmp(key, "con") == 0) {
+		field = FIELD_CON;
+		target = scanner.fields->content;
+		size = sizeof(scanner.fields->content);
+	} else if (strcmp(key, "cnf") == 0) {
+		field = FIELD_CNF;
+		target = scanner.fields->contentFormat;
+		size = sizeof(scanner.fields->contentFormat);
+	} else if (strcmp(key, "ct") == 0) {
+		field = FIELD_CT;
+		target = scanner.fields->creationTime;
+		size = sizeof(scanner.fields->creationTime);
+	} else if (strcmp(key, "sur") == 0) {
+		field = FIELD_SUR;
+		target = scanner.fields->subscriptionReference;
+		size = sizeof(scanner.fields->subscriptionReference);
+	} else if (strcmp(key, "vrq") == 0) {
+		field = FIELD_VRQ;
+	}
+	if (field == FIELD_NONE || (scanner.captured & field)) {
+		return;
+	}
+	scanner.captured |= field;
+	scanner.target = target;
+	scanner.targetSize = size;
+	scanner.targetLength = 0;
+	scanner.targetField = field;
+	if (c == '{' || c == '[') {
+		scanner.rawDepth = scanner.depth;
+	}
+}
+
+
+// Complete a value. A captured attribute is terminated and converted. The
+// state is set to SCAN_ERROR if the resource type is not an integer.
+void OneM2M::_scanEndValue(Scanner &scanner) {
+	scanner.state = SCAN_NEXT;
+	if (scanner.target == NULL || (scanner.rawDepth >= 0 && scanner.depth > scanner.rawDepth)) {
+		return;	// not captured, or inside a captured object or array
+	}
+	if (scanner.targetSize > 0) {
+		scanner.target[scanner.targetLength] = '\0';
+	}
+	if (scanner.targetField == FIELD_TY) {
+		char *end;
+		scanner.fields->type = strtol(scanner.target, &end, 10);
+		if (end == scanner.target || *end != '\0') {
+			scanner.fields->type = UNKNOWN;
+			scanner.state = SCAN_ERROR;
+		}
+	} else if (scanner.targetField == FIELD_VRQ) {
+		scanner.fields->verificationRequest = strcmp(scanner.target, "true") == 0;
+	}
+	scanner.target = NULL;
+	scanner.targetField = FIELD_NONE;
+	scanner.rawDepth = -1;
+}
+
+
+// Complete a key or a string value
+void OneM2M::_scanEndString(Scanner &scanner) {
+	if (scanner.writer != NULL) {
+		_cborEndText(*scanner.writer);
+	}
+	if ( ! scanner.isKey) {
+		_scanEndValue(scanner);
+		return;
+	}
+	scanner.key[scanner.keyLength < (int)sizeof(scanner.key) ? scanner.keyLength : 0] = '\0';
+	if (scanner.depth == 1 && scanner.rootKey[0] == '\0') {
+		strcpy(scanner.rootKey, scanner.key);
+	}
+	scanner.state = SCAN_COLON;
+}
+
+
+// Add a decoded character of a string to the current key or value
+void OneM2M::_scanChar(Scanner &scanner, char c) {
+	if (scanner.writer != NULL) {
+		_cborByte(*scanner.writer, c);
+	}
+	if (scanner.isKey) {
+		if (scanner.keyLength < (int)sizeof(scanner.key) - 1) {
+			scanner.key[scanner.keyLength] = c;
+		}
+		scanner.keyLength++;
+	} else if (scanner.rawDepth < 0) {
+		_scanAppend(scanner, c);
+	}
+}
+
+
+// Add a character to the captured value, if any
+void OneM2M::_scanAppend(Scanner &scanner, char c) {
+	if (scanner.target == NULL) {
+		return;
+	}
+	if (scanner.targetSize == 0) {
+		scanner.targetLength++;		// only count, see _cborToJson()
+	} else if (scanner.targetLength < scanner.targetSize - 1) {
+		scanner.target[scanner.targetLength++] = c;
+	} else if (scanner.fields != NULL) {
+		scanner.fields->truncated = true;
+	}
+}
+
+
+// Add a character of a string to a captured value as JSON text
+void OneM2M::_scanAppendEscaped(Scanner &scanner, char c) {
+	switch (c) {
+		case '"':
+		case '\\':	_scanAppend(scanner, '\\'); _scanAppend(scanner, c); break;
+		case '\n':	_scanAppend(scanner, '\\'); _scanAppend(scanner, 'n'); break;
+		case '\r':	_scanAppend(scanner, '\\'); _scanAppend(scanner, 'r'); break;
+		case '\t':	_scanAppend(scanner, '\\'); _scanAppend(scanner, 't'); break;
+		default:
+			if ((uint8_t)c < 0x20) {
+				char escaped[7];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				for (int i = 0; i < 6; i++) {
+					_scanAppend(scanner, escaped[i]);
+				}
+			} else {
+				_scanAppend(scanner, c);
+			}
+	}
+}
+
+
+//
+//	CBOR decoding
+//
+
+// Scan the next byte of a CBOR document. This method returns false if the
+// document is malformed.
+bool OneM2M::_scanCbor(Scanner &scanner, uint8_t c) {
+	scanner.position++;
+
+	switch (scanner.state) {
+		case CBOR_ARGUMENT:
+			scanner.argument = (scanner.argument << 8) | c;
+			if (--scanner.argumentBytes > 0) {
+				return true;
+			}
+			return _cborItem(scanner, false);
+
+		case CBOR_DATA:		// payload of a byte or text string
+			if (scanner.major == 3) {
+				if (scanner.rawDepth >= 0) {
+					_scanAppendEscaped(scanner, c);
+				}
+				_scanChar(scanner, c);
+			}
+			if (--scanner.argument > 0) {
+				return true;
+			}
+			if (scanner.indefiniteString) {
+				scanner.state = CBOR_HEAD;	// wait for the next chunk
+			} else {
+				_cborEndString(scanner);
+			}
+			return true;
+
+		case SCAN_NEXT:		// the document is complete
+		case SCAN_ERROR:
+			scanner.state = SCAN_ERROR;
+			return false;
+
+		default:
+			break;
+	}
+
+	// initial byte of an item
+	uint8_t major = c >> 5;
+	uint8_t info = c & 0x1f;
+	if (c == 0xff) {	// break
+		uint32_t bit = 1UL << scanner.depth;
+		if (scanner.indefiniteString) {
+			scanner.indefiniteString = false;
+			_cborEndString(scanner);
+			return true;
+		}
+		if (scanner.depth == 0 || scanner.remaining[scanner.depth] != ONEM2M_CBOR_INDEFINITE ||
+			((scanner.objects & bit) && ! (scanner.keyNext & bit))) {	// a key without a value
+			scanner.state = SCAN_ERROR;
+			return false;
+		}
+		_cborClose(scanner);
+		_cborNext(scanner);
+		return true;
+	}
+	if (scanner.indefiniteString && (major != scanner.major || info == 31)) {	// chunks must be definite strings
+		scanner.state = SCAN_ERROR;
+		return false;
+	}
+	if ( ! scanner.indefiniteString) {
+		scanner.itemStart = scanner.position - 1;
+	}
+	scanner.major = major;
+	scanner.info = info;
+	if (info < 24) {
+		scanner.argument = info;
+		return _cborItem(scanner, false);
+	}
+	if (info < 28) {
+		scanner.argument = 0;
+		scanner.argumentBytes = 1 << (info - 24);
+		scanner.state = CBOR_ARGUMENT;
+		return true;
+	}
+	if (info == 31 && major >= 2 && major <= 5) {
+		return _cborItem(scanner, true);
+	}
+	scanner.state = SCAN_ERROR;
+	return false;
+}
+
+
+// Handle a CBOR item after its initial byte and argument were read. Items
+// in captured maps and arrays are converted to JSON text.
+bool OneM2M::_cborItem(Scanner &scanner, bool indefinite) {
+	if (scanner.indefiniteString) {	// chunk of an indefinite-length string
+		scanner.state = scanner.argument > 0 ? CBOR_DATA : CBOR_HEAD;
+		return true;
+	}
+	uint8_t major = scanner.major;
+	if (major == 6) {	// tags are ignored
+		scanner.state = CBOR_HEAD;
+		return true;
+	}
+
+	// separators and keys
+	uint32_t 	bit = 1UL << scanner.depth;
+	bool 		inMap = (scanner.objects & bit) != 0;
+	scanner.isKey = inMap && (scanner.keyNext & bit);
+	if (scanner.rawDepth >= 0 && scanner.depth > scanner.rawDepth) {
+		if (inMap && ! scanner.isKey) {
+			_scanAppend(scanner, ':');
+		} else if (scanner.hasItems & bit) {
+			_scanAppend(scanner, ',');
+		}
+	}
+	if (scanner.isKey) {
+		scanner.keyLength = 0;
+	} else {
+		_scanBeginValue(scanner, major == 5 ? '{' : (major == 4 ? '[' : '"'), scanner.itemStart);
+	}
+
+	switch (major) {
+		case 0:		// unsigned integer
+		case 1:		// negative integer
+			_cborNumber(scanner, scanner.argument, major == 1);
+			return true;
+
+		case 2:		// byte string. The bytes are skipped
+		case 3:		// text string
+			if (scanner.rawDepth >= 0) {
+				_scanAppend(scanner, '"');
+			}
+			scanner.indefiniteString = indefinite;
+			if (indefinite || scanner.argument > 0) {
+				scanner.state = indefinite ? CBOR_HEAD : CBOR_DATA;
+			} else {
+				_cborEndString(scanner);
+			}
+			return true;
+
+		case 4:		// array
+		case 5:		// map
+			if (scanner.isKey || scanner.depth >= ONEM2M_CBOR_MAX_DEPTH ||
+				( ! indefinite && scanner.argument >= (major == 5 ? 0x7fff : ONEM2M_CBOR_INDEFINITE))) {
+				break;
+			}
+			if (scanner.rawDepth >= 0) {
+				_scanAppend(scanner, major == 5 ? '{' : '[');
+			}
+			scanner.depth++;
+			bit = 1UL << scanner.depth;
+			if (major == 5) {
+				scanner.objects |= bit;
+				scanner.keyNext |= bit;
+			} else {
+				scanner.objects &= ~bit;
+				scanner.keyNext &= ~bit;
+			}
+			scanner.hasItems &= ~bit;
+			scanner.remaining[scanner.depth] = indefinite ? ONEM2M_CBOR_INDEFINITE : (major == 5 ? 2 : 1) * scanner.argument;
+			scanner.state = CBOR_HEAD;
+			if (scanner.remaining[scanner.depth] == 0) {	// empty container
+				_cborClose(scanner);
+				_cborNext(scanner);
+			}
+			return true;
+
+		case 7: {	// simple values and floating-point numbers
+			char 	text[24];
+			double 	value;
+			switch (scanner.info) {
+				case 20:	_cborLiteral(scanner, "false"); return true;
+				case 21:	_cborLiteral(scanner, "true"); return true;
+				case 25: {	// half-precision
+					int exponent = (scanner.argument >> 10) & 0x1f;
+					int mantissa = scanner.argument & 0x3ff;
+					if (exponent == 0) {
+						value = ldexp(mantissa, -24);
+					} else if (exponent != 31) {
+						value = ldexp(mantissa + 1024, exponent - 25);
+					} else {
+						value = mantissa == 0 ? INFINITY : NAN;
+					}
+					if (scanner.argument & 0x8000) {
+						value = -value;
+					}
+					snprintf(text, sizeof(text), "%g", value);
+					_cborLiteral(scanner, text);
+					return true;
+				}
+				case 26: {	// single-precision
+					uint32_t 	bits = scanner.argument;
+					float 		f;
+					memcpy(&f, &bits, sizeof(f));
+					snprintf(text, sizeof(text), "%g", f);
+					_cborLiteral(scanner, text);
+					return true;
+				}
+				case 27:	// double-precision
+					memcpy(&value, &scanner.argument, sizeof(value));
+					snprintf(text, sizeof(text), "%.15g", value);
+					_cborLiteral(scanner, text);
+					return true;
+				default:	// null, undefined, and other simple values
+					_cborLiteral(scanner, "null");
+					return true;
+			}
+		}
+	}
+	scanner.state = SCAN_ERROR;
+	return false;
+}
+
+
+// Complete an item of the current container. Definite-length containers 
+// are closed when all their items were read.
+void OneM2M::_cborNext(Scanner &scanner) {
+	while (scanner.depth > 0 && scanner.state != SCAN_ERROR) {
+		uint32_t bit = 1UL << scanner.depth;
+		scanner.hasItems |= bit;
+		if (scanner.objects & bit) {
+			scanner.keyNext ^= bit;
+		}
+		if (scanner.remaining[scanner.depth] == ONEM2M_CBOR_INDEFINITE || --scanner.remaining[scanner.depth] > 0) {
+			break;
+		}
+		_cborClose(scanner);
+	}
+	if (scanner.state != SCAN_ERROR) {
+		scanner.state = scanner.depth > 0 ? CBOR_HEAD : SCAN_NEXT;
+	}
+}
+
+
+// Close the current map or array
+void OneM2M::_cborClose(Scanner &scanner) {
+	if (scanner.rawDepth >= 0) {
+		_scanAppend(scanner, (scanner.objects >> scanner.depth) & 1 ? '}' : ']');
+	}
+	scanner.depth--;
+	if (scanner.depth == scanner.repDepth) {
+		scanner.repEnd = scanner.position;
+		scanner.repDepth = -1;
+	}
+	_scanEndValue(scanner);
+}
+
+
+// Complete a text or byte string
+void OneM2M::_cborEndString(Scanner &scanner) {
+	if (scanner.rawDepth >= 0) {
+		_scanAppend(scanner, '"');
+	}
+	_scanEndString(scanner);
+	_cborNext(scanner);
+}
+
+
+// Add a number as a key or value
+void OneM2M::_cborNumber(Scanner &scanner, uint64_t value, bool negative) {
+	char 	text[22];
+	char 	*p = text + sizeof(text) - 1;
+
+	*p = '\0';
+	if (negative) {
+		value++;	// the value is -1 - argument
+	}
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+	if (negative) {
+		*--p = '-';
+	}
+	_cborLiteral(scanner, p);
+}
+
+
+// Add a number or literal as a key or value. Keys in captured maps are 
+// quoted.
+void OneM2M::_cborLiteral(Scanner &scanner, const char *literal) {
+	bool quoted = scanner.isKey && scanner.rawDepth >= 0;
+
+	if (quoted) {
+		_scanAppend(scanner, '"');
+	}
+	for (const char *p = literal; *p != '\0'; p++) {
+		if (scanner.isKey) {
+			_scanChar(scanner, *p);
+		}
+		if ( ! scanner.isKey || scanner.rawDepth >= 0) {
+			_scanAppend(scanner, *p);
+		}
+	}
+	if (quoted) {
+		_scanAppend(scanner, '"');
+	}
+	_scanEndString(scanner);
+	_cborNext(scanner);
+}
+
+
+// Convert a CBOR-encoded item to JSON text. An empty string is returned if
+// the item is malformed. The item is scanned twice: the first pass only 
+// counts the length of the JSON text, so the buffer has the exact size.
+String OneM2M::_cborToJson(const uint8_t *data, long length) {
+	String 	result;
+	size_t 	size = _cborToJson(data, length, NULL, 0);
+	if (size == 0) {
+		return result;
+	}
+	char *buffer = new char[size + 1];
+	if (_cborToJson(data, length, buffer, size + 1) == size) {
+		result = buffer;
+	}
+	delete[] buffer;
+	return result;
+}
+
+
+// Convert a CBOR-encoded item to JSON text in *buffer*, or only count the
+// length of the text if *buffer* is NULL. The length is returned, or 0 if 
+// the item is malformed.
+size_t OneM2M::_cborToJson(const uint8_t *data, long length, char *buffer, size_t size) {
+	Scanner scanner;
+	char 	counting;
+
+	_scanReset(scanner, NULL);
+	scanner.cbor = true;
+	scanner.target = buffer != NULL ? buffer : &counting;
+	scanner.targetSize = buffer != NULL ? size : 0;
+	scanner.rawDepth = 0;	// capture everything
+	for (long i = 0; i < length && _scanCbor(scanner, data[i]); i++) {
+	}
+	return scanner.state == SCAN_NEXT && scanner.depth == 0 ? scanner.targetLength : 0;
+}
+
+
+//
+//	CBOR encoding
+//
+
+// Take the shared CBOR buffer of *owner*, or allocate a temporary buffer if
+// it is in use
+OneM2M::CborBody::CborBody(OneM2M *owner) {
+	_owner = owner;
+	_buffer = NULL;
+	if (owner->_serialization == CBOR) {
+		if (owner->_cborBuffer != NULL && ! owner->_cborBufferInUse) {
+			_buffer = owner->_cborBuffer;
+			owner->_cborBufferInUse = true;
+		} else {
+			_buffer = new uint8_t[ONEM2M_CBOR_BUFFER_SIZE];
+		}
+	}
+	reset();
+}
+
+
+OneM2M::CborBody::~CborBody() {
+	if (_buffer != NULL && _buffer == _owner->_cborBuffer) {
+		_owner->_cborBufferInUse = false;
+	} else {
+		delete[] _buffer;
+	}
+}
+
+
+void OneM2M::CborBody::reset(void) {
+	_cborInit(writer, _buffer, _buffer != NULL ? ONEM2M_CBOR_BUFFER_SIZE : 0);
+}
+
+
+// Initialize a CBOR writer for a buffer
+void OneM2M::_cborInit(CborWriter &writer, uint8_t *buffer, size_t size) {
+	writer.buffer = buffer;
+	writer.size = size;
+	writer.length = 0;
+	writer.start = 0;
+	writer.overflow = false;
+}
+
+
+void OneM2M::_cborByte(CborWriter &writer, uint8_t value) {
+	if (writer.length < writer.size) {
+		writer.buffer[writer.length++] = value;
+	} else {
+		writer.overflow = true;
+	}
+}
+
+
+// Write the initial byte and the argument of an item in the shortest form
+void OneM2M::_cborHead(CborWriter &writer, uint8_t major, uint64_t value) {
+	major <<= 5;
+	if (value < 24) {
+		_cborByte(writer, major | value);
+		return;
+	}
+	int bytes = value <= 0xff ? 1 : (value <= 0xffff ? 2 : (value <= 0xffffffffULL ? 4 : 8));
+	_cborByte(writer, major | (bytes == 1 ? 24 : (bytes == 2 ? 25 : (bytes == 4 ? 26 : 27))));
+	for (int i = bytes - 1; i >= 0; i--) {
+		_cborByte(writer, value >> (8 * i));
+	}
+}
+
+
+void OneM2M::_cborText(CborWriter &writer, const char *text, size_t length) {
+	_cborHead(writer, 3, length);
+	if (writer.length + length > writer.size) {
+		writer.overflow = true;
+		return;
+	}
+	memcpy(writer.buffer + writer.length, text, length);
+	writer.length += length;
+}
+
+
+// Write a ContentInstance resource. The content is written as it is, no 
+// escaping is necessary.
+void OneM2M::_cborContentInstance(CborWriter &writer, String content, String contentType) {
+	_cborByte(writer, 0xa1);	// map with 1 pair
+	_cborText(writer, "m2m:cin", 7);
+	_cborByte(writer, 0xa2);	// map with 2 pairs
+	_cborText(writer, "cnf", 3);
+	_cborText(writer, contentType.c_str(), contentType.length());
+	_cborText(writer, "con", 3);
+	_cborText(writer, content.c_str(), content.length());
+}
+
+
+// Start a text string of unknown length. Space for the longest initial byte
+// and argument is reserved.
+void OneM2M::_cborBeginText(CborWriter &writer) {
+	writer.start = writer.length;
+	_cborByte(writer, 0x79);
+	_cborByte(writer, 0);
+	_cborByte(writer, 0);
+}
+
+
+// Complete a text string. The string is moved if the initial byte and 
+// argument are shorter than reserved.
+void OneM2M::_cborEndText(CborWriter &writer) {
+	if (writer.overflow) {
+		return;
+	}
+	size_t 		length = writer.length - writer.start - 3;
+	uint8_t 	*head = writer.buffer + writer.start;
+	size_t 		headLength = length < 24 ? 1 : (length < 256 ? 2 : 3);
+	if (length > 0xffff) {
+		writer.overflow = true;
+		return;
+	}
+	memmove(head + headLength, head + 3, length);
+	writer.length = writer.start;
+	_cborHead(writer, 3, length);	// rewrite the shorter initial byte and argument at the same place
+	writer.length += length;
+}
+
+
+// Replace a JSON literal (number, true, false, null) that was copied to
+// the buffer by its CBOR encoding
+void OneM2M::_cborEndLiteral(CborWriter &writer) {
+	char 	text[32];
+	size_t 	length = writer.length - writer.start;
+	if (writer.overflow || length >= sizeof(text)) {
+		writer.overflow = true;
+		return;
+	}
+	memcpy(text, writer.buffer + writer.start, length);
+	text[length] = '\0';
+	writer.length = writer.start;
+
+	if (strcmp(text, "true") == 0) {
+		_cborByte(writer, 0xf5);
+	} else if (strcmp(text, "false") == 0) {
+		_cborByte(writer, 0xf4);
+	} else if (strcmp(text, "null") == 0) {
+		_cborByte(writer, 0xf6);
+	} else if (strpbrk(text, ".eE") == NULL) {	// integer
+		long long value = strtoll(text, NULL, 10);
+		if (value >= 0) {
+			_cborHead(writer, 0, value);
+		} else {
+			_cborHead(writer, 1, -1 - value);
+		}
+	} else {	// floating-point number. Single precision is used if it is exact
+		double 	value = strtod(text, NULL);
+		float 	f = value;
+		if ((double)f == value) {
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(bits));
+			_cborByte(writer, 0xfa);
+			for (int i = 3; i >= 0; i--) {
+				_cborByte(writer, bits >> (8 * i));
+			}
+		} else {
+			uint64_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			_cborByte(writer, 0xfb);
+			for (int i = 7; i >= 0; i--) {
+				_cborByte(writer, bits >> (8 * i));
+			}
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+//
+//	Notification Functions 
+//
+
+
+void OneM2M::setupNotifications() {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	OneM2M::setupNotifications(WiFi.localIP().toString(), 1440, "/onem2m/Notifications");
+}
+
+
+void OneM2M::setupNotifications(String host, int port, String path) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (_notificationServer) {
+		return;
+	}
+	_notificationURL = "http://" + host + ":" + String(port) + path;
+	_notificationServer = new HttpServer(port);
+	_notificationServer->addHandler(path, HttpServer::POST, _notificationRequestHandler);
+}
+
+
+void OneM2M::shutdownNotifications(void) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (_notificationServer == NULL) {
+		return;
+	}
+	delete _notificationServer;
+	while (_notificationCallbacks.size() > 0) {
+		delete _notificationCallbacks.get(0);
+		_notificationCallbacks.remove(0);
+	}
+	_notificationServer = NULL;
+}
+
+
+bool OneM2M::addNotificationCallback(String subscriptionResourceID, NotificationCallback callback) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (subscriptionResourceID != NULL && subscriptionResourceID.length() == 0) {
+		return false;
+	}
+	NotificationCBStruct *cb =  _getCallback(subscriptionResourceID);
+	if (cb) {
+		cb->callback = callback;
+		cb->fieldsCallback = NULL;
+		return true;
+	}
+	cb = new NotificationCBStruct();
+	cb->subscriptionResourceID = subscriptionResourceID;
+	cb->callback = callback;
+	cb->fieldsCallback = NULL;
+	_notificationCallbacks.add(cb);
+	return true;
+}
+
+
+bool OneM2M::addNotificationFieldsCallback(String subscriptionResourceID, NotificationFieldsCallback callback) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (subscriptionResourceID.length() == 0) {
+		return false;
+	}
+	NotificationCBStruct *cb =  _getCallback(subscriptionResourceID);
+	if (cb == NULL) {
+		cb = new NotificationCBStruct();
+		cb->subscriptionResourceID = subscriptionResourceID;
+		_notificationCallbacks.add(cb);
+	}
+	cb->callback = NULL;
+	cb->fieldsCallback = callback;
+	return true;
+}
+
+
+bool OneM2M::removeNotificationCallback(String subscriptionResourceID) {
+	HEAP_SCOPE(HEAP_ONEM2M);
+	if (subscriptionResourceID != NULL && subscriptionResourceID.length() == 0) {
+		return false;
+	}
+	for (int i = 0; i < _notificationCallbacks.size(); i++) {
+		NotificationCBStruct *cb = _notificationCallbacks.get(i);
+		if (cb->subscriptionResourceID == subscriptionResourceID) {
+			_notificationCallbacks.remove(i);
+			delete cb;
+			return true;
+		} 
+	}
+	return false;
+}
+
+
+//	Check for notification server activities
+void OneM2M::checkNotifications(void) {
+	if (_notificationServer != NULL) {
+		_notificationServer->check();
+	}
+}
+
+
+// Handle the internal interpretation and routing of notifications. The
+// HttpServer has already received the complete body, and the notification
+// is scanned only once in this buffer. The notified resource is passed to a
+// NotificationCallback as a copy of the original text of the *rep* attribute,
+// or converted to JSON if the notification is encoded in CBOR.
+HttpServer::RequestResult OneM2M::_notificationRequestHandler(String, 
+															  HttpServer::Method, 
+															  long length,
+															  String type, 
+															  char *content) {
+	HEAP_SCOPE(HEAP_ONEM2M);	// called as an application handler by the HttpServer
+	ResourceFields 				fields;
+	Scanner 					scanner;
+	HttpServer::RequestResult	result;
+	result.returnCode = 200;
+	result.attributes = "X-M2M-RSC: 2000";
+	type.toLowerCase();
+	bool cbor = type.indexOf("cbor") > -1;
+
+	if (_scanDocument(scanner, &fields, content, length, cbor)) {
+		if (strcmp(scanner.rootKey, "m2m:sgn") == 0 || strcmp(scanner.rootKey, "sgn") == 0) {
+			// verification request
+			if (fields.verificationRequest) {
+				return result;
+			}
+			// notification request 
+			if (fields.subscriptionReference[0] != '\0' && scanner.repEnd > scanner.repStart) {
+				NotificationCBStruct *cb = _getCallback(fields.subscriptionReference);
+				if (cb && cb->fieldsCallback) {
+					HEAP_SCOPE(HEAP_APPLICATION);
+					(*cb->fieldsCallback)(fields);
+				} else if (cb && cb->callback) {
+					String rep;
+					if (cbor) {
+						rep = _cborToJson((const uint8_t *)content + scanner.repStart, scanner.repEnd - scanner.repStart);
+					} else {
+						char c = content[scanner.repEnd];
+						content[scanner.repEnd] = '\0';
+						rep = content + scanner.repStart;
+						content[scanner.repEnd] = c;
+					}
+					HEAP_SCOPE(HEAP_APPLICATION);
+					(*cb->callback)(fields.subscriptionReference, (ResourceType)fields.type, rep); 
+				}
+				return result;
+			}
+		}
+	}
+	result.returnCode = 400;
+	result.attributes = "X-M2M-RSC: 4000";
+	return result;
+}
+
+
+// search and return a callback struct
+OneM2M::NotificationCBStruct *OneM2M::_getCallback(String resourceIdentifier) {
+	for (int i = 0; i < _notificationCallbacks.size(); i++) {
+		NotificationCBStruct *cb = _notificationCallbacks.get(i);
+		if (cb->subscriptionResourceID == resourceIdentifier) {
+			return cb;
+		} 
+	}
+	return NULL;
 }
 
 